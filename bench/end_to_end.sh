@@ -0,0 +1,85 @@
+#!/bin/sh
+# end_to_end.sh
+# Copyright (c) 2024 Ishan Pranav
+# Licensed under the MIT license.
+
+# Times 'nyufile -l', '-r' and '-R' on images written by tools/makeimage across
+# a matrix of image sizes and fragmentation levels. Each command runs on a
+# fresh copy of the image and the best of several runs is reported.
+
+set -eu
+
+NYUFILE=${NYUFILE:-../src/nyufile}
+MAKEIMAGE=${MAKEIMAGE:-../tools/makeimage}
+CLUSTERS=${CLUSTERS:-"16384 131072 524288"}
+FRAGMENTS=${FRAGMENTS:-"1 2 3"}
+REPEAT=${REPEAT:-3}
+WORK=$(mktemp -d)
+
+trap 'rm -rf "$WORK"' EXIT
+
+# Prints the best wall-clock time, in milliseconds, of a command run on a fresh
+# copy of the image.
+
+measure()
+{
+    best=
+
+    for i in $(seq "$REPEAT")
+    do
+        cp --sparse=always "$WORK/image" "$WORK/copy"
+
+        start=$(date +%s%N)
+
+        "$NYUFILE" "$WORK/copy" "$@" > "$WORK/output"
+
+        end=$(date +%s%N)
+        elapsed=$(((end - start) / 1000))
+
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]
+        then
+            best=$elapsed
+        fi
+    done
+
+    if [ "$1" != "-l" ] && ! grep -q "successfully recovered" "$WORK/output"
+    then
+        echo "$0: $(cat "$WORK/output")" >&2
+
+        exit 1
+    fi
+
+    printf "%d.%03d" $((best / 1000)) $((best % 1000))
+}
+
+printf "%-10s %-10s %-8s %12s %12s %12s\n" \
+    clusters files runs "-l (ms)" "-r (ms)" "-R (ms)"
+
+for clusters in $CLUSTERS
+do
+    for fragments in $FRAGMENTS
+    do
+        files=$((clusters / 32))
+
+        "$MAKEIMAGE" -c "$clusters" -n "$files" -k 8 -f "$fragments" \
+            -p 50 -g 4 -d 25 -S "$clusters" "$WORK/image" "$WORK/manifest"
+
+        # The first deleted file of each kind is recovered, so the cost of the
+        # search does not depend on where the file happens to lie.
+
+        contiguous=$(grep -m 1 " contiguous$" "$WORK/manifest")
+        fragmented=$(grep -m 1 " fragmented$" "$WORK/manifest" ||
+            echo "$contiguous")
+
+        set -- $contiguous
+        r=$(measure -r "$1" -s "$2")
+
+        set -- $fragmented
+        R=$(measure -R "$1" -s "$2" --strategy run --max-runs "$fragments")
+
+        l=$(measure -l)
+
+        printf "%-10s %-10s %-8s %12s %12s %12s\n" \
+            "$clusters" "$files" "$fragments" "$l" "$r" "$R"
+    done
+done
@@ -0,0 +1,142 @@
+// hash_benchmark.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hash.h"
+
+#define HASH_BENCHMARK_REPETITIONS 5
+#define HASH_BENCHMARK_BYTES ((uint64_t)64 << 20)
+
+static const uint32_t HASH_BENCHMARK_SIZES[] = { 64, 512, 4096, 32768 };
+
+static double hash_benchmark_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double hash_benchmark_run(
+    const HashBackend* backend,
+    const uint8_t* data,
+    uint32_t size)
+{
+    Hash context;
+    unsigned char digest[HASH_DIGEST_LENGTH];
+    uint64_t messages = HASH_BENCHMARK_BYTES / size;
+    double best = 0;
+
+    if (!hash(&context, backend))
+    {
+        return 0;
+    }
+
+    // The first repetition warms up the caches and the branch predictors and
+    // is not counted; the best of the others is reported.
+
+    for (int repetition = 0; repetition <= HASH_BENCHMARK_REPETITIONS;
+        repetition++)
+    {
+        double start = hash_benchmark_now();
+
+        for (uint64_t i = 0; i < messages; i++)
+        {
+            backend->reset(&context);
+            hash_update(&context, data, size);
+            hash_final(&context, digest);
+        }
+
+        double elapsed = hash_benchmark_now() - start;
+        double rate = messages * size / elapsed / 1e6;
+
+        if (repetition && rate > best)
+        {
+            best = rate;
+        }
+    }
+
+    finalize_hash(&context);
+
+    return best;
+}
+
+int main(void)
+{
+    size_t sizeCount = sizeof HASH_BENCHMARK_SIZES /
+        sizeof * HASH_BENCHMARK_SIZES;
+    uint32_t capacity = HASH_BENCHMARK_SIZES[sizeCount - 1];
+    uint8_t* data = malloc(capacity);
+
+    if (!data)
+    {
+        perror("hash_benchmark");
+
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        data[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+
+    int result = EXIT_SUCCESS;
+
+    printf("%-10s %-10s", "backend", "self-test");
+
+    for (size_t i = 0; i < sizeCount; i++)
+    {
+        printf(" %9u B", HASH_BENCHMARK_SIZES[i]);
+    }
+
+    printf("\n");
+
+    for (const HashBackend* const* p = HASH_BACKENDS; *p; p++)
+    {
+        const HashBackend* backend = *p;
+
+        printf("%-10s ", backend->name);
+
+        if (!backend->supported())
+        {
+            printf("%-10s\n", "n/a");
+
+            continue;
+        }
+
+        if (!hash_self_test(backend) || !hash_self_test_long(backend))
+        {
+            printf("%-10s\n", "FAIL");
+
+            result = EXIT_FAILURE;
+
+            continue;
+        }
+
+        printf("%-10s", "pass");
+
+        for (size_t i = 0; i < sizeCount; i++)
+        {
+            double rate = hash_benchmark_run(
+                backend,
+                data,
+                HASH_BENCHMARK_SIZES[i]);
+
+            printf(" %6.0f MB/s", rate);
+        }
+
+        printf("\n");
+    }
+
+    printf("selected: %s\n", hash_backend()->name);
+    free(data);
+
+    return result;
+}
@@ -0,0 +1,363 @@
+// kernel_benchmark.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hash.h"
+#include "next_permutation.h"
+#include "utility.h"
+#include "volume_root_iterator.h"
+
+#define KERNEL_BENCHMARK_REPETITIONS 5
+#define KERNEL_BENCHMARK_SECONDS 0.05
+#define KERNEL_BENCHMARK_PERMUTATION 8
+#define KERNEL_BENCHMARK_CHAIN 8
+
+/** Represents the state shared by the kernels. */
+struct KernelBenchmark
+{
+    /** The volume, mapped privately so that writes never reach the image. */
+    Volume volume;
+
+    /** The names of the root directory entries. */
+    uint8_t (*names)[11];
+
+    /** Specifies the number of root directory entries. */
+    uint32_t entries;
+
+    /** The items permuted by `next_permutation`. */
+    uint32_t items[KERNEL_BENCHMARK_PERMUTATION];
+
+    /** The SHA-1 state updated over one cluster. */
+    Hash hash;
+
+    /** Accumulates results so that the kernels are not optimized away. */
+    uint64_t sink;
+};
+
+/** Represents the state shared by the kernels. */
+typedef struct KernelBenchmark KernelBenchmark;
+
+/** Represents a kernel that runs a number of operations. */
+struct Kernel
+{
+    /** The name of the kernel. */
+    const char* name;
+
+    /** Runs the given number of operations. */
+    void (*run)(KernelBenchmark* benchmark, uint64_t operations);
+
+    /** Gets the number of bytes processed by one operation. */
+    uint64_t (*bytes)(KernelBenchmark* benchmark);
+};
+
+/** Represents a kernel that runs a number of operations. */
+typedef struct Kernel Kernel;
+
+static double kernel_benchmark_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void kernel_display_name(KernelBenchmark* benchmark, uint64_t operations)
+{
+    char buffer[13];
+
+    for (uint64_t i = 0; i < operations; i++)
+    {
+        volume_display_name(buffer, benchmark->names[i % benchmark->entries]);
+
+        benchmark->sink += (uint8_t)*buffer;
+    }
+}
+
+static uint64_t kernel_display_name_bytes(KernelBenchmark* benchmark)
+{
+    (void)benchmark;
+
+    return 11;
+}
+
+static void kernel_root_next(KernelBenchmark* benchmark, uint64_t operations)
+{
+    VolumeRootIterator iterator;
+
+    volume_root_begin(&iterator, &benchmark->volume);
+
+    for (uint64_t i = 0; i < operations; i++)
+    {
+        if (iterator.end)
+        {
+            volume_root_begin(&iterator, &benchmark->volume);
+        }
+
+        benchmark->sink += *iterator.entry->name;
+
+        volume_root_next(&iterator);
+    }
+}
+
+static uint64_t kernel_root_next_bytes(KernelBenchmark* benchmark)
+{
+    (void)benchmark;
+
+    return sizeof(Fat32DirectoryEntry);
+}
+
+static void kernel_next_permutation(
+    KernelBenchmark* benchmark,
+    uint64_t operations)
+{
+    for (uint64_t i = 0; i < operations; i++)
+    {
+        if (!next_permutation(benchmark->items, KERNEL_BENCHMARK_PERMUTATION))
+        {
+            benchmark->sink++;
+        }
+    }
+
+    benchmark->sink += *benchmark->items;
+}
+
+static uint64_t kernel_next_permutation_bytes(KernelBenchmark* benchmark)
+{
+    return sizeof benchmark->items;
+}
+
+static void kernel_hash_update(KernelBenchmark* benchmark, uint64_t operations)
+{
+    Volume* volume = &benchmark->volume;
+    uint32_t bytesPerCluster = volume->geometry.bytesPerCluster;
+    uint8_t* data = volume_cluster_data(volume, 2);
+
+    for (uint64_t i = 0; i < operations; i++)
+    {
+        hash_update(&benchmark->hash, data, bytesPerCluster);
+    }
+}
+
+static uint64_t kernel_hash_update_bytes(KernelBenchmark* benchmark)
+{
+    return benchmark->volume.geometry.bytesPerCluster;
+}
+
+static void kernel_recover_contiguous(
+    KernelBenchmark* benchmark,
+    uint64_t operations)
+{
+    Volume* volume = &benchmark->volume;
+    uint32_t chains = volume->geometry.clusterCount / KERNEL_BENCHMARK_CHAIN;
+
+    for (uint64_t i = 0; i < operations; i++)
+    {
+        uint32_t firstCluster = 2 + i % chains * KERNEL_BENCHMARK_CHAIN;
+
+        recover_contiguous(volume, firstCluster, KERNEL_BENCHMARK_CHAIN);
+
+        // Only the cost of recording the ranges is measured, not their growth.
+
+        volume->rangeCount = 0;
+    }
+}
+
+static uint64_t kernel_recover_contiguous_bytes(KernelBenchmark* benchmark)
+{
+    uint32_t fatCount = benchmark->volume.geometry.fatCount;
+
+    return (uint64_t)fatCount * KERNEL_BENCHMARK_CHAIN * sizeof(uint32_t);
+}
+
+static const Kernel KERNELS[] =
+{
+    {
+        "volume_display_name",
+        kernel_display_name,
+        kernel_display_name_bytes
+    },
+    {
+        "volume_root_next",
+        kernel_root_next,
+        kernel_root_next_bytes
+    },
+    {
+        "next_permutation",
+        kernel_next_permutation,
+        kernel_next_permutation_bytes
+    },
+    {
+        "hash_update",
+        kernel_hash_update,
+        kernel_hash_update_bytes
+    },
+    {
+        "recover_contiguous",
+        kernel_recover_contiguous,
+        kernel_recover_contiguous_bytes
+    }
+};
+
+static double kernel_benchmark_run(
+    KernelBenchmark* benchmark,
+    const Kernel* kernel)
+{
+    uint64_t operations = 1;
+    double elapsed = 0;
+
+    // The operation count is doubled until one repetition is long enough to
+    // time; this also warms up the caches and the branch predictors. The best
+    // of the repetitions that follow is reported.
+
+    while (elapsed < KERNEL_BENCHMARK_SECONDS)
+    {
+        operations *= 2;
+
+        double start = kernel_benchmark_now();
+
+        kernel->run(benchmark, operations);
+
+        elapsed = kernel_benchmark_now() - start;
+    }
+
+    double best = elapsed;
+
+    for (int repetition = 0; repetition < KERNEL_BENCHMARK_REPETITIONS;
+        repetition++)
+    {
+        double start = kernel_benchmark_now();
+
+        kernel->run(benchmark, operations);
+
+        elapsed = kernel_benchmark_now() - start;
+
+        if (elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    return best / operations;
+}
+
+static bool kernel_benchmark(KernelBenchmark* instance, const char* path)
+{
+    if (!volume(&instance->volume, path, VOLUME_MODE_PRIVATE))
+    {
+        return false;
+    }
+
+    VolumeRootIterator iterator;
+
+    instance->entries = 0;
+
+    for (volume_root_begin(&iterator, &instance->volume);
+        !iterator.end;
+        volume_root_next(&iterator))
+    {
+        instance->entries++;
+    }
+
+    if (!instance->entries || instance->volume.geometry.clusterCount <
+        KERNEL_BENCHMARK_CHAIN)
+    {
+        errno = EINVAL;
+
+        goto kernel_benchmark_exit_volume;
+    }
+
+    instance->names = malloc(instance->entries * sizeof * instance->names);
+
+    if (!instance->names)
+    {
+        goto kernel_benchmark_exit_volume;
+    }
+
+    uint8_t (*name)[11] = instance->names;
+
+    for (volume_root_begin(&iterator, &instance->volume);
+        !iterator.end;
+        volume_root_next(&iterator))
+    {
+        memcpy(*name, iterator.entry->name, sizeof * name);
+
+        name++;
+    }
+
+    if (!hash(&instance->hash, hash_backend()))
+    {
+        goto kernel_benchmark_exit_names;
+    }
+
+    for (uint32_t i = 0; i < KERNEL_BENCHMARK_PERMUTATION; i++)
+    {
+        instance->items[i] = i;
+    }
+
+    instance->sink = 0;
+
+    return true;
+
+kernel_benchmark_exit_names:
+    free(instance->names);
+
+kernel_benchmark_exit_volume:
+    finalize_volume(&instance->volume);
+
+    return false;
+}
+
+static void finalize_kernel_benchmark(KernelBenchmark* instance)
+{
+    finalize_hash(&instance->hash);
+    free(instance->names);
+    finalize_volume(&instance->volume);
+}
+
+int main(int count, char* args[])
+{
+    if (count != 2)
+    {
+        fprintf(stderr, "Usage: %s disk\n", *args);
+
+        return EXIT_FAILURE;
+    }
+
+    KernelBenchmark benchmark;
+
+    if (!kernel_benchmark(&benchmark, args[1]))
+    {
+        perror(args[1]);
+
+        return EXIT_FAILURE;
+    }
+
+    printf("%-20s %12s %12s\n", "kernel", "ns/op", "MB/s");
+
+    for (size_t i = 0; i < sizeof KERNELS / sizeof * KERNELS; i++)
+    {
+        const Kernel* kernel = KERNELS + i;
+        double seconds = kernel_benchmark_run(&benchmark, kernel);
+        double rate = kernel->bytes(&benchmark) / seconds / 1e6;
+
+        printf("%-20s %12.2f %12.1f\n", kernel->name, seconds * 1e9, rate);
+    }
+
+    if (!benchmark.sink)
+    {
+        printf("\n");
+    }
+
+    finalize_kernel_benchmark(&benchmark);
+
+    return EXIT_SUCCESS;
+}
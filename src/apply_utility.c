@@ -0,0 +1,32 @@
+// apply_utility.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include "utility.h"
+#include "volume_patch.h"
+
+void apply_utility(
+    FILE* output,
+    Volume* volume,
+    const char* recover,
+    UTILITY_UNUSED unsigned char sha1[SHA_DIGEST_LENGTH],
+    UTILITY_UNUSED const Settings* settings)
+{
+    uint32_t count;
+
+    if (!volume_patch_apply(volume, recover, &count))
+    {
+        fprintf(output, "%s: %s\n", recover, strerror(errno));
+
+        return;
+    }
+
+    fprintf(
+        output,
+        "%s: successfully applied %" PRIu32 " ranges\n",
+        recover,
+        count);
+}
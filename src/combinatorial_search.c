@@ -0,0 +1,1608 @@
+// combinatorial_search.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+//  - https://www.man7.org/linux/man-pages/man3/pthread_create.3.html
+//  - https://en.cppreference.com/w/c/atomic
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "combinatorial_search.h"
+#include "sha1_multi.h"
+#include "volume_free_map.h"
+
+static double combinatorial_search_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void combinatorial_search_publish(CombinatorialSearchWorker* worker)
+{
+    CombinatorialSearch* search = worker->search;
+
+    if (!atomic_exchange(&search->found, true))
+    {
+        memcpy(
+            search->results,
+            worker->prefix,
+            search->clusters * sizeof * worker->prefix);
+    }
+}
+
+static bool combinatorial_search_is_tail(
+    const CombinatorialSearch* search,
+    uint32_t candidate)
+{
+    return !search->tails || search->tails[candidate] == search->zeroTails;
+}
+
+static bool combinatorial_search_accepts(
+    CombinatorialSearchWorker* worker,
+    uint32_t depth,
+    uint32_t candidate)
+{
+    CombinatorialSearch* search = worker->search;
+
+    if (!combinatorial_search_is_tail(search, candidate))
+    {
+        return false;
+    }
+
+    if (!search->validate)
+    {
+        return true;
+    }
+
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint32_t remainder = search->fileSize - bytesPerCluster * depth;
+    uint8_t* data = volume_root_data(
+        search->iterator,
+        search->candidates[candidate]);
+    Validator* leaf = &worker->leafValidator;
+    bool accepted = worker->accepted[depth - 1];
+
+    if (accepted)
+    {
+        validator_copy(leaf, worker->validators + depth - 1);
+
+        accepted = validator_update(leaf, data, remainder) &&
+            validator_final(leaf);
+    }
+
+    // The search that follows a pruned one tests only the reassemblies that
+    // it pruned.
+
+    return accepted == search->prune;
+}
+
+static uint32_t combinatorial_search_lower_bound(
+    const CombinatorialSearch* search,
+    const uint32_t* indices,
+    uint32_t count,
+    uint32_t cluster)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (indices)
+        {
+            if (search->candidates[indices[middle]] < cluster)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        else if (search->candidates[middle] < cluster)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low == count ? 0 : low;
+}
+
+static void combinatorial_search_order(
+    const CombinatorialSearch* search,
+    CombinatorialSearchOrder* order,
+    uint32_t previous)
+{
+    uint32_t next = combinatorial_search_lower_bound(
+        search,
+        NULL,
+        search->count,
+        previous + 1);
+
+    order->start = combinatorial_search_lower_bound(
+        search,
+        search->starts,
+        search->startCount,
+        previous + 1);
+    order->startCount = search->startCount;
+    order->interior = combinatorial_search_lower_bound(
+        search,
+        search->interiors,
+        search->interiorCount,
+        previous + 1);
+    order->interiorCount = search->interiorCount;
+    order->next = search->count;
+
+    // The cluster that continues the previous one comes first and is skipped
+    // in whichever group holds it, where it would otherwise come first.
+
+    if (search->candidates[next] != previous + 1)
+    {
+        return;
+    }
+
+    order->next = next;
+
+    if (order->startCount && search->starts[order->start] == next)
+    {
+        order->startCount--;
+        order->start++;
+
+        if (order->start == search->startCount)
+        {
+            order->start = 0;
+        }
+    }
+    else
+    {
+        order->interiorCount--;
+        order->interior++;
+
+        if (order->interior == search->interiorCount)
+        {
+            order->interior = 0;
+        }
+    }
+}
+
+static uint32_t combinatorial_search_candidate(
+    const CombinatorialSearch* search,
+    const CombinatorialSearchOrder* order,
+    uint32_t rank)
+{
+    if (order->next < search->count)
+    {
+        if (!rank)
+        {
+            return order->next;
+        }
+
+        rank--;
+    }
+
+    if (rank < order->startCount)
+    {
+        uint32_t position = order->start + rank;
+
+        if (position >= search->startCount)
+        {
+            position -= search->startCount;
+        }
+
+        return search->starts[position];
+    }
+
+    uint32_t position = order->interior + rank - order->startCount;
+
+    if (position >= search->interiorCount)
+    {
+        position -= search->interiorCount;
+    }
+
+    return search->interiors[position];
+}
+
+static bool combinatorial_search_test(
+    CombinatorialSearchWorker* worker,
+    uint32_t depth,
+    uint32_t candidate)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint32_t remainder = search->fileSize - bytesPerCluster * depth;
+    uint8_t* data = volume_root_data(
+        search->iterator,
+        search->candidates[candidate]);
+    unsigned char digest[SHA_DIGEST_LENGTH];
+
+    if (!hash_copy(&worker->leaf, worker->contexts + depth - 1))
+    {
+        return false;
+    }
+
+    hash_update(&worker->leaf, data, remainder);
+    hash_final(&worker->leaf, digest);
+
+    worker->counters.clusters++;
+    worker->counters.bytes += remainder;
+    worker->counters.permutations++;
+
+    if (memcmp(digest, search->sha1, SHA_DIGEST_LENGTH) != 0)
+    {
+        return false;
+    }
+
+    worker->prefix[depth] = search->candidates[candidate];
+
+    return true;
+}
+
+static bool combinatorial_search_test_lanes(
+    CombinatorialSearchWorker* worker,
+    uint32_t depth,
+    uint32_t* index)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint32_t remainder = search->fileSize - bytesPerCluster * depth;
+    CombinatorialSearchOrder* order = worker->orders + depth;
+    uint32_t candidates[SHA1_MULTI_LANES];
+    const uint8_t* data[SHA1_MULTI_LANES];
+    uint32_t lanes = 0;
+    uint32_t rank = *index;
+
+    // Gather the next unused candidates so that the last cluster of each is
+    // hashed in lockstep, one candidate per lane.
+
+    for (; rank < search->count && lanes < SHA1_MULTI_LANES; rank++)
+    {
+        uint32_t i = combinatorial_search_candidate(search, order, rank);
+
+        if (worker->used[i] || !combinatorial_search_accepts(worker, depth, i))
+        {
+            continue;
+        }
+
+        candidates[lanes] = i;
+        data[lanes] = volume_root_data(search->iterator, search->candidates[i]);
+        lanes++;
+    }
+
+    *index = rank;
+
+    // A partial batch costs as much as a full one, so its candidates are
+    // hashed one at a time instead, as are the candidates of a backend that
+    // does not expose its saved state.
+
+    uint32_t state[5];
+    uint64_t length;
+
+    if (lanes < SHA1_MULTI_LANES ||
+        !hash_export(worker->contexts + depth - 1, state, &length))
+    {
+        for (uint32_t lane = 0; lane < lanes; lane++)
+        {
+            if (combinatorial_search_test(worker, depth, candidates[lane]))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    unsigned char digests[SHA1_MULTI_LANES][SHA1_MULTI_DIGEST_LENGTH];
+
+    sha1_multi_digest(digests, state, length, data, remainder, lanes);
+
+    worker->counters.clusters += lanes;
+    worker->counters.bytes += (uint64_t)remainder * lanes;
+    worker->counters.permutations += lanes;
+
+    for (uint32_t lane = 0; lane < lanes; lane++)
+    {
+        if (memcmp(digests[lane], search->sha1, SHA_DIGEST_LENGTH) == 0)
+        {
+            worker->prefix[depth] = search->candidates[candidates[lane]];
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool combinatorial_search_push(
+    CombinatorialSearchWorker* worker,
+    uint32_t depth,
+    uint32_t candidate)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint8_t* data = volume_root_data(
+        search->iterator,
+        search->candidates[candidate]);
+
+    // A prefix that the format rejects is pruned with its whole subtree
+    // before it is hashed. Once pruning has failed, the prefix is kept, and
+    // so is the knowledge that the format rejected it.
+
+    if (search->validate)
+    {
+        Validator* validator = worker->validators + depth;
+        bool accepted = worker->accepted[depth - 1];
+
+        if (accepted)
+        {
+            validator_copy(validator, validator - 1);
+
+            accepted = validator_update(validator, data, bytesPerCluster);
+        }
+
+        if (!accepted && search->prune)
+        {
+            return false;
+        }
+
+        worker->accepted[depth] = accepted;
+    }
+
+    // Every cluster before the last is hashed in full. Since the cluster size
+    // is a multiple of the SHA-1 block size, the saved state after each prefix
+    // holds no buffered bytes and can be copied directly.
+
+    hash_copy(worker->contexts + depth, worker->contexts + depth - 1);
+    hash_update(worker->contexts + depth, data, bytesPerCluster);
+
+    worker->counters.clusters++;
+    worker->counters.bytes += bytesPerCluster;
+    worker->used[candidate] = true;
+    worker->prefix[depth] = search->candidates[candidate];
+
+    if (depth + 1 < search->clusters)
+    {
+        combinatorial_search_order(
+            search,
+            worker->orders + depth + 1,
+            worker->prefix[depth]);
+    }
+
+    return true;
+}
+
+static void combinatorial_search_checkpoint(
+    CombinatorialSearch* search,
+    CombinatorialSearchWorker* workers,
+    uint32_t workerCount)
+{
+    SearchCheckpoint* checkpoint = &search->checkpoint;
+
+    // Every queue is locked at once, so that each task is either in a queue,
+    // in progress, or done, but never lost or counted twice.
+
+    for (uint32_t w = 0; w < workerCount; w++)
+    {
+        pthread_mutex_lock(&workers[w].mutex);
+    }
+
+    for (uint32_t w = 0; w < workerCount; w++)
+    {
+        CombinatorialSearchWorker* worker = workers + w;
+        SearchCheckpointCursor* cursor = checkpoint->cursors + w;
+
+        cursor->head = worker->head;
+        cursor->tail = worker->tail;
+        cursor->task = worker->task;
+        cursor->depth = worker->cursorDepth;
+
+        memcpy(
+            cursor->ranks,
+            worker->cursor,
+            (worker->cursorDepth + 1) * sizeof * worker->cursor);
+    }
+
+    for (uint32_t w = workerCount; w > 0; w--)
+    {
+        pthread_mutex_unlock(&workers[w - 1].mutex);
+    }
+
+    // A checkpoint that cannot be written is skipped; the previous one, if
+    // any, is left whole.
+
+    search_checkpoint_write(checkpoint, search->checkpointPath);
+
+    search->checkpointDue = combinatorial_search_now() +
+        SEARCH_CHECKPOINT_INTERVAL;
+}
+
+static double combinatorial_search_covered(CombinatorialSearchWorker* worker)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t workerCount = worker->workerCount;
+    uint64_t taken = 0;
+
+    // The tasks are ranked by their position in the enumeration, so the share
+    // taken from the queues is the share of the pass covered, counting the
+    // tasks in progress as covered.
+
+    for (uint32_t w = 0; w < workerCount; w++)
+    {
+        CombinatorialSearchWorker* other = worker->workers + w;
+        uint64_t slots = (search->tasks - w + workerCount - 1) / workerCount;
+
+        pthread_mutex_lock(&other->mutex);
+
+        taken += other->head + slots - other->tail;
+
+        pthread_mutex_unlock(&other->mutex);
+    }
+
+    return (double)taken / search->tasks;
+}
+
+static void combinatorial_search_tick(CombinatorialSearchWorker* worker)
+{
+    CombinatorialSearch* search = worker->search;
+    uint64_t permutations = worker->counters.permutations;
+    uint64_t nodes = permutations - worker->published;
+
+    worker->published = permutations;
+    nodes += atomic_fetch_add(&search->permutations, nodes);
+
+    // Every worker checks the budget on every report, whether or not it
+    // finds the monitor free, and then reports again after its share of half
+    // of what is left, so that the work the others still have in hand shrinks
+    // with the budget and the workers together stop close to the node limit.
+
+    SearchProgress* progress = search->progress;
+
+    if (progress && progress->nodeLimit)
+    {
+        uint64_t spent = progress->spent + nodes;
+
+        if (spent >= progress->nodeLimit)
+        {
+            atomic_store(&search->stopped, true);
+        }
+        else
+        {
+            uint64_t share = (progress->nodeLimit - spent) /
+                (2 * worker->workerCount) + 1;
+
+            worker->period = share < search->period ? share : search->period;
+        }
+    }
+
+    // The progress and the checkpoint are left to whichever worker finds the
+    // monitor free; the others carry on instead of waiting.
+
+    if (pthread_mutex_trylock(&search->monitorMutex) != 0)
+    {
+        return;
+    }
+
+    if (search->progress &&
+        !search_progress_update(
+            search->progress,
+            nodes,
+            combinatorial_search_covered(worker)))
+    {
+        atomic_store(&search->stopped, true);
+    }
+
+    if (search->checkpointPath &&
+        combinatorial_search_now() >= search->checkpointDue)
+    {
+        combinatorial_search_checkpoint(
+            search,
+            worker->workers,
+            worker->workerCount);
+    }
+
+    pthread_mutex_unlock(&search->monitorMutex);
+}
+
+static bool combinatorial_search_is_done(CombinatorialSearch* search)
+{
+    return atomic_load_explicit(&search->found, memory_order_relaxed) ||
+        atomic_load_explicit(&search->stopped, memory_order_relaxed);
+}
+
+static void combinatorial_search_save(
+    CombinatorialSearchWorker* worker,
+    uint32_t base,
+    uint32_t depth)
+{
+    // The cursor names the candidates on the path below the prefix of the
+    // task and the next candidate to try at the deepest level; everything
+    // before it in the order of the search has been tried.
+
+    pthread_mutex_lock(&worker->mutex);
+
+    memcpy(
+        worker->cursor + base,
+        worker->indices + base,
+        (depth - base + 1) * sizeof * worker->indices);
+
+    worker->cursorDepth = depth;
+
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+static bool combinatorial_search_visit(
+    CombinatorialSearchWorker* worker,
+    uint32_t base,
+    uint32_t depth)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t last = search->clusters - 1;
+
+    // The search keeps an explicit stack of candidate ranks rather than
+    // recursing, so that the depth is bounded only by the file length. At each
+    // depth the candidates are tried in order of locality to the cluster
+    // chosen at the depth before. The stack begins at the given depth, with
+    // the ranks of every depth before it already pushed.
+
+    for (;;)
+    {
+        if (combinatorial_search_is_done(search))
+        {
+            return false;
+        }
+
+        CombinatorialSearchOrder* order = worker->orders + depth;
+        uint32_t rank = worker->indices[depth];
+        uint32_t i = 0;
+
+        for (; rank < search->count; rank++)
+        {
+            i = combinatorial_search_candidate(search, order, rank);
+
+            if (!worker->used[i])
+            {
+                break;
+            }
+        }
+
+        if (rank == search->count)
+        {
+            if (depth == base)
+            {
+                return false;
+            }
+
+            depth--;
+            worker->used[combinatorial_search_candidate(
+                search,
+                worker->orders + depth,
+                worker->indices[depth])] = false;
+            worker->indices[depth]++;
+
+            continue;
+        }
+
+        worker->indices[depth] = rank;
+
+        if (depth == last)
+        {
+            if (combinatorial_search_test_lanes(worker, depth, &rank))
+            {
+                return true;
+            }
+
+            worker->indices[depth] = rank;
+
+            if (worker->counters.permutations - worker->published >=
+                worker->period)
+            {
+                combinatorial_search_save(worker, base, depth);
+                combinatorial_search_tick(worker);
+            }
+
+            continue;
+        }
+
+        if (!combinatorial_search_push(worker, depth, i))
+        {
+            worker->indices[depth]++;
+
+            continue;
+        }
+
+        depth++;
+        worker->indices[depth] = 0;
+    }
+}
+
+static void combinatorial_search_diagonal(
+    uint64_t task,
+    uint32_t n,
+    uint32_t ranks[2])
+{
+    uint64_t triangle = (uint64_t)n * (n + 1) / 2;
+    bool mirrored = task >= triangle;
+
+    // The square of rank pairs is walked one anti-diagonal at a time, so that
+    // the pairs whose ranks have the least sum come first. The anti-diagonals
+    // past the main one are walked as the mirror image of those before it.
+
+    if (mirrored)
+    {
+        task = (uint64_t)n * n - 1 - task;
+    }
+
+    uint64_t low = 0;
+    uint64_t high = n;
+
+    while (high - low > 1)
+    {
+        uint64_t middle = low + (high - low) / 2;
+
+        if (middle * (middle + 1) / 2 <= task)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    uint64_t diagonal = low;
+
+    uint32_t second = task - diagonal * (diagonal + 1) / 2;
+    uint32_t first = diagonal - second;
+
+    if (mirrored)
+    {
+        first = n - 1 - first;
+        second = n - 1 - second;
+    }
+
+    ranks[0] = first;
+    ranks[1] = second;
+}
+
+static uint32_t combinatorial_search_restore(
+    CombinatorialSearchWorker* worker,
+    uint32_t base)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t depth = base;
+
+    // The path of a resumed task is pushed again from its ranks. A path that
+    // cannot be pushed does not belong to the task, which then starts over.
+
+    for (; depth < worker->cursorDepth; depth++)
+    {
+        uint32_t rank = worker->cursor[depth];
+        uint32_t candidate = combinatorial_search_candidate(
+            search,
+            worker->orders + depth,
+            rank);
+
+        if (worker->used[candidate] ||
+            !combinatorial_search_push(worker, depth, candidate))
+        {
+            while (depth > base)
+            {
+                depth--;
+                worker->used[combinatorial_search_candidate(
+                    search,
+                    worker->orders + depth,
+                    worker->indices[depth])] = false;
+            }
+
+            worker->indices[base] = 0;
+
+            return base;
+        }
+
+        worker->indices[depth] = rank;
+    }
+
+    worker->indices[depth] = worker->cursor[depth];
+
+    return depth;
+}
+
+static bool combinatorial_search_run(
+    CombinatorialSearchWorker* worker,
+    uint64_t task)
+{
+    CombinatorialSearch* search = worker->search;
+    uint32_t n = search->count;
+    uint32_t ranks[2];
+    bool result = false;
+    uint32_t depth = 1;
+
+    // Tasks are numbered in order of the sum of the ranks of their prefixes,
+    // so that the most local prefixes are tried first. A prefix that repeats
+    // a candidate is skipped.
+
+    if (search->depth == 1)
+    {
+        ranks[0] = task;
+    }
+    else
+    {
+        combinatorial_search_diagonal(task, n, ranks);
+    }
+
+    for (; depth <= search->depth; depth++)
+    {
+        uint32_t candidate = combinatorial_search_candidate(
+            search,
+            worker->orders + depth,
+            ranks[depth - 1]);
+
+        if (worker->used[candidate])
+        {
+            goto combinatorial_search_run_exit;
+        }
+
+        if (depth == search->clusters - 1)
+        {
+            result = combinatorial_search_accepts(worker, depth, candidate) &&
+                combinatorial_search_test(worker, depth, candidate);
+
+            goto combinatorial_search_run_exit;
+        }
+
+        if (!combinatorial_search_push(worker, depth, candidate))
+        {
+            goto combinatorial_search_run_exit;
+        }
+    }
+
+    uint32_t base = depth;
+
+    worker->indices[base] = 0;
+
+    if (worker->cursorDepth)
+    {
+        depth = combinatorial_search_restore(worker, base);
+    }
+
+    result = combinatorial_search_visit(worker, base, depth);
+
+combinatorial_search_run_exit:
+    memset(worker->used, 0, n * sizeof * worker->used);
+
+    return result;
+}
+
+static bool combinatorial_search_take(
+    CombinatorialSearchWorker* worker,
+    uint64_t* task)
+{
+    bool result = false;
+
+    uint32_t index = worker - worker->workers;
+    uint32_t workerCount = worker->workerCount;
+
+    // Slot `s` of the queue of worker `w` holds task `s * workerCount + w`, so
+    // that every worker starts on the most promising tasks. A worker takes
+    // from the front of its own queue and steals from the back of another.
+
+    // The task is recorded as in progress along with the slot it leaves, so
+    // that a checkpoint never loses it.
+
+    pthread_mutex_lock(&worker->mutex);
+
+    worker->task = SEARCH_CHECKPOINT_NO_TASK;
+    worker->cursorDepth = 0;
+
+    if (worker->head < worker->tail)
+    {
+        *task = worker->head * workerCount + index;
+        worker->head++;
+        worker->task = *task;
+        result = true;
+    }
+
+    pthread_mutex_unlock(&worker->mutex);
+
+    if (result)
+    {
+        return true;
+    }
+
+    for (uint32_t i = 1; !result && i < workerCount; i++)
+    {
+        uint32_t victimIndex = (index + i) % workerCount;
+        CombinatorialSearchWorker* victim = worker->workers + victimIndex;
+
+        pthread_mutex_lock(&victim->mutex);
+
+        if (victim->head < victim->tail)
+        {
+            victim->tail--;
+            *task = victim->tail * workerCount + victimIndex;
+            worker->task = *task;
+            result = true;
+        }
+
+        pthread_mutex_unlock(&victim->mutex);
+    }
+
+    return result;
+}
+
+static void* combinatorial_search_work(void* argument)
+{
+    CombinatorialSearchWorker* worker = argument;
+    CombinatorialSearch* search = worker->search;
+    uint64_t task = worker->task;
+
+    hash_copy(worker->contexts, &search->context);
+
+    if (search->validate)
+    {
+        validator_copy(worker->validators, &search->validator);
+
+        *worker->accepted = true;
+    }
+    combinatorial_search_order(
+        search,
+        worker->orders + 1,
+        search->firstCluster);
+
+    *worker->prefix = search->firstCluster;
+
+    double start = trace_now(search->trace);
+
+    // A worker resumed from a checkpoint first finishes its task in progress.
+
+    bool taken = task != SEARCH_CHECKPOINT_NO_TASK;
+
+    while (!combinatorial_search_is_done(search) &&
+        (taken || combinatorial_search_take(worker, &task)))
+    {
+        taken = false;
+
+        double taskStart = trace_now(search->trace);
+        bool found = combinatorial_search_run(worker, task);
+
+        trace_span(search->trace, "task", taskStart);
+
+        if (found)
+        {
+            combinatorial_search_publish(worker);
+
+            break;
+        }
+
+        if (worker->counters.permutations - worker->published >=
+            worker->period)
+        {
+            combinatorial_search_tick(worker);
+        }
+    }
+
+    trace_span(search->trace, "worker", start);
+
+    return NULL;
+}
+
+static bool combinatorial_search_worker(
+    CombinatorialSearchWorker* worker,
+    CombinatorialSearch* search)
+{
+    uint32_t k = search->clusters;
+
+    worker->search = search;
+    worker->task = SEARCH_CHECKPOINT_NO_TASK;
+    worker->cursorDepth = 0;
+    worker->cursor = calloc(k, sizeof * worker->cursor);
+    worker->published = 0;
+    worker->period = search->period;
+    worker->prefix = malloc(k * sizeof * worker->prefix);
+    worker->indices = malloc(k * sizeof * worker->indices);
+    worker->orders = malloc(k * sizeof * worker->orders);
+    worker->used = calloc(search->count, sizeof * worker->used);
+    worker->contexts = malloc(k * sizeof * worker->contexts);
+    worker->contextCount = 0;
+    worker->validators = NULL;
+    worker->accepted = NULL;
+
+    if (search->validate)
+    {
+        worker->validators = malloc(k * sizeof * worker->validators);
+        worker->accepted = malloc(k * sizeof * worker->accepted);
+
+        if (!worker->validators || !worker->accepted)
+        {
+            return false;
+        }
+    }
+
+    if (!worker->cursor || !worker->prefix || !worker->indices ||
+        !worker->orders || !worker->used || !worker->contexts)
+    {
+        return false;
+    }
+
+    const HashBackend* backend = search->context.backend;
+
+    for (; worker->contextCount < k; worker->contextCount++)
+    {
+        if (!hash(worker->contexts + worker->contextCount, backend))
+        {
+            return false;
+        }
+    }
+
+    if (!hash(&worker->leaf, backend))
+    {
+        return false;
+    }
+
+    if (pthread_mutex_init(&worker->mutex, NULL) != 0)
+    {
+        finalize_hash(&worker->leaf);
+
+        return false;
+    }
+
+    return true;
+}
+
+static void combinatorial_search_free_worker(
+    CombinatorialSearchWorker* worker)
+{
+    for (uint32_t i = 0; i < worker->contextCount; i++)
+    {
+        finalize_hash(worker->contexts + i);
+    }
+
+    free(worker->cursor);
+    free(worker->prefix);
+    free(worker->indices);
+    free(worker->orders);
+    free(worker->used);
+    free(worker->contexts);
+    free(worker->validators);
+    free(worker->accepted);
+}
+
+static void finalize_combinatorial_search_worker(
+    CombinatorialSearchWorker* worker)
+{
+    pthread_mutex_destroy(&worker->mutex);
+    finalize_hash(&worker->leaf);
+    combinatorial_search_free_worker(worker);
+}
+
+static VolumeFindResult combinatorial_search_parallel(
+    CombinatorialSearch* search,
+    uint32_t threads)
+{
+    VolumeFindResult result = VOLUME_FIND_RESULT_NOT_FOUND;
+    uint64_t taskCount = search->tasks;
+    SearchCheckpoint* resume = search->resume;
+
+    search->passNumber++;
+
+    if (!taskCount)
+    {
+        return result;
+    }
+
+    // The passes before that of the checkpoint were finished. The pass of the
+    // checkpoint resumes with its own workers, whose queues fix the tasks.
+
+    if (resume)
+    {
+        if (search->pass < resume->pass)
+        {
+            return result;
+        }
+
+        search->resume = NULL;
+        threads = resume->workerCount;
+    }
+
+    if (threads > taskCount)
+    {
+        threads = taskCount;
+    }
+
+    SearchProgress* progress = search->progress;
+
+    search_progress_begin(progress, search->passNumber, search->passCount);
+    atomic_store(&search->permutations, 0);
+
+    // The workers report their work at least often enough to stop close to
+    // the node limit, and never if nobody watches it.
+
+    search->period = UINT64_MAX;
+
+    if (progress || search->checkpointPath)
+    {
+        search->period = SEARCH_PROGRESS_PERMUTATIONS;
+    }
+
+    if (progress && progress->nodeLimit)
+    {
+        uint64_t left = 0;
+
+        if (progress->nodeLimit > progress->spent)
+        {
+            left = progress->nodeLimit - progress->spent;
+        }
+
+        if (left / (2 * threads) + 1 < search->period)
+        {
+            search->period = left / (2 * threads) + 1;
+        }
+    }
+
+    CombinatorialSearchWorker* workers = calloc(threads, sizeof * workers);
+
+    if (!workers)
+    {
+        return result;
+    }
+
+    if (search->checkpointPath)
+    {
+        SearchCheckpoint* checkpoint = &search->checkpoint;
+
+        if (!search_checkpoint(checkpoint, search->clusters, threads))
+        {
+            free(workers);
+
+            return result;
+        }
+
+        checkpoint->count = search->count;
+        checkpoint->pass = search->pass;
+        search->checkpointDue = combinatorial_search_now() +
+            SEARCH_CHECKPOINT_INTERVAL;
+    }
+
+    uint32_t initialized = 0;
+    uint64_t permutations = 0;
+
+    for (; initialized < threads; initialized++)
+    {
+        CombinatorialSearchWorker* worker = workers + initialized;
+
+        if (!combinatorial_search_worker(worker, search))
+        {
+            goto combinatorial_search_parallel_exit;
+        }
+
+        worker->head = 0;
+        worker->tail = (taskCount - initialized + threads - 1) / threads;
+        worker->workers = workers;
+        worker->workerCount = threads;
+
+        if (resume)
+        {
+            SearchCheckpointCursor* cursor = resume->cursors + initialized;
+
+            worker->head = cursor->head;
+            worker->tail = cursor->tail;
+            worker->task = cursor->task;
+            worker->cursorDepth = cursor->depth;
+
+            memcpy(
+                worker->cursor,
+                cursor->ranks,
+                search->clusters * sizeof * worker->cursor);
+        }
+    }
+
+    // A worker that fails to start leaves its queue to be stolen by the
+    // others; the calling thread always participates as the first worker.
+
+    for (uint32_t w = 1; w < threads; w++)
+    {
+        workers[w].started = pthread_create(
+            &workers[w].thread,
+            NULL,
+            combinatorial_search_work,
+            workers + w) == 0;
+    }
+
+    combinatorial_search_work(workers);
+
+    for (uint32_t w = 1; w < threads; w++)
+    {
+        if (workers[w].started)
+        {
+            pthread_join(workers[w].thread, NULL);
+        }
+    }
+
+    if (atomic_load(&search->found))
+    {
+        result = VOLUME_FIND_RESULT_SHA1_FOUND;
+    }
+    else if (atomic_load(&search->stopped))
+    {
+        result = VOLUME_FIND_RESULT_STOPPED;
+
+        // A search stopped at its budget resumes from where it stopped.
+
+        if (search->checkpointPath)
+        {
+            combinatorial_search_checkpoint(search, workers, threads);
+        }
+    }
+
+combinatorial_search_parallel_exit:
+    for (uint32_t w = 0; w < initialized; w++)
+    {
+        StatsCounters* counters = &workers[w].counters;
+
+        permutations += counters->permutations;
+
+        search->counters.clusters += counters->clusters;
+        search->counters.bytes += counters->bytes;
+        search->counters.permutations += counters->permutations;
+
+        finalize_combinatorial_search_worker(workers + w);
+    }
+
+    if (initialized < threads)
+    {
+        combinatorial_search_free_worker(workers + initialized);
+    }
+
+    if (search->checkpointPath)
+    {
+        finalize_search_checkpoint(&search->checkpoint);
+    }
+
+    search_progress_end(progress, permutations);
+    free(workers);
+
+    return result;
+}
+
+static bool combinatorial_search_candidates(
+    CombinatorialSearch* search,
+    const VolumeIndex* index,
+    const Settings* settings)
+{
+    Volume* volume = search->iterator->instance;
+    VolumeFreeMap freeMap;
+
+    if (!volume_free_map(&freeMap, volume))
+    {
+        return false;
+    }
+
+    volume_free_map_reserve_index(&freeMap, index);
+
+    uint32_t n = freeMap.count;
+
+    if (settings->maxCandidates && n > settings->maxCandidates)
+    {
+        n = settings->maxCandidates;
+    }
+
+    search->candidates = malloc(n * sizeof * search->candidates);
+    search->starts = malloc(n * sizeof * search->starts);
+    search->interiors = malloc(n * sizeof * search->interiors);
+
+    if (!search->candidates || !search->starts || !search->interiors)
+    {
+        free(search->candidates);
+        free(search->starts);
+        free(search->interiors);
+        finalize_volume_free_map(&freeMap);
+
+        return false;
+    }
+
+    uint32_t cluster = 0;
+    VolumeFreeRun run;
+
+    search->count = 0;
+    search->startCount = 0;
+    search->interiorCount = 0;
+
+    // The first cluster of each free run is where a fragment most likely
+    // begins once the previous fragment has ended.
+
+    while (search->count < n &&
+        volume_free_map_next_run(&freeMap, &cluster, &run))
+    {
+        for (uint32_t i = 0; i < run.length && search->count < n; i++)
+        {
+            if (i)
+            {
+                search->interiors[search->interiorCount] = search->count;
+                search->interiorCount++;
+            }
+            else
+            {
+                search->starts[search->startCount] = search->count;
+                search->startCount++;
+            }
+
+            search->candidates[search->count] = run.first + i;
+            search->count++;
+        }
+    }
+
+    finalize_volume_free_map(&freeMap);
+
+    return true;
+}
+
+static bool combinatorial_search_is_zero(const uint8_t* data, uint32_t size)
+{
+    uint64_t accumulator = 0;
+    uint32_t i = 0;
+
+    // The words are combined without branching, so that the loop is
+    // vectorized.
+
+    for (; i + sizeof accumulator <= size; i += sizeof accumulator)
+    {
+        uint64_t word;
+
+        memcpy(&word, data + i, sizeof word);
+
+        accumulator |= word;
+    }
+
+    for (; i < size; i++)
+    {
+        accumulator |= data[i];
+    }
+
+    return !accumulator;
+}
+
+static void combinatorial_search_tails(CombinatorialSearch* search)
+{
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint32_t remainder = search->fileSize % bytesPerCluster;
+    uint32_t zeroCount = 0;
+
+    search->tails = NULL;
+
+    if (!remainder)
+    {
+        return;
+    }
+
+    bool* tails = malloc(search->count * sizeof * tails);
+
+    if (!tails)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < search->count; i++)
+    {
+        uint8_t* data = volume_root_data(
+            search->iterator,
+            search->candidates[i]);
+
+        tails[i] = combinatorial_search_is_zero(
+            data + remainder,
+            bytesPerCluster - remainder);
+        zeroCount += tails[i];
+    }
+
+    // The candidates are split only if the slack tells some of them apart.
+
+    if (!zeroCount || zeroCount == search->count)
+    {
+        free(tails);
+
+        return;
+    }
+
+    search->tails = tails;
+}
+
+static bool combinatorial_search_resumes(
+    const CombinatorialSearch* search,
+    const SearchCheckpoint* checkpoint)
+{
+    uint32_t workerCount = checkpoint->workerCount;
+
+    if (checkpoint->pass > 3 || workerCount > search->tasks)
+    {
+        return false;
+    }
+
+    // Every slot and task named by the checkpoint must be one of the tasks of
+    // the search, as it would be split among the same number of workers.
+
+    for (uint32_t w = 0; w < workerCount; w++)
+    {
+        const SearchCheckpointCursor* cursor = checkpoint->cursors + w;
+        uint64_t slots = (search->tasks - w + workerCount - 1) / workerCount;
+
+        if (cursor->tail > slots ||
+            (cursor->task != SEARCH_CHECKPOINT_NO_TASK &&
+                cursor->task >= search->tasks) ||
+            (cursor->depth && cursor->depth <= search->depth))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static VolumeFindResult combinatorial_search_passes(
+    CombinatorialSearch* search,
+    uint32_t threads)
+{
+    // The last cluster is first drawn only from the candidates whose slack is
+    // zero, as a file system leaves it when the cluster was never used before.
+    // If that fails, the search is repeated with the other candidates, so that
+    // no chain is tested twice.
+
+    search->zeroTails = true;
+    search->pass = search->prune ? 0 : 2;
+
+    VolumeFindResult result = combinatorial_search_parallel(search, threads);
+
+    if (result == VOLUME_FIND_RESULT_NOT_FOUND && search->tails)
+    {
+        search->zeroTails = false;
+        search->pass++;
+        result = combinatorial_search_parallel(search, threads);
+    }
+
+    return result;
+}
+
+VolumeFindResult combinatorial_search(
+    uint32_t results[],
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
+{
+    if (!clusters)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
+
+    if (settings->maxClusters && clusters > settings->maxClusters)
+    {
+        return VOLUME_FIND_RESULT_SKIPPED;
+    }
+
+    uint32_t hi = iterator->entry->firstClusterHi;
+    uint32_t lo = iterator->entry->firstClusterLo;
+    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+    uint8_t* data = volume_root_data(iterator, firstCluster);
+    uint32_t fileSize = iterator->entry->fileSize;
+
+    *results = firstCluster;
+
+    if (clusters == 1)
+    {
+        unsigned char digest[SHA_DIGEST_LENGTH];
+        StatsCounters counters =
+        {
+            .clusters = 1,
+            .bytes = fileSize,
+            .permutations = 1
+        };
+
+        stats_begin(settings->stats, STATS_PHASE_SEARCH);
+
+        bool found = hash_digest(digest, data, fileSize) &&
+            memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0;
+
+        stats_end(settings->stats, STATS_PHASE_SEARCH);
+        stats_add(settings->stats, STATS_PHASE_SEARCH, &counters);
+
+        if (found)
+        {
+            return VOLUME_FIND_RESULT_SHA1_FOUND;
+        }
+
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
+
+    CombinatorialSearch search;
+
+    atomic_init(&search.found, false);
+    atomic_init(&search.stopped, false);
+    atomic_init(&search.permutations, 0);
+    memset(&search.counters, 0, sizeof search.counters);
+
+    search.clusters = clusters;
+    search.fileSize = fileSize;
+    search.firstCluster = firstCluster;
+    search.results = results;
+    search.sha1 = sha1;
+    search.iterator = iterator;
+    search.trace = settings->trace;
+    search.checkpointPath = NULL;
+    search.resume = NULL;
+    search.progress = settings->progress;
+    search.passNumber = 0;
+
+    double start = trace_now(settings->trace);
+
+    stats_begin(settings->stats, STATS_PHASE_CANDIDATES);
+
+    bool candidates = combinatorial_search_candidates(
+        &search,
+        index,
+        settings);
+
+    if (candidates)
+    {
+        combinatorial_search_tails(&search);
+    }
+
+    stats_end(settings->stats, STATS_PHASE_CANDIDATES);
+    trace_span(settings->trace, "candidates", start);
+
+    if (!candidates)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
+
+    VolumeFindResult result = VOLUME_FIND_RESULT_NOT_FOUND;
+    uint32_t n = search.count;
+
+    if (n < clusters - 1)
+    {
+        goto combinatorial_search_exit;
+    }
+
+    // Each task fixes up to two clusters after the first, which yields enough
+    // tasks to balance the workers while leaving the last cluster to the
+    // depth-first search of each task.
+
+    search.depth = clusters - 1;
+    search.tasks = n;
+
+    if (search.depth > 2)
+    {
+        search.depth = 2;
+        search.tasks *= n;
+    }
+    else
+    {
+        search.depth = 1;
+    }
+
+    if (!hash(&search.context, hash_backend()))
+    {
+        goto combinatorial_search_exit;
+    }
+
+    if (pthread_mutex_init(&search.monitorMutex, NULL) != 0)
+    {
+        finalize_hash(&search.context);
+
+        goto combinatorial_search_exit;
+    }
+
+    // A checkpoint taken by an earlier run resumes the search only if it has
+    // the same key; otherwise the search starts over and replaces it.
+
+    SearchCheckpoint resume;
+    bool resumed = false;
+
+    if (settings->checkpoint &&
+        search_checkpoint_key(search.checkpoint.key, iterator, n, sha1))
+    {
+        search.checkpointPath = settings->checkpoint;
+
+        if (settings->resume &&
+            search_checkpoint_read(
+                &resume,
+                settings->checkpoint,
+                search.checkpoint.key,
+                clusters,
+                n))
+        {
+            resumed = combinatorial_search_resumes(&search, &resume);
+
+            if (resumed)
+            {
+                search.resume = &resume;
+            }
+            else
+            {
+                finalize_search_checkpoint(&resume);
+            }
+        }
+    }
+
+    stats_begin(settings->stats, STATS_PHASE_SEARCH);
+    hash_update(&search.context, data, iterator->bytesPerCluster);
+
+    search.counters.clusters = 1;
+    search.counters.bytes = iterator->bytesPerCluster;
+
+    // A file whose first cluster has the signature of a known format is
+    // first searched for among the reassemblies that the format accepts. A
+    // file that is itself malformed is still found by the unpruned search
+    // that follows.
+
+    search.format = validator_format(data, iterator->bytesPerCluster);
+
+    if (search.format)
+    {
+        validator(&search.validator, search.format);
+
+        search.validate = validator_update(
+            &search.validator,
+            data,
+            iterator->bytesPerCluster);
+    }
+    else
+    {
+        search.validate = false;
+    }
+
+    search.passCount = search.tails ? 2 : 1;
+
+    if (search.validate)
+    {
+        search.passCount *= 2;
+    }
+
+    // The search that follows tests only the reassemblies that the format
+    // rejected, so that no chain is hashed twice.
+
+    search.prune = search.validate;
+    result = combinatorial_search_passes(&search, settings->threads);
+
+    if (result == VOLUME_FIND_RESULT_NOT_FOUND && search.prune)
+    {
+        search.prune = false;
+        result = combinatorial_search_passes(&search, settings->threads);
+    }
+
+    stats_end(settings->stats, STATS_PHASE_SEARCH);
+    stats_add(settings->stats, STATS_PHASE_SEARCH, &search.counters);
+    finalize_hash(&search.context);
+
+    pthread_mutex_destroy(&search.monitorMutex);
+
+    // A finished search has nothing left to resume.
+
+    if (search.checkpointPath && result != VOLUME_FIND_RESULT_STOPPED)
+    {
+        remove(search.checkpointPath);
+    }
+
+    if (resumed)
+    {
+        finalize_search_checkpoint(&resume);
+    }
+
+combinatorial_search_exit:
+    free(search.tails);
+    free(search.candidates);
+    free(search.starts);
+    free(search.interiors);
+
+    return result;
+}
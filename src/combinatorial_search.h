@@ -0,0 +1,319 @@
+// combinatorial_search.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef COMBINATORIAL_SEARCH_H
+#define COMBINATORIAL_SEARCH_H
+#include <openssl/sha.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hash.h"
+#include "search_checkpoint.h"
+#include "settings.h"
+#include "validator.h"
+#include "volume_index.h"
+#include "volume_root_iterator.h"
+
+/**
+ * Represents the order in which the candidates are tried after a given
+ * cluster: first the candidate that continues it, then the candidates that
+ * begin a free run, then every other candidate. Within each group, candidates
+ * are taken in order of their forward distance from the cluster, wrapping
+ * around to those before it.
+ */
+struct CombinatorialSearchOrder
+{
+    /** Specifies the candidate that continues the cluster, or `count`. */
+    uint32_t next;
+
+    /** Specifies the position in `starts` of the first start to try. */
+    uint32_t start;
+
+    /** Specifies the number of starts to try. */
+    uint32_t startCount;
+
+    /** Specifies the position in `interiors` of the first interior to try. */
+    uint32_t interior;
+
+    /** Specifies the number of interiors to try. */
+    uint32_t interiorCount;
+};
+
+/** Represents the order in which the candidates are tried after a cluster. */
+typedef struct CombinatorialSearchOrder CombinatorialSearchOrder;
+
+/**
+ * Represents a best-first search over the k-permutations of candidate
+ * clusters for a fragmented file. The search space is partitioned into tasks,
+ * each of which fixes a short prefix of the cluster chain; the tasks are
+ * numbered so that the most local prefixes come first, and are distributed
+ * among a pool of workers. Below its prefix, each task is searched depth
+ * first, trying the candidates in order of locality at every depth.
+ */
+struct CombinatorialSearch
+{
+    /** `true` if any worker has found a match; otherwise, `false`. */
+    atomic_bool found;
+
+    /** `true` if the search spent its budget; otherwise, `false`. */
+    atomic_bool stopped;
+
+    /** Specifies the number of permutations reported in the current pass. */
+    atomic_uint_least64_t permutations;
+
+    /** Specifies the number of clusters in the file. */
+    uint32_t clusters;
+
+    /** Specifies the number of candidate clusters. */
+    uint32_t count;
+
+    /** Specifies the file size in bytes. */
+    uint32_t fileSize;
+
+    /** Specifies the number of clusters fixed by each task. */
+    uint32_t depth;
+
+    /** Specifies the first cluster of the file. */
+    uint32_t firstCluster;
+
+    /** Specifies the number of tasks. */
+    uint64_t tasks;
+
+    /** Specifies the number of candidates that begin a free run. */
+    uint32_t startCount;
+
+    /** Specifies the number of candidates that do not begin a free run. */
+    uint32_t interiorCount;
+
+    /** Specifies the candidate cluster numbers, in ascending order. */
+    uint32_t* candidates;
+
+    /** Specifies the indices of the candidates that begin a free run. */
+    uint32_t* starts;
+
+    /** Specifies the indices of the candidates that do not begin a free run. */
+    uint32_t* interiors;
+
+    /**
+     * `true` if the slack of the corresponding candidate, read as the last
+     * cluster of the file, is zero; or `NULL` if every candidate is tried as
+     * the last cluster.
+     */
+    bool* tails;
+
+    /**
+     * `true` to try only the candidates whose slack is zero as the last
+     * cluster; `false` to try only the others.
+     */
+    bool zeroTails;
+
+    /** Specifies the pass of the search, from `0` to `3`. */
+    uint32_t pass;
+
+    /** Specifies the pass of the search in the order run, from `1`. */
+    uint32_t passNumber;
+
+    /** Specifies the number of passes run by the search. */
+    uint32_t passCount;
+
+    /** Specifies the cluster chain published by the winning worker. */
+    uint32_t* results;
+
+    /** Specifies the SHA-1 state after hashing the first cluster. */
+    Hash context;
+
+    /** The format of the file, or `NULL` if the format is not validated. */
+    const ValidatorFormat* format;
+
+    /** `true` if the format is validated. */
+    bool validate;
+
+    /**
+     * `true` to test only the reassemblies that the format accepts; `false`
+     * to test only those that it rejects, or every one if `validate` is
+     * `false`.
+     */
+    bool prune;
+
+    /** Specifies the validator state after validating the first cluster. */
+    Validator validator;
+
+    /** The work done by every worker, added once the workers are joined. */
+    StatsCounters counters;
+
+    /** The SHA-1 digest to match. */
+    unsigned char* sha1;
+
+    /** The iterator used to locate cluster data. */
+    VolumeRootIterator* iterator;
+
+    /** The timeline on which each worker and task is recorded, or `NULL`. */
+    Trace* trace;
+
+    /**
+     * A pointer to a zero-terminated string containing the path of the
+     * checkpoint file, or `NULL` if no checkpoint is taken.
+     */
+    const char* checkpointPath;
+
+    /** The checkpoint from which the search resumes, or `NULL`. */
+    SearchCheckpoint* resume;
+
+    /** The checkpoint last taken, whose key is that of the search. */
+    SearchCheckpoint checkpoint;
+
+    /** Specifies the time at which the next checkpoint is due. */
+    double checkpointDue;
+
+    /** The progress and budget of the search, or `NULL`. */
+    SearchProgress* progress;
+
+    /**
+     * Specifies the greatest number of permutations each worker tests between
+     * two reports of its work.
+     */
+    uint64_t period;
+
+    /**
+     * Ensures that one worker at a time updates the progress or takes a
+     * checkpoint.
+     */
+    pthread_mutex_t monitorMutex;
+};
+
+/**
+ * Represents a depth-first search over the k-permutations of candidate
+ * clusters for a fragmented file.
+ */
+typedef struct CombinatorialSearch CombinatorialSearch;
+
+/**
+ * Represents a worker in a combinatorial search. Each worker owns a double-
+ * ended queue of every `workerCount`-th task: it takes tasks from the front of
+ * its own queue, the most promising first, and, once empty, steals tasks from
+ * the back of the queues of other workers.
+ */
+struct CombinatorialSearchWorker
+{
+    /** `true` if the worker runs on its own thread; otherwise, `false`. */
+    bool started;
+
+    /** Specifies the slot of the first task in the queue. */
+    uint64_t head;
+
+    /** Specifies the slot one past the last task in the queue. */
+    uint64_t tail;
+
+    /** Specifies the task in progress, or `SEARCH_CHECKPOINT_NO_TASK`. */
+    uint64_t task;
+
+    /**
+     * Specifies the depth of the last cursor published within the task in
+     * progress, or `0` if the task starts over.
+     */
+    uint32_t cursorDepth;
+
+    /** Specifies the rank at each depth of the last cursor published. */
+    uint32_t* cursor;
+
+    /** Specifies the number of permutations tested when last reported. */
+    uint64_t published;
+
+    /**
+     * Specifies the number of permutations the worker tests before it next
+     * reports its work, which shrinks with the budget left.
+     */
+    uint64_t period;
+
+    /** Specifies the cluster chain of the current prefix. */
+    uint32_t* prefix;
+
+    /** Specifies the rank of the candidate chosen at each depth. */
+    uint32_t* indices;
+
+    /** Specifies the order of the candidates at each depth. */
+    CombinatorialSearchOrder* orders;
+
+    /** `true` if the corresponding candidate is part of the current prefix. */
+    bool* used;
+
+    /** Specifies the SHA-1 state after hashing each prefix of the file. */
+    Hash* contexts;
+
+    /** Specifies the number of initialized elements in `contexts`. */
+    uint32_t contextCount;
+
+    /** Specifies the SHA-1 state used to finish each candidate. */
+    Hash leaf;
+
+    /** Specifies the validator state after validating each prefix. */
+    Validator* validators;
+
+    /** Specifies the validator state used to finish each candidate. */
+    Validator leafValidator;
+
+    /** Specifies whether the format accepts each prefix. */
+    bool* accepted;
+
+    /** The work done by the worker. */
+    StatsCounters counters;
+
+    /** Synchronizes access to the queue, the task and the cursor. */
+    pthread_mutex_t mutex;
+
+    /** The thread running the worker. */
+    pthread_t thread;
+
+    /** The search. */
+    CombinatorialSearch* search;
+
+    /** The workers participating in the search. */
+    struct CombinatorialSearchWorker* workers;
+
+    /** Specifies the number of workers participating in the search. */
+    uint32_t workerCount;
+};
+
+/** Represents a worker in a combinatorial search. */
+typedef struct CombinatorialSearchWorker CombinatorialSearchWorker;
+
+/**
+ * Searches for the cluster chain of a free file whose SHA-1 digest matches the
+ * given digest. The first cluster is taken from the directory entry; every
+ * other cluster is drawn, in order of locality to the cluster before it, from
+ * the clusters that are free in the file allocation table and not referenced
+ * as the first cluster of an indexed entry.
+ *
+ * Given `settings->checkpoint`, the queue and cursor of every worker are saved
+ * to the checkpoint file every `SEARCH_CHECKPOINT_INTERVAL` seconds, and the
+ * file is removed once the search finishes. Given `settings->resume` as well,
+ * a search whose checkpoint matches resumes from it on as many workers as it
+ * was saved from; the work since the checkpoint is done again.
+ *
+ * Given `settings->progress`, the workers report their work to it, and the
+ * search stops once it spends the budget of the run. A stopped search leaves
+ * its checkpoint behind, from which it resumes.
+ *
+ * @param results  when this method returns, contains the cluster chain of the
+ *                 file if a match was found. This argument is passed
+ *                 uninitialized and must have room for `clusters` elements.
+ * @param clusters the number of clusters in the file.
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param index    the index of the deleted files and directories, whose
+ *                 first clusters are never drawn.
+ * @param sha1     the SHA-1 digest to match.
+ * @param settings the search settings.
+ * @return `VOLUME_FIND_RESULT_SHA1_FOUND` if a match was found;
+ *         `VOLUME_FIND_RESULT_STOPPED` if the budget was spent first;
+ *         `VOLUME_FIND_RESULT_SKIPPED` if the file has more clusters than
+ *         `--max-clusters`; otherwise, `VOLUME_FIND_RESULT_NOT_FOUND`.
+ */
+VolumeFindResult combinatorial_search(
+    uint32_t results[],
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+#endif
@@ -5,6 +5,8 @@
 // References
 //   - Microsoft Extensible Firmware Initiative FAT32 File System Specification
 
+#ifndef FAT32_BOOT_SECTOR_H
+#define FAT32_BOOT_SECTOR_H
 #include <stdint.h>
 #pragma pack(push, 1)
 
@@ -214,3 +216,5 @@ struct Fat32BootSector
 typedef struct Fat32BootSector Fat32BootSector;
 
 #pragma pack(pop)
+
+#endif
@@ -2,6 +2,8 @@
 // Copyright (c) 2024 Ishan Pranav
 // Licensed under the MIT license.
 
+#ifndef FAT32_DIRECTORY_ENTRY_H
+#define FAT32_DIRECTORY_ENTRY_H
 #include <stdint.h>
 #pragma pack(push, 1)
 
@@ -124,3 +126,5 @@ struct Fat32DirectoryEntry
 typedef struct Fat32DirectoryEntry Fat32DirectoryEntry;
 
 #pragma pack(pop)
+
+#endif
@@ -0,0 +1,579 @@
+// hash.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - FIPS 180-4 Secure Hash Standard (SHS)
+//  - https://docs.openssl.org/3.0/man3/EVP_DigestInit/
+//  - https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sha-extensions.html
+//  - https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+//  - https://www.man7.org/linux/man-pages/man3/pthread_once.3p.html
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include "hash.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HASH_X86
+#endif
+
+// From FIPS 180-4:
+//   For SHA-1, the initial hash value, H(0), shall consist of the following
+//   five 32-bit words, in hex.
+
+static const uint32_t HASH_INITIAL_STATE[5] =
+{
+    0x67452301,
+    0xefcdab89,
+    0x98badcfe,
+    0x10325476,
+    0xc3d2e1f0
+};
+
+static uint32_t hash_rol(uint32_t value, int count)
+{
+    return (value << count) | (value >> (32 - count));
+}
+
+#define HASH_PORTABLE_ROUNDS(first, last, f, k) \
+    for (int t = (first); t < (last); t++) \
+    { \
+        if (t >= 16) \
+        { \
+            uint32_t x = w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ \
+                w[(t - 14) & 15] ^ w[t & 15]; \
+            \
+            w[t & 15] = hash_rol(x, 1); \
+        } \
+        \
+        uint32_t temp = hash_rol(a, 5) + (f) + e + (k) + w[t & 15]; \
+        \
+        e = d; \
+        d = c; \
+        c = hash_rol(b, 30); \
+        b = a; \
+        a = temp; \
+    }
+
+static bool hash_supported(void)
+{
+    return true;
+}
+
+static void hash_portable_compress(
+    uint32_t state[5],
+    const uint8_t* data,
+    size_t blocks)
+{
+    for (; blocks; blocks--, data += HASH_BLOCK)
+    {
+        uint32_t w[16];
+
+        for (int t = 0; t < 16; t++)
+        {
+            const uint8_t* word = data + t * 4;
+
+            w[t] = ((uint32_t)word[0] << 24) | ((uint32_t)word[1] << 16) |
+                ((uint32_t)word[2] << 8) | word[3];
+        }
+
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+
+        // The rounds are grouped by stage, so that each loop has a fixed round
+        // function and constant.
+
+        HASH_PORTABLE_ROUNDS(0, 20, d ^ (b & (c ^ d)), 0x5a827999);
+        HASH_PORTABLE_ROUNDS(20, 40, b ^ c ^ d, 0x6ed9eba1);
+        HASH_PORTABLE_ROUNDS(40, 60, (b & c) | (d & (b | c)), 0x8f1bbcdc);
+        HASH_PORTABLE_ROUNDS(60, 80, b ^ c ^ d, 0xca62c1d6);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#ifdef HASH_X86
+
+#pragma GCC push_options
+#pragma GCC target("sha,sse4.1")
+
+// Each group of four rounds consumes one message vector, finishes the
+// schedule of the next and begins the schedule of the ones after it. The
+// function selector of `sha1rnds4` must be a constant, so the groups are
+// written out.
+
+#define HASH_X86_GROUP(g, current, next) \
+    do \
+    { \
+        __m128i* w = m + (g) % 4; \
+        __m128i* w1 = m + ((g) + 1) % 4; \
+        __m128i* w2 = m + ((g) + 2) % 4; \
+        __m128i* w3 = m + ((g) + 3) % 4; \
+        \
+        current = _mm_sha1nexte_epu32(current, *w); \
+        next = abcd; \
+        \
+        if ((g) >= 3 && (g) <= 18) \
+        { \
+            *w1 = _mm_sha1msg2_epu32(*w1, *w); \
+        } \
+        \
+        abcd = _mm_sha1rnds4_epu32(abcd, current, (g) / 5); \
+        \
+        if ((g) <= 16) \
+        { \
+            *w3 = _mm_sha1msg1_epu32(*w3, *w); \
+        } \
+        \
+        if ((g) >= 2 && (g) <= 17) \
+        { \
+            *w2 = _mm_xor_si128(*w2, *w); \
+        } \
+    } while (0)
+
+static bool hash_x86_supported(void)
+{
+    return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+}
+
+static void hash_x86_compress(
+    uint32_t state[5],
+    const uint8_t* data,
+    size_t blocks)
+{
+    const __m128i swap = _mm_set_epi64x(
+        0x0001020304050607LL,
+        0x08090a0b0c0d0e0fLL);
+    __m128i abcd = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i*)state),
+        0x1b);
+    __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (; blocks; blocks--, data += HASH_BLOCK)
+    {
+        __m128i savedAbcd = abcd;
+        __m128i savedE = e0;
+        __m128i e1;
+        __m128i m[4];
+
+        for (int i = 0; i < 4; i++)
+        {
+            m[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i*)(data + i * 16)),
+                swap);
+        }
+
+        e0 = _mm_add_epi32(e0, m[0]);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        HASH_X86_GROUP(1, e1, e0);
+        HASH_X86_GROUP(2, e0, e1);
+        HASH_X86_GROUP(3, e1, e0);
+        HASH_X86_GROUP(4, e0, e1);
+        HASH_X86_GROUP(5, e1, e0);
+        HASH_X86_GROUP(6, e0, e1);
+        HASH_X86_GROUP(7, e1, e0);
+        HASH_X86_GROUP(8, e0, e1);
+        HASH_X86_GROUP(9, e1, e0);
+        HASH_X86_GROUP(10, e0, e1);
+        HASH_X86_GROUP(11, e1, e0);
+        HASH_X86_GROUP(12, e0, e1);
+        HASH_X86_GROUP(13, e1, e0);
+        HASH_X86_GROUP(14, e0, e1);
+        HASH_X86_GROUP(15, e1, e0);
+        HASH_X86_GROUP(16, e0, e1);
+        HASH_X86_GROUP(17, e1, e0);
+        HASH_X86_GROUP(18, e0, e1);
+        HASH_X86_GROUP(19, e1, e0);
+
+        e0 = _mm_sha1nexte_epu32(e0, savedE);
+        abcd = _mm_add_epi32(abcd, savedAbcd);
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#pragma GCC pop_options
+
+#endif
+
+static bool hash_block_reset(Hash* instance)
+{
+    memcpy(instance->state, HASH_INITIAL_STATE, sizeof instance->state);
+
+    instance->length = 0;
+
+    return true;
+}
+
+static void hash_block_update(Hash* instance, const void* data, size_t size)
+{
+    const uint8_t* bytes = data;
+    uint32_t count = instance->length % HASH_BLOCK;
+
+    instance->length += size;
+
+    if (count)
+    {
+        uint32_t space = HASH_BLOCK - count;
+
+        if (size < space)
+        {
+            memcpy(instance->buffer + count, bytes, size);
+
+            return;
+        }
+
+        memcpy(instance->buffer + count, bytes, space);
+        instance->backend->compress(instance->state, instance->buffer, 1);
+
+        bytes += space;
+        size -= space;
+    }
+
+    size_t blocks = size / HASH_BLOCK;
+
+    if (blocks)
+    {
+        instance->backend->compress(instance->state, bytes, blocks);
+    }
+
+    memcpy(
+        instance->buffer,
+        bytes + blocks * HASH_BLOCK,
+        size % HASH_BLOCK);
+}
+
+static void hash_block_final(
+    Hash* instance,
+    unsigned char digest[HASH_DIGEST_LENGTH])
+{
+    // From FIPS 180-4:
+    //   Append the bit "1" to the end of the message, followed by k zero bits
+    //   [...] Then append the 64-bit block that is equal to the number l
+    //   expressed using a binary representation.
+
+    uint32_t count = instance->length % HASH_BLOCK;
+    uint32_t blocks = count < HASH_BLOCK - 8 ? 1 : 2;
+    uint64_t bits = instance->length * 8;
+    uint8_t tail[2 * HASH_BLOCK] = { 0 };
+
+    memcpy(tail, instance->buffer, count);
+
+    tail[count] = 0x80;
+
+    for (int i = 0; i < 8; i++)
+    {
+        tail[blocks * HASH_BLOCK - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+
+    instance->backend->compress(instance->state, tail, blocks);
+
+    for (int i = 0; i < 5; i++)
+    {
+        digest[i * 4] = instance->state[i] >> 24;
+        digest[i * 4 + 1] = instance->state[i] >> 16;
+        digest[i * 4 + 2] = instance->state[i] >> 8;
+        digest[i * 4 + 3] = instance->state[i];
+    }
+}
+
+static bool hash_block_copy(Hash* instance, const Hash* source)
+{
+    memcpy(instance->state, source->state, sizeof instance->state);
+    memcpy(instance->buffer, source->buffer, source->length % HASH_BLOCK);
+
+    instance->length = source->length;
+
+    return true;
+}
+
+static bool hash_evp_reset(Hash* instance)
+{
+    return EVP_DigestInit_ex(instance->evp, EVP_sha1(), NULL) == 1;
+}
+
+static void hash_evp_update(Hash* instance, const void* data, size_t size)
+{
+    EVP_DigestUpdate(instance->evp, data, size);
+}
+
+static void hash_evp_final(
+    Hash* instance,
+    unsigned char digest[HASH_DIGEST_LENGTH])
+{
+    EVP_DigestFinal_ex(instance->evp, digest, NULL);
+}
+
+static bool hash_evp_copy(Hash* instance, const Hash* source)
+{
+    return EVP_MD_CTX_copy_ex(instance->evp, source->evp) == 1;
+}
+
+#ifdef HASH_X86
+static const HashBackend HASH_BACKEND_X86 =
+{
+    .name = "x86-sha",
+    .supported = hash_x86_supported,
+    .compress = hash_x86_compress,
+    .reset = hash_block_reset,
+    .update = hash_block_update,
+    .final = hash_block_final,
+    .copy = hash_block_copy
+};
+#endif
+
+static const HashBackend HASH_BACKEND_OPENSSL =
+{
+    .name = "openssl",
+    .supported = hash_supported,
+    .reset = hash_evp_reset,
+    .update = hash_evp_update,
+    .final = hash_evp_final,
+    .copy = hash_evp_copy
+};
+
+static const HashBackend HASH_BACKEND_PORTABLE =
+{
+    .name = "portable",
+    .supported = hash_supported,
+    .compress = hash_portable_compress,
+    .reset = hash_block_reset,
+    .update = hash_block_update,
+    .final = hash_block_final,
+    .copy = hash_block_copy
+};
+
+// The dedicated instructions are fastest where present; otherwise, OpenSSL
+// brings its own vectorized assembly.
+
+const HashBackend* const HASH_BACKENDS[] =
+{
+#ifdef HASH_X86
+    &HASH_BACKEND_X86,
+#endif
+    &HASH_BACKEND_OPENSSL,
+    &HASH_BACKEND_PORTABLE,
+    NULL
+};
+
+static pthread_once_t hashBackendOnce = PTHREAD_ONCE_INIT;
+static const HashBackend* hashBackend = &HASH_BACKEND_PORTABLE;
+
+static void hash_backend_select(void)
+{
+    for (const HashBackend* const* p = HASH_BACKENDS; *p; p++)
+    {
+        if ((*p)->supported() && hash_self_test(*p))
+        {
+            hashBackend = *p;
+
+            return;
+        }
+    }
+}
+
+const HashBackend* hash_backend(void)
+{
+    pthread_once(&hashBackendOnce, hash_backend_select);
+
+    return hashBackend;
+}
+
+bool hash(Hash* instance, const HashBackend* backend)
+{
+    instance->backend = backend;
+    instance->evp = NULL;
+
+    if (!backend->compress)
+    {
+        instance->evp = EVP_MD_CTX_new();
+
+        if (!instance->evp)
+        {
+            errno = ENOMEM;
+
+            return false;
+        }
+    }
+
+    if (!backend->reset(instance))
+    {
+        finalize_hash(instance);
+
+        errno = EINVAL;
+
+        return false;
+    }
+
+    return true;
+}
+
+void hash_update(Hash* instance, const void* data, size_t size)
+{
+    instance->backend->update(instance, data, size);
+}
+
+void hash_final(Hash* instance, unsigned char digest[HASH_DIGEST_LENGTH])
+{
+    instance->backend->final(instance, digest);
+}
+
+bool hash_copy(Hash* instance, const Hash* source)
+{
+    return instance->backend->copy(instance, source);
+}
+
+bool hash_export(const Hash* instance, uint32_t state[5], uint64_t* length)
+{
+    if (!instance->backend->compress || instance->length % HASH_BLOCK)
+    {
+        return false;
+    }
+
+    memcpy(state, instance->state, sizeof instance->state);
+
+    *length = instance->length;
+
+    return true;
+}
+
+bool hash_digest(
+    unsigned char digest[HASH_DIGEST_LENGTH],
+    const void* data,
+    size_t size)
+{
+    Hash context;
+
+    if (!hash(&context, hash_backend()))
+    {
+        return false;
+    }
+
+    hash_update(&context, data, size);
+    hash_final(&context, digest);
+    finalize_hash(&context);
+
+    return true;
+}
+
+static bool hash_self_test_vector(
+    const HashBackend* backend,
+    const char* message,
+    size_t repeat,
+    const char* expected)
+{
+    Hash context;
+    Hash copy;
+    bool result = false;
+
+    if (!hash(&context, backend))
+    {
+        return false;
+    }
+
+    if (!hash(&copy, backend))
+    {
+        goto hash_self_test_vector_exit;
+    }
+
+    // The message is hashed in pieces of varying length, which exercises the
+    // partial-block buffer, and the state is copied after every piece.
+
+    size_t length = strlen(message);
+    size_t size = length * repeat;
+    size_t step = 1;
+    uint8_t piece[256];
+
+    for (size_t offset = 0; offset < size; step = step * 7 % 251 + 1)
+    {
+        size_t count = size - offset < step ? size - offset : step;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            piece[i] = message[(offset + i) % length];
+        }
+
+        hash_update(&context, piece, count);
+
+        offset += count;
+
+        if (!hash_copy(&copy, &context) || !hash_copy(&context, &copy))
+        {
+            goto hash_self_test_vector_exit_copy;
+        }
+    }
+
+    unsigned char digest[HASH_DIGEST_LENGTH];
+    char hex[2 * HASH_DIGEST_LENGTH + 1];
+
+    hash_final(&context, digest);
+
+    for (int i = 0; i < HASH_DIGEST_LENGTH; i++)
+    {
+        static const char DIGITS[] = "0123456789abcdef";
+
+        hex[i * 2] = DIGITS[digest[i] >> 4];
+        hex[i * 2 + 1] = DIGITS[digest[i] & 15];
+    }
+
+    hex[2 * HASH_DIGEST_LENGTH] = '\0';
+    result = strcmp(hex, expected) == 0;
+
+hash_self_test_vector_exit_copy:
+    finalize_hash(&copy);
+
+hash_self_test_vector_exit:
+    finalize_hash(&context);
+
+    return result;
+}
+
+bool hash_self_test(const HashBackend* backend)
+{
+    // From FIPS 180-4 examples: "abc" and the 448-bit message, together with
+    // the empty message. These run on every start, so they are kept short.
+
+    return hash_self_test_vector(
+            backend,
+            "",
+            1,
+            "da39a3ee5e6b4b0d3255bfef95601890afd80709") &&
+        hash_self_test_vector(
+            backend,
+            "abc",
+            1,
+            "a9993e364706816aba3e25717850c26c9cd0d89d") &&
+        hash_self_test_vector(
+            backend,
+            "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+            1,
+            "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+}
+
+bool hash_self_test_long(const HashBackend* backend)
+{
+    // From FIPS 180-4 examples: one million repetitions of "a".
+
+    return hash_self_test_vector(
+        backend,
+        "a",
+        1000000,
+        "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
+
+void finalize_hash(Hash* instance)
+{
+    EVP_MD_CTX_free(instance->evp);
+}
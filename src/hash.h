@@ -0,0 +1,213 @@
+// hash.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef HASH_H
+#define HASH_H
+#include <openssl/evp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Specifies the SHA-1 block size in bytes. */
+#define HASH_BLOCK 64
+
+/** Specifies the SHA-1 digest length in bytes. */
+#define HASH_DIGEST_LENGTH 20
+
+struct HashBackend;
+
+/** Represents the state of an incremental SHA-1 computation. */
+struct Hash
+{
+    /** The backend that computes the digest. */
+    const struct HashBackend* backend;
+
+    /** Specifies the chaining value after the last complete block. */
+    uint32_t state[5];
+
+    /** Specifies the number of bytes hashed so far. */
+    uint64_t length;
+
+    /** Specifies the bytes of the current, incomplete block. */
+    uint8_t buffer[HASH_BLOCK];
+
+    /** The OpenSSL digest context, or `NULL` for the block-based backends. */
+    EVP_MD_CTX* evp;
+};
+
+/** Represents the state of an incremental SHA-1 computation. */
+typedef struct Hash Hash;
+
+/**
+ * Represents an implementation of SHA-1. The block-based backends provide a
+ * compression function and share the buffering and padding logic; the
+ * OpenSSL backend delegates every operation to the EVP interface.
+ */
+struct HashBackend
+{
+    /** The name of the backend. */
+    const char* name;
+
+    /**
+     * Determines whether the processor supports the backend.
+     *
+     * @return `true` if the backend can run; otherwise, `false`.
+     */
+    bool (*supported)(void);
+
+    /**
+     * Applies the compression function to consecutive blocks, or `NULL` if the
+     * backend does not expose its compression function.
+     *
+     * @param state  the chaining value.
+     * @param data   the blocks.
+     * @param blocks the number of blocks.
+     */
+    void (*compress)(uint32_t state[5], const uint8_t* data, size_t blocks);
+
+    /**
+     * Resets a `Hash` instance to the initial SHA-1 state.
+     *
+     * @param instance the `Hash` instance.
+     * @return `true` if the operation succeeded; otherwise, `false`.
+     */
+    bool (*reset)(Hash* instance);
+
+    /**
+     * Hashes additional data.
+     *
+     * @param instance the `Hash` instance.
+     * @param data     the data.
+     * @param size     the number of bytes in `data`.
+     */
+    void (*update)(Hash* instance, const void* data, size_t size);
+
+    /**
+     * Completes the computation.
+     *
+     * @param instance the `Hash` instance. This method leaves the instance in
+     *                 an unspecified state until it is reset or overwritten.
+     * @param digest   when this method returns, contains the digest. This
+     *                 argument is passed uninitialized.
+     */
+    void (*final)(Hash* instance, unsigned char digest[HASH_DIGEST_LENGTH]);
+
+    /**
+     * Copies the state of one `Hash` instance to another.
+     *
+     * @param instance the destination, initialized with the same backend.
+     * @param source   the source.
+     * @return `true` if the operation succeeded; otherwise, `false`.
+     */
+    bool (*copy)(Hash* instance, const Hash* source);
+};
+
+/** Represents an implementation of SHA-1. */
+typedef struct HashBackend HashBackend;
+
+/** Specifies every backend in order of preference, followed by `NULL`. */
+extern const HashBackend* const HASH_BACKENDS[];
+
+/**
+ * Gets the preferred backend: the first backend that the processor supports
+ * and that passes its self-test. The backend is chosen once, on first use.
+ *
+ * @return The preferred backend.
+ */
+const HashBackend* hash_backend(void);
+
+/**
+ * Verifies a backend against the short known-answer tests of FIPS 180-4,
+ * hashing the messages in irregular pieces and through copied states. The
+ * tests are cheap enough to run whenever a backend is chosen.
+ *
+ * @param backend the backend.
+ * @return `true` if every test passed; otherwise, `false`.
+ */
+bool hash_self_test(const HashBackend* backend);
+
+/**
+ * Verifies a backend against the one-million-character known-answer test of
+ * FIPS 180-4, in the same way as `hash_self_test`. The test takes a few
+ * milliseconds, so it is left to the benchmark.
+ *
+ * @param backend the backend.
+ * @return `true` if the test passed; otherwise, `false`.
+ */
+bool hash_self_test_long(const HashBackend* backend);
+
+/**
+ * Initializes an instance of the `Hash` struct to the initial SHA-1 state.
+ *
+ * @param instance the `Hash` instance.
+ * @param backend  the backend, usually `hash_backend()`.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool hash(Hash* instance, const HashBackend* backend);
+
+/**
+ * Hashes additional data.
+ *
+ * @param instance the `Hash` instance.
+ * @param data     the data.
+ * @param size     the number of bytes in `data`.
+ */
+void hash_update(Hash* instance, const void* data, size_t size);
+
+/**
+ * Completes the computation.
+ *
+ * @param instance the `Hash` instance.
+ * @param digest   when this method returns, contains the digest. This argument
+ *                 is passed uninitialized.
+ */
+void hash_final(Hash* instance, unsigned char digest[HASH_DIGEST_LENGTH]);
+
+/**
+ * Copies the state of one `Hash` instance to another with the same backend.
+ *
+ * @param instance the destination `Hash` instance.
+ * @param source   the source `Hash` instance.
+ * @return `true` if the operation succeeded; otherwise, `false`.
+ */
+bool hash_copy(Hash* instance, const Hash* source);
+
+/**
+ * Exports the chaining value of a computation that ended on a block boundary,
+ * so that it can be resumed by another implementation.
+ *
+ * @param instance the `Hash` instance.
+ * @param state    when this method returns, contains the chaining value. This
+ *                 argument is passed uninitialized.
+ * @param length   when this method returns, contains the number of bytes
+ *                 hashed so far. This argument is passed uninitialized.
+ * @return `true` if the state was exported; `false` if the backend hides its
+ *         state or the computation is not on a block boundary.
+ */
+bool hash_export(const Hash* instance, uint32_t state[5], uint64_t* length);
+
+/**
+ * Computes the digest of a message with the preferred backend.
+ *
+ * @param digest when this method returns, contains the digest. This argument
+ *               is passed uninitialized.
+ * @param data   the message.
+ * @param size   the number of bytes in `data`.
+ * @return `true` if the operation succeeded; otherwise, `false`.
+ */
+bool hash_digest(
+    unsigned char digest[HASH_DIGEST_LENGTH],
+    const void* data,
+    size_t size);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `Hash` instance. This method corrupts the `instance`
+ *                 argument.
+ */
+void finalize_hash(Hash* instance);
+
+#endif
@@ -10,7 +10,8 @@ void information_utility(
     FILE* output,
     Volume* volume,
     UTILITY_UNUSED const char* recover,
-    UTILITY_UNUSED unsigned char sha1[SHA_DIGEST_LENGTH])
+    UTILITY_UNUSED unsigned char sha1[SHA_DIGEST_LENGTH],
+    UTILITY_UNUSED const Settings* settings)
 {
     Fat32BootSector* bootSector = volume->data;
 
@@ -11,7 +11,8 @@ void list_utility(
     FILE* output,
     Volume* volume,
     UTILITY_UNUSED const char* recover,
-    UTILITY_UNUSED unsigned char sha1[SHA_DIGEST_LENGTH])
+    UTILITY_UNUSED unsigned char sha1[SHA_DIGEST_LENGTH],
+    UTILITY_UNUSED const Settings* settings)
 {
     uint32_t entries = 0;
     VolumeRootIterator it;
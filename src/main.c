@@ -5,23 +5,77 @@
 // References:
 //  - https://www.man7.org/linux/man-pages/man3/getopt.3.html
 //  - https://www.man7.org/linux/man-pages/man3/sscanf.3.html
+//  - https://www.man7.org/linux/man-pages/man3/strtoul.3.html
 //  - https://www.gnu.org/software/libc/manual/html_node/Using-Getopt.html
+//  - https://www.gnu.org/software/libc/manual/html_node/Getopt-Long-Options.html
+//  - https://www.man7.org/linux/man-pages/man3/fopen.3.html
 //  - https://stackoverflow.com/questions/3408706/hexadecimal-string-to-byte-array-in-c
 
+#include <errno.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "fat32_attributes.h"
 #include "options.h"
 #include "utility.h"
+#include "volume_patch.h"
 #include "volume_root_iterator.h"
+#include "volume_transaction.h"
+
+enum MainOption
+{
+    MAIN_OPTION_MAX_CANDIDATES = 256,
+    MAIN_OPTION_MAX_CLUSTERS,
+    MAIN_OPTION_STRATEGY,
+    MAIN_OPTION_MAX_RUNS,
+    MAIN_OPTION_STATS,
+    MAIN_OPTION_STATS_FILE,
+    MAIN_OPTION_TRACE,
+    MAIN_OPTION_TOP,
+    MAIN_OPTION_NODE_LIMIT,
+    MAIN_OPTION_TIME_LIMIT,
+    MAIN_OPTION_EXPLAIN,
+    MAIN_OPTION_CHECKPOINT,
+    MAIN_OPTION_RESUME,
+    MAIN_OPTION_PROGRESS
+};
+
+static const struct option MAIN_OPTIONS[] =
+{
+    { "max-candidates", required_argument, NULL, MAIN_OPTION_MAX_CANDIDATES },
+    { "max-clusters", required_argument, NULL, MAIN_OPTION_MAX_CLUSTERS },
+    { "strategy", required_argument, NULL, MAIN_OPTION_STRATEGY },
+    { "max-runs", required_argument, NULL, MAIN_OPTION_MAX_RUNS },
+    { "stats", required_argument, NULL, MAIN_OPTION_STATS },
+    { "stats-file", required_argument, NULL, MAIN_OPTION_STATS_FILE },
+    { "trace", required_argument, NULL, MAIN_OPTION_TRACE },
+    { "top", required_argument, NULL, MAIN_OPTION_TOP },
+    { "node-limit", required_argument, NULL, MAIN_OPTION_NODE_LIMIT },
+    { "time-limit", required_argument, NULL, MAIN_OPTION_TIME_LIMIT },
+    { "explain", no_argument, NULL, MAIN_OPTION_EXPLAIN },
+    { "checkpoint", required_argument, NULL, MAIN_OPTION_CHECKPOINT },
+    { "resume", no_argument, NULL, MAIN_OPTION_RESUME },
+    { "progress", no_argument, NULL, MAIN_OPTION_PROGRESS },
+    { NULL, 0, NULL, 0 }
+};
+
+static const char* MAIN_STRATEGIES[] =
+{
+    [SEARCH_STRATEGY_PERMUTATION] = "permutation",
+    [SEARCH_STRATEGY_RUN] = "run",
+    [SEARCH_STRATEGY_AUTO] = "auto"
+};
 
 static const Utility UTILITIES_BY_OPTIONS[] =
 {
     [OPTIONS_INFORMATION] = information_utility,
     [OPTIONS_LIST] = list_utility,
     [OPTIONS_RECOVER_CONTIGUOUS] = recover_contiguous_utility,
-    [OPTIONS_RECOVER_FRAGMENTED] = recover_fragmented_utility
+    [OPTIONS_RECOVER_FRAGMENTED] = recover_fragmented_utility,
+    [OPTIONS_MANIFEST] = manifest_utility,
+    [OPTIONS_APPLY] = apply_utility
 };
 
 static void main_print_usage(char* app)
@@ -31,10 +85,119 @@ static void main_print_usage(char* app)
         "  -i                     Print the file system information.\n"
         "  -l                     List the root directory.\n"
         "  -r filename [-s sha1]  Recover a contiguous file.\n"
-        "  -R filename -s sha1    Recover a possibly non-contiguous file.\n",
+        "  -R filename -s sha1    Recover a possibly non-contiguous file.\n"
+        "  -R filename --top k    Without sha1, write k guesses to outfile.N.\n"
+        "  -m manifest            Recover the files listed in a manifest.\n"
+        "  -o outfile             Write the recovered file to outfile instead.\n"
+        "  -p patch               Leave disk unchanged; write changes to patch.\n"
+        "  -a patch               Apply a patch written by -p.\n"
+        "  -j threads             Index and search on multiple threads.\n"
+        "  --max-candidates n     Consider at most n candidate clusters.\n"
+        "  --max-clusters n       Search only for files of at most n clusters.\n"
+        "  --strategy name        Search by 'permutation', 'run' or 'auto'.\n"
+        "  --max-runs n           Split files into at most n runs.\n"
+        "  --node-limit n         Stop the search after n nodes/permutations.\n"
+        "  --time-limit seconds   Stop the search after some seconds.\n"
+        "  --progress             Print the search progress to stderr.\n"
+        "  --explain              Print the search plan instead of searching.\n"
+        "  --checkpoint file      Save the search progress to file.\n"
+        "  --resume               Resume the search saved by --checkpoint.\n"
+        "  --stats json           Print performance counters to stderr.\n"
+        "  --stats-file file      Write performance counters to file.\n"
+        "  --trace file           Write a timeline to file (Chrome format).\n",
         app);
 }
 
+static bool main_parse_uint32(uint32_t* result, const char* value)
+{
+    char* end;
+    unsigned long parsed = strtoul(value, &end, 10);
+
+    if (*value < '0' || *value > '9' || *end != '\0' || parsed > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *result = parsed;
+
+    return true;
+}
+
+static bool main_parse_uint64(uint64_t* result, const char* value)
+{
+    char* end;
+
+    errno = 0;
+
+    unsigned long long parsed = strtoull(value, &end, 10);
+
+    if (*value < '0' || *value > '9' || *end != '\0' || errno == ERANGE)
+    {
+        return false;
+    }
+
+    *result = parsed;
+
+    return true;
+}
+
+static bool main_parse_seconds(double* result, const char* value)
+{
+    char* end;
+    double parsed = strtod(value, &end);
+
+    if (*value < '0' || *value > '9' || *end != '\0' || !(parsed > 0) ||
+        parsed > 1e9)
+    {
+        return false;
+    }
+
+    *result = parsed;
+
+    return true;
+}
+
+static bool main_parse_strategy(SearchStrategy* result, const char* value)
+{
+    size_t count = sizeof MAIN_STRATEGIES / sizeof * MAIN_STRATEGIES;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(value, MAIN_STRATEGIES[i]) == 0)
+        {
+            *result = i;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool main_write_stats(Stats* stats, const char* path)
+{
+    if (!path)
+    {
+        return stats_write_json(stats, stderr);
+    }
+
+    FILE* output = fopen(path, "w");
+
+    if (!output)
+    {
+        return false;
+    }
+
+    bool result = stats_write_json(stats, output);
+
+    if (fclose(output) == EOF)
+    {
+        result = false;
+    }
+
+    return result;
+}
+
 int main(int count, char* args[])
 {
     int result = EXIT_FAILURE;
@@ -64,12 +227,27 @@ int main(int count, char* args[])
 
     int option;
     char* recover = NULL;
+    char* patch = NULL;
     char* sha1String = NULL;
+    char* statsPath = NULL;
+    char* tracePath = NULL;
+    bool progress = false;
     int length = 0;
     unsigned char digest[SHA_DIGEST_LENGTH];
     Options options = OPTIONS_NONE;
-
-    while ((option = getopt(count - 1, args + 1, ":ilr:R:s:")) != -1)
+    Settings settings =
+    {
+        .strategy = SEARCH_STRATEGY_AUTO,
+        .threads = 1,
+        .maxRuns = 4
+    };
+
+    while ((option = getopt_long(
+        count - 1,
+        args + 1,
+        ":ilr:R:m:s:j:o:p:a:",
+        MAIN_OPTIONS,
+        NULL)) != -1)
     {
         switch (option)
         {
@@ -105,6 +283,18 @@ int main(int count, char* args[])
             }
             break;
 
+        case 'm':
+            options |= OPTIONS_MANIFEST;
+            recover = optarg;
+
+            if (*recover == '-')
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
         case 's':
             options |= OPTIONS_SHA1;
             sha1String = optarg;
@@ -123,6 +313,178 @@ int main(int count, char* args[])
             }
             break;
 
+        case 'o':
+            options |= OPTIONS_OUTPUT;
+            settings.output = optarg;
+
+            if (*optarg == '-')
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case 'p':
+            options |= OPTIONS_PATCH;
+            patch = optarg;
+
+            if (*patch == '-')
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case 'a':
+            options |= OPTIONS_APPLY;
+            recover = optarg;
+
+            if (*recover == '-')
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case 'j':
+            options |= OPTIONS_THREADS;
+
+            if (!main_parse_uint32(&settings.threads, optarg) ||
+                !settings.threads)
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_MAX_CANDIDATES:
+            options |= OPTIONS_SEARCH;
+
+            if (!main_parse_uint32(&settings.maxCandidates, optarg))
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_MAX_CLUSTERS:
+            options |= OPTIONS_SEARCH;
+
+            if (!main_parse_uint32(&settings.maxClusters, optarg))
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_STRATEGY:
+            options |= OPTIONS_SEARCH;
+
+            if (!main_parse_strategy(&settings.strategy, optarg))
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_MAX_RUNS:
+            options |= OPTIONS_SEARCH;
+
+            if (!main_parse_uint32(&settings.maxRuns, optarg))
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_STATS:
+            options |= OPTIONS_STATS;
+
+            if (strcmp(optarg, "json") != 0)
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_STATS_FILE:
+            options |= OPTIONS_STATS;
+            statsPath = optarg;
+            break;
+
+        case MAIN_OPTION_TRACE:
+            tracePath = optarg;
+            break;
+
+        case MAIN_OPTION_TOP:
+            options |= OPTIONS_TOP;
+
+            if (!main_parse_uint32(&settings.top, optarg) || !settings.top)
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_NODE_LIMIT:
+            options |= OPTIONS_SEARCH;
+
+            if (!main_parse_uint64(&settings.nodeLimit, optarg) ||
+                !settings.nodeLimit)
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_TIME_LIMIT:
+            options |= OPTIONS_SEARCH;
+
+            if (!main_parse_seconds(&settings.timeLimit, optarg))
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_EXPLAIN:
+            options |= OPTIONS_EXPLAIN;
+            settings.explain = true;
+            break;
+
+        case MAIN_OPTION_CHECKPOINT:
+            options |= OPTIONS_CHECKPOINT;
+            settings.checkpoint = optarg;
+
+            if (*optarg == '-')
+            {
+                main_print_usage(app);
+
+                goto main_exit;
+            }
+            break;
+
+        case MAIN_OPTION_RESUME:
+            settings.resume = true;
+            break;
+
+        case MAIN_OPTION_PROGRESS:
+            options |= OPTIONS_SEARCH;
+            progress = true;
+            break;
+
         default:
             main_print_usage(app);
 
@@ -130,26 +492,111 @@ int main(int count, char* args[])
         }
     }
 
+    // The counters are not themselves an operation, so they are set aside
+    // before the options are validated.
+
+    Stats runStats;
+
+    if (options & OPTIONS_STATS)
+    {
+        options &= ~OPTIONS_STATS;
+        settings.stats = &runStats;
+
+        stats(&runStats);
+    }
+
     if (options == OPTIONS_NONE ||
         (options & OPTIONS_RECOVER) == OPTIONS_RECOVER ||
         (options & OPTIONS_INFORMATION && options != OPTIONS_INFORMATION) ||
         (options & OPTIONS_LIST && options != OPTIONS_LIST) ||
+        (options & OPTIONS_MANIFEST && options & ~(OPTIONS_MANIFEST |
+            OPTIONS_SEARCH | OPTIONS_THREADS | OPTIONS_PATCH)) ||
+        (options & OPTIONS_APPLY && options != OPTIONS_APPLY) ||
         (options & OPTIONS_SHA1 && !(options & OPTIONS_RECOVER)) ||
-        (options & OPTIONS_RECOVER_FRAGMENTED && !(options & OPTIONS_SHA1)))
+        (options & OPTIONS_RECOVER_FRAGMENTED &&
+            !(options & (OPTIONS_SHA1 | OPTIONS_TOP))) ||
+        (options & OPTIONS_TOP &&
+            (options & (OPTIONS_SHA1 | OPTIONS_PATCH) ||
+                !(options & OPTIONS_RECOVER_FRAGMENTED) ||
+                !(options & (OPTIONS_OUTPUT | OPTIONS_EXPLAIN)))) ||
+        (options & OPTIONS_EXPLAIN &&
+            (options & (OPTIONS_OUTPUT | OPTIONS_PATCH) ||
+                !(options & OPTIONS_RECOVER_FRAGMENTED))) ||
+        (options & OPTIONS_CHECKPOINT &&
+            (options & OPTIONS_EXPLAIN ||
+                !(options & OPTIONS_RECOVER_FRAGMENTED) ||
+                !(options & OPTIONS_SHA1))) ||
+        (settings.resume && !(options & OPTIONS_CHECKPOINT)) ||
+        (options & OPTIONS_SEARCH &&
+            !(options & (OPTIONS_RECOVER_FRAGMENTED | OPTIONS_MANIFEST))) ||
+        (options & OPTIONS_THREADS &&
+            !(options & (OPTIONS_RECOVER | OPTIONS_MANIFEST))) ||
+        (options & OPTIONS_OUTPUT && !(options & OPTIONS_RECOVER)) ||
+        (options & OPTIONS_PATCH &&
+            (options & OPTIONS_OUTPUT ||
+                !(options & (OPTIONS_RECOVER | OPTIONS_MANIFEST)))))
     {
         main_print_usage(app);
 
         goto main_exit;
     }
 
+    // The budget is shared by every search of the run, so that a manifest
+    // stops as a whole.
+
+    SearchProgress runProgress;
+
+    if (progress || settings.nodeLimit || settings.timeLimit)
+    {
+        search_progress(
+            &runProgress,
+            progress ? stderr : NULL,
+            settings.nodeLimit,
+            settings.timeLimit);
+
+        settings.progress = &runProgress;
+    }
+
+    // Only recovery in place and patching write to the disk image; everything
+    // else works on read-only media.
+
+    VolumeMode mode = VOLUME_MODE_READ_ONLY;
+
+    if (options & OPTIONS_PATCH)
+    {
+        mode = VOLUME_MODE_PRIVATE;
+    }
+    else if (options & (OPTIONS_RECOVER | OPTIONS_MANIFEST | OPTIONS_APPLY) &&
+        !(options & (OPTIONS_OUTPUT | OPTIONS_EXPLAIN)))
+    {
+        mode = VOLUME_MODE_READ_WRITE;
+    }
+
+    Trace runTrace;
+
+    if (tracePath)
+    {
+        if (!trace(&runTrace))
+        {
+            perror(app);
+
+            goto main_exit;
+        }
+
+        settings.trace = &runTrace;
+    }
+
     Volume disk;
+    double start = trace_now(settings.trace);
 
-    if (!volume(&disk, path))
+    if (!volume(&disk, path, mode))
     {
         perror(app);
 
-        goto main_exit;
+        goto main_exit_trace;
     }
+
+    trace_span(settings.trace, "volume", start);
     
     unsigned char* sha1;
 
@@ -162,18 +609,64 @@ int main(int count, char* args[])
         sha1 = NULL;
     }
 
-    for (Options mask = 0x8; mask; mask >>= 1)
+    for (Options mask = OPTIONS_APPLY; mask; mask >>= 1)
     {
-        if (options & mask)
+        if (options & mask && UTILITIES_BY_OPTIONS[mask])
         {
-            UTILITIES_BY_OPTIONS[mask](stdout, &disk, recover, sha1);
+            start = trace_now(settings.trace);
+
+            UTILITIES_BY_OPTIONS[mask](stdout, &disk, recover, sha1, &settings);
+            trace_span(settings.trace, "utility", start);
         }
     }
 
     result = EXIT_SUCCESS;
 
+    // Every change made by the utilities is committed as one transaction, so
+    // that a manifest is journaled and flushed once.
+
+    start = trace_now(settings.trace);
+
+    stats_begin(settings.stats, STATS_PHASE_WRITE);
+
+    if (!volume_transaction_commit(&disk))
+    {
+        perror(app);
+
+        result = EXIT_FAILURE;
+    }
+
+    if (options & OPTIONS_PATCH && !volume_patch_export(&disk, patch))
+    {
+        perror(patch);
+
+        result = EXIT_FAILURE;
+    }
+
+    stats_end(settings.stats, STATS_PHASE_WRITE);
+    trace_span(settings.trace, "commit", start);
     finalize_volume(&disk);
 
+    if (settings.stats && !main_write_stats(settings.stats, statsPath))
+    {
+        perror(statsPath ? statsPath : app);
+
+        result = EXIT_FAILURE;
+    }
+
+    if (settings.trace && !trace_write(settings.trace, tracePath))
+    {
+        perror(tracePath);
+
+        result = EXIT_FAILURE;
+    }
+
+main_exit_trace:
+    if (settings.trace)
+    {
+        finalize_trace(settings.trace);
+    }
+
 main_exit:
     return result;
 }
@@ -0,0 +1,172 @@
+// manifest_utility.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man3/getline.3.html
+//  - https://www.man7.org/linux/man-pages/man3/strtok_r.3p.html
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utility.h"
+
+#define MANIFEST_UTILITY_DELIMITERS " \t\r\n"
+
+/** Specifies how a manifest line recovers its file. */
+enum ManifestMode
+{
+    /** Recover a contiguous file. */
+    MANIFEST_MODE_CONTIGUOUS = 0,
+
+    /** Recover a possibly non-contiguous file. */
+    MANIFEST_MODE_FRAGMENTED
+};
+
+/** Specifies how a manifest line recovers its file. */
+typedef enum ManifestMode ManifestMode;
+
+static bool manifest_utility_parse_sha1(
+    unsigned char result[SHA_DIGEST_LENGTH],
+    const char* value)
+{
+    if (strlen(value) != 2 * SHA_DIGEST_LENGTH)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < SHA_DIGEST_LENGTH; i++)
+    {
+        char digits[3] = { value[i * 2], value[i * 2 + 1], '\0' };
+        char* end;
+
+        result[i] = strtoul(digits, &end, 16);
+
+        if (*digits == '-' || *digits == '+' || *end != '\0')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool manifest_utility_parse(
+    char* line,
+    char** name,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    bool* hasSha1,
+    ManifestMode* mode)
+{
+    char* state;
+    char* token = strtok_r(line, MANIFEST_UTILITY_DELIMITERS, &state);
+    bool hasMode = false;
+
+    *name = token;
+    *hasSha1 = false;
+    *mode = MANIFEST_MODE_CONTIGUOUS;
+
+    while ((token = strtok_r(NULL, MANIFEST_UTILITY_DELIMITERS, &state)))
+    {
+        if (!hasMode && strcmp(token, "contiguous") == 0)
+        {
+            hasMode = true;
+            *mode = MANIFEST_MODE_CONTIGUOUS;
+        }
+        else if (!hasMode && strcmp(token, "fragmented") == 0)
+        {
+            hasMode = true;
+            *mode = MANIFEST_MODE_FRAGMENTED;
+        }
+        else if (!*hasSha1 &&
+            manifest_utility_parse_sha1(sha1, token))
+        {
+            *hasSha1 = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return *mode == MANIFEST_MODE_CONTIGUOUS || *hasSha1;
+}
+
+void manifest_utility(
+    FILE* output,
+    Volume* volume,
+    const char* recover,
+    UTILITY_UNUSED unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
+{
+    FILE* manifest = fopen(recover, "r");
+
+    if (!manifest)
+    {
+        fprintf(output, "%s: %s\n", recover, strerror(errno));
+
+        return;
+    }
+
+    VolumeIndex index;
+
+    if (!recover_index(&index, volume, settings))
+    {
+        fprintf(output, "%s: %s\n", recover, strerror(errno));
+
+        goto manifest_utility_exit;
+    }
+
+    char* line = NULL;
+    size_t capacity = 0;
+    uint32_t lineNumber = 0;
+
+    while (getline(&line, &capacity, manifest) != -1)
+    {
+        lineNumber++;
+
+        size_t skip = strspn(line, MANIFEST_UTILITY_DELIMITERS);
+
+        if (line[skip] == '\0' || line[skip] == '#')
+        {
+            continue;
+        }
+
+        char* name;
+        unsigned char digest[SHA_DIGEST_LENGTH];
+        bool hasSha1;
+        ManifestMode mode;
+
+        if (!manifest_utility_parse(line, &name, digest, &hasSha1, &mode))
+        {
+            fprintf(output, "%s:%u: invalid entry\n", recover, lineNumber);
+
+            continue;
+        }
+
+        VolumeFindResult find;
+
+        switch (mode)
+        {
+        case MANIFEST_MODE_FRAGMENTED:
+            find = recover_fragmented_file(&index, name, digest, settings);
+            break;
+
+        default:
+            find = recover_contiguous_file(
+                &index,
+                name,
+                hasSha1 ? digest : NULL,
+                settings);
+            break;
+        }
+
+        fprintf(output, "%s: %s\n", name, volume_find_result_to_string(find));
+    }
+
+    free(line);
+    finalize_volume_index(&index);
+
+manifest_utility_exit:
+    fclose(manifest);
+}
@@ -28,7 +28,37 @@ enum Options
         OPTIONS_RECOVER_CONTIGUOUS | OPTIONS_RECOVER_FRAGMENTED,
 
     /** The SHA1 digest. */
-    OPTIONS_SHA1 = 0x10
+    OPTIONS_SHA1 = 0x10,
+
+    /** Tune the fragmented search. */
+    OPTIONS_SEARCH = 0x20,
+
+    /** Recover the files listed in a manifest. */
+    OPTIONS_MANIFEST = 0x40,
+
+    /** Use multiple threads. */
+    OPTIONS_THREADS = 0x80,
+
+    /** Write the recovered file to an output file. */
+    OPTIONS_OUTPUT = 0x100,
+
+    /** Apply a patch file. */
+    OPTIONS_APPLY = 0x200,
+
+    /** Leave the disk image unchanged and export the changes as a patch. */
+    OPTIONS_PATCH = 0x400,
+
+    /** Report performance counters. */
+    OPTIONS_STATS = 0x800,
+
+    /** Rank the reconstructions of a file whose digest is unknown. */
+    OPTIONS_TOP = 0x1000,
+
+    /** Print the search plan instead of searching. */
+    OPTIONS_EXPLAIN = 0x2000,
+
+    /** Save the progress of the fragmented search to a checkpoint file. */
+    OPTIONS_CHECKPOINT = 0x4000
 };
 
 /**
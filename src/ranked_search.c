@@ -0,0 +1,982 @@
+// ranked_search.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+//  - https://en.wikipedia.org/wiki/Branch_and_bound
+//  - https://en.wikipedia.org/wiki/Binary_heap
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ranked_search.h"
+#include "volume_free_map.h"
+
+/** Specifies the number of nodes visited between two reads of the clock. */
+#define RANKED_SEARCH_CLOCK_INTERVAL 4096
+
+/** Specifies the budget of a pass that visits every rank within the beam. */
+#define RANKED_SEARCH_UNBOUNDED UINT32_MAX
+
+/** Specifies the number accepted at a depth whose other candidates are cut. */
+#define RANKED_SEARCH_CUT UINT32_MAX
+
+/** Represents a candidate cluster sorted by profile to find duplicates. */
+struct RankedSearchKey
+{
+    /** Specifies the profile of the candidate. */
+    RankedSearchProfile profile;
+
+    /** Specifies the index of the candidate. */
+    uint32_t index;
+};
+
+/** Represents a candidate cluster sorted by profile to find duplicates. */
+typedef struct RankedSearchKey RankedSearchKey;
+
+static double ranked_search_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void ranked_search_histogram(
+    uint16_t result[RANKED_SEARCH_BINS],
+    const uint8_t* data,
+    uint32_t size)
+{
+    memset(result, 0, RANKED_SEARCH_BINS * sizeof * result);
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        result[data[i] >> 4]++;
+    }
+}
+
+static void ranked_search_profile(
+    RankedSearch* search,
+    RankedSearchProfile* profile,
+    uint32_t cluster)
+{
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint32_t remainder = search->fileSize;
+    uint32_t edge = search->edge;
+    uint8_t* data = volume_root_data(search->iterator, cluster);
+
+    remainder -= bytesPerCluster * (search->clusters - 1);
+
+    ranked_search_histogram(profile->head, data, edge);
+    ranked_search_histogram(
+        profile->tail,
+        data + bytesPerCluster - edge,
+        edge);
+
+    // Read as the last cluster, only the bytes before the slack belong to the
+    // file, so a short head is scaled to compare with a full tail.
+
+    uint32_t length = remainder;
+
+    if (length > edge)
+    {
+        length = edge;
+    }
+
+    ranked_search_histogram(profile->lastHead, data, length);
+
+    for (uint32_t bin = 0; bin < RANKED_SEARCH_BINS; bin++)
+    {
+        uint32_t scaled = profile->lastHead[bin] * edge;
+
+        profile->lastHead[bin] = (scaled + length / 2) / length;
+    }
+
+    profile->lastCost = 0;
+
+    for (uint32_t i = remainder; i < bytesPerCluster; i++)
+    {
+        if (data[i])
+        {
+            profile->lastCost = edge / RANKED_SEARCH_SLACK_DIVISOR;
+
+            break;
+        }
+    }
+}
+
+static uint32_t ranked_search_cost(
+    const uint16_t tail[RANKED_SEARCH_BINS],
+    const uint16_t head[RANKED_SEARCH_BINS])
+{
+    uint32_t result = 0;
+
+    for (uint32_t bin = 0; bin < RANKED_SEARCH_BINS; bin++)
+    {
+        result += tail[bin] > head[bin] ?
+            tail[bin] - head[bin] :
+            head[bin] - tail[bin];
+    }
+
+    return result;
+}
+
+static uint64_t ranked_search_bound(const RankedSearch* search)
+{
+    if (search->resultCount < search->capacity)
+    {
+        return UINT64_MAX;
+    }
+
+    return search->results->cost;
+}
+
+static int ranked_search_compare_keys(const void* left, const void* right)
+{
+    const RankedSearchKey* a = left;
+    const RankedSearchKey* b = right;
+    int result = memcmp(&a->profile, &b->profile, sizeof a->profile);
+
+    if (result)
+    {
+        return result;
+    }
+
+    return (a->index > b->index) - (a->index < b->index);
+}
+
+static bool ranked_search_unique(RankedSearch* search)
+{
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    RankedSearchKey* keys = malloc(search->count * sizeof * keys);
+    bool* duplicates = calloc(search->count, sizeof * duplicates);
+
+    if ((!keys || !duplicates) && search->count)
+    {
+        free(keys);
+        free(duplicates);
+
+        return false;
+    }
+
+    // Clusters with the same content, such as clusters of zeros, make the
+    // same reconstructions, so only the first on disk is kept. Only clusters
+    // with the same profile are compared in full.
+
+    for (uint32_t i = 0; i < search->count; i++)
+    {
+        keys[i].profile = search->profiles[i];
+        keys[i].index = i;
+    }
+
+    qsort(keys, search->count, sizeof * keys, ranked_search_compare_keys);
+
+    for (uint32_t i = 0, first = 0; i < search->count; i++)
+    {
+        size_t size = sizeof keys->profile;
+
+        if (memcmp(&keys[i].profile, &keys[first].profile, size))
+        {
+            first = i;
+
+            continue;
+        }
+
+        uint32_t j = first;
+
+        for (; j < i; j++)
+        {
+            if (duplicates[keys[j].index])
+            {
+                continue;
+            }
+
+            uint32_t left = search->candidates[keys[j].index];
+            uint32_t right = search->candidates[keys[i].index];
+
+            if (memcmp(
+                volume_root_data(search->iterator, left),
+                volume_root_data(search->iterator, right),
+                bytesPerCluster) == 0)
+            {
+                duplicates[keys[i].index] = true;
+
+                break;
+            }
+        }
+    }
+
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < search->count; i++)
+    {
+        if (!duplicates[i])
+        {
+            search->candidates[count] = search->candidates[i];
+            search->profiles[count] = search->profiles[i];
+            count++;
+        }
+    }
+
+    search->count = count;
+
+    free(keys);
+    free(duplicates);
+
+    return true;
+}
+
+static bool ranked_search_candidates(
+    RankedSearch* search,
+    const VolumeIndex* index,
+    const Settings* settings)
+{
+    Volume* volume = search->iterator->instance;
+    VolumeFreeMap freeMap;
+
+    if (!volume_free_map(&freeMap, volume))
+    {
+        return false;
+    }
+
+    volume_free_map_reserve_index(&freeMap, index);
+
+    uint32_t n = freeMap.count;
+
+    if (settings->maxCandidates && n > settings->maxCandidates)
+    {
+        n = settings->maxCandidates;
+    }
+
+    search->candidates = malloc(n * sizeof * search->candidates);
+    search->profiles = malloc(n * sizeof * search->profiles);
+
+    if (!search->candidates || !search->profiles)
+    {
+        finalize_volume_free_map(&freeMap);
+
+        return false;
+    }
+
+    uint32_t cluster = 0;
+    VolumeFreeRun run;
+
+    search->count = 0;
+
+    while (search->count < n &&
+        volume_free_map_next_run(&freeMap, &cluster, &run))
+    {
+        for (uint32_t i = 0; i < run.length && search->count < n; i++)
+        {
+            search->candidates[search->count] = run.first + i;
+            search->count++;
+        }
+    }
+
+    finalize_volume_free_map(&freeMap);
+
+    for (uint32_t i = 0; i < search->count; i++)
+    {
+        ranked_search_profile(
+            search,
+            search->profiles + i,
+            search->candidates[i]);
+    }
+
+    return ranked_search_unique(search);
+}
+
+static bool ranked_search_precedes(
+    uint32_t cost,
+    uint32_t index,
+    uint32_t otherCost,
+    uint32_t otherIndex)
+{
+    return cost < otherCost || (cost == otherCost && index < otherIndex);
+}
+
+static void ranked_search_sift(
+    uint32_t* children,
+    uint32_t* childCosts,
+    uint32_t i,
+    uint32_t count)
+{
+    for (;;)
+    {
+        uint32_t child = 2 * i + 1;
+
+        if (child >= count)
+        {
+            return;
+        }
+
+        if (child + 1 < count &&
+            ranked_search_precedes(
+                childCosts[child],
+                children[child],
+                childCosts[child + 1],
+                children[child + 1]))
+        {
+            child++;
+        }
+
+        if (!ranked_search_precedes(
+            childCosts[i],
+            children[i],
+            childCosts[child],
+            children[child]))
+        {
+            return;
+        }
+
+        uint32_t swap = children[i];
+
+        children[i] = children[child];
+        children[child] = swap;
+        swap = childCosts[i];
+        childCosts[i] = childCosts[child];
+        childCosts[child] = swap;
+        i = child;
+    }
+}
+
+static uint32_t ranked_search_batch(const RankedSearch* search, uint32_t depth)
+{
+    if (depth == search->clusters - 1)
+    {
+        return search->lastBatch;
+    }
+
+    return RANKED_SEARCH_BRANCHING;
+}
+
+static void ranked_search_expand(
+    RankedSearch* search,
+    uint32_t depth,
+    bool more)
+{
+    const RankedSearchProfile* previous = &search->first;
+    bool last = depth == search->clusters - 1;
+    uint32_t* children = search->children + depth * RANKED_SEARCH_BRANCHING;
+    uint32_t* childCosts = search->childCosts;
+    uint64_t prefixCost = search->costs[depth - 1];
+    uint64_t bound = ranked_search_bound(search);
+    uint32_t count = 0;
+    uint32_t lastCost = 0;
+    uint32_t lastIndex = 0;
+
+    childCosts += depth * RANKED_SEARCH_BRANCHING;
+
+    // Each batch holds the next candidates in order of cost, and then of
+    // position on disk, after the last candidate of the previous batch. At
+    // the last depth, where a format rejects most reconstructions, each batch
+    // is twice as large as the one before, so that a wide beam ranks every
+    // candidate in a few batches rather than rescanning them eight at a time.
+
+    if (more)
+    {
+        lastCost = childCosts[search->childCounts[depth] - 1];
+        lastIndex = children[search->childCounts[depth] - 1];
+
+        if (last && search->lastBatch < search->count)
+        {
+            search->lastBatch *= 2;
+        }
+    }
+    else
+    {
+        search->accepted[depth] = 0;
+
+        if (last)
+        {
+            search->lastBatch = RANKED_SEARCH_BRANCHING;
+        }
+    }
+
+    if (depth > 1)
+    {
+        previous = search->profiles + search->chosen[depth - 1];
+    }
+
+    // Only the candidates of least cost are kept, in a max-heap whose root is
+    // the worst kept candidate; ties keep the order of the candidates on disk.
+
+    uint32_t batch = ranked_search_batch(search, depth);
+
+    for (uint32_t i = 0; i < search->count; i++)
+    {
+        if (search->used[i])
+        {
+            continue;
+        }
+
+        const RankedSearchProfile* profile = search->profiles + i;
+        uint32_t cost;
+
+        if (last)
+        {
+            cost = ranked_search_cost(previous->tail, profile->lastHead) +
+                profile->lastCost;
+        }
+        else
+        {
+            cost = ranked_search_cost(previous->tail, profile->head);
+        }
+
+        if ((more && !ranked_search_precedes(lastCost, lastIndex, cost, i)) ||
+            prefixCost + cost >= bound)
+        {
+            continue;
+        }
+
+        if (count < batch)
+        {
+            uint32_t j = count;
+
+            count++;
+
+            for (; j && ranked_search_precedes(
+                childCosts[(j - 1) / 2],
+                children[(j - 1) / 2],
+                cost,
+                i); j = (j - 1) / 2)
+            {
+                children[j] = children[(j - 1) / 2];
+                childCosts[j] = childCosts[(j - 1) / 2];
+            }
+
+            children[j] = i;
+            childCosts[j] = cost;
+        }
+        else if (ranked_search_precedes(cost, i, *childCosts, *children))
+        {
+            *children = i;
+            *childCosts = cost;
+
+            ranked_search_sift(children, childCosts, 0, count);
+        }
+    }
+
+    // The heap is then sorted in place, best first.
+
+    for (uint32_t n = count; n > 1; n--)
+    {
+        uint32_t swap = *children;
+
+        *children = children[n - 1];
+        children[n - 1] = swap;
+        swap = *childCosts;
+        *childCosts = childCosts[n - 1];
+        childCosts[n - 1] = swap;
+
+        ranked_search_sift(children, childCosts, 0, n - 1);
+    }
+
+    search->childCounts[depth] = count;
+    search->indices[depth] = 0;
+}
+
+static void ranked_search_keep(RankedSearch* search, uint64_t cost)
+{
+    RankedSearchResult* results = search->results;
+    uint32_t count = search->resultCount;
+    uint32_t i;
+
+    // The results form a max-heap by cost, so that the worst result, which
+    // bounds the search, is at the root.
+
+    if (count < search->capacity)
+    {
+        i = count;
+        search->resultCount++;
+
+        for (; i && results[(i - 1) / 2].cost < cost; i = (i - 1) / 2)
+        {
+            RankedSearchResult swap = results[i];
+
+            results[i] = results[(i - 1) / 2];
+            results[(i - 1) / 2] = swap;
+        }
+    }
+    else
+    {
+        i = 0;
+
+        for (;;)
+        {
+            uint32_t child = 2 * i + 1;
+
+            if (child >= count)
+            {
+                break;
+            }
+
+            if (child + 1 < count &&
+                results[child + 1].cost > results[child].cost)
+            {
+                child++;
+            }
+
+            if (results[child].cost <= cost)
+            {
+                break;
+            }
+
+            RankedSearchResult swap = results[i];
+
+            results[i] = results[child];
+            results[child] = swap;
+            i = child;
+        }
+    }
+
+    results[i].cost = cost;
+
+    memcpy(
+        results[i].clusters,
+        search->prefix,
+        search->clusters * sizeof * search->prefix);
+}
+
+static bool ranked_search_expired(RankedSearch* search)
+{
+    if (search->nodes >= search->nodeLimit)
+    {
+        search->stopped = true;
+    }
+    else if (search->deadline &&
+        search->nodes % RANKED_SEARCH_CLOCK_INTERVAL == 0 &&
+        ranked_search_now() >= search->deadline)
+    {
+        search->stopped = true;
+    }
+
+    return search->stopped;
+}
+
+static bool ranked_search_accepts(
+    RankedSearch* search,
+    uint32_t depth,
+    const uint8_t* data)
+{
+    if (!search->format)
+    {
+        return true;
+    }
+
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    Validator* validator = search->validators + depth;
+
+    if (depth == search->clusters - 1)
+    {
+        uint32_t remainder = search->fileSize - bytesPerCluster * depth;
+
+        validator = &search->leafValidator;
+
+        validator_copy(validator, search->validators + depth - 1);
+
+        return validator_update(validator, data, remainder) &&
+            validator_final(validator);
+    }
+
+    validator_copy(validator, validator - 1);
+
+    return validator_update(validator, data, bytesPerCluster);
+}
+
+static void ranked_search_visit(RankedSearch* search, uint32_t budget)
+{
+    uint32_t last = search->clusters - 1;
+    uint32_t depth = 1;
+
+    // The search keeps an explicit stack, like the combinatorial search. The
+    // candidates at each depth are sorted by cost, so once one costs as much
+    // as the worst result, so do the rest. Likewise, once one exceeds the
+    // budget of discrepancies, so do the rest.
+
+    ranked_search_expand(search, depth, false);
+
+    for (;;)
+    {
+        // The beam holds `width` accepted candidates after each prefix; any
+        // candidate left past it is left to a later round. A full batch may
+        // be followed by more candidates, ranked while the beam has room.
+
+        uint32_t batch = ranked_search_batch(search, depth);
+        bool full = search->childCounts[depth] == batch;
+
+        if (search->accepted[depth] == search->width &&
+            (search->indices[depth] < search->childCounts[depth] || full))
+        {
+            search->narrowed = true;
+            search->indices[depth] = search->childCounts[depth];
+            search->accepted[depth] = RANKED_SEARCH_CUT;
+        }
+
+        if (search->indices[depth] == search->childCounts[depth] && full &&
+            search->accepted[depth] < search->width)
+        {
+            ranked_search_expand(search, depth, true);
+        }
+
+        if (search->indices[depth] == search->childCounts[depth])
+        {
+            if (depth == 1)
+            {
+                return;
+            }
+
+            depth--;
+            search->used[search->chosen[depth]] = false;
+            search->indices[depth]++;
+
+            continue;
+        }
+
+        if (ranked_search_expired(search))
+        {
+            return;
+        }
+
+        uint32_t slot = depth * RANKED_SEARCH_BRANCHING;
+
+        slot += search->indices[depth];
+
+        uint32_t candidate = search->children[slot];
+        uint64_t cost = search->costs[depth - 1] + search->childCosts[slot];
+
+        search->nodes++;
+
+        if (cost >= ranked_search_bound(search))
+        {
+            search->indices[depth] = search->childCounts[depth];
+            search->accepted[depth] = RANKED_SEARCH_CUT;
+
+            continue;
+        }
+
+        uint32_t cluster = search->candidates[candidate];
+        uint8_t* data = volume_root_data(search->iterator, cluster);
+
+        if (!ranked_search_accepts(search, depth, data))
+        {
+            search->indices[depth]++;
+
+            continue;
+        }
+
+        uint32_t rank = search->accepted[depth];
+        uint32_t discrepancies = search->discrepancies[depth - 1] + rank;
+        uint32_t widest = search->widest[depth - 1];
+
+        if (budget != RANKED_SEARCH_UNBOUNDED && discrepancies > budget)
+        {
+            search->truncated = true;
+            search->indices[depth] = search->childCounts[depth];
+            search->accepted[depth] = RANKED_SEARCH_CUT;
+
+            continue;
+        }
+
+        if (rank > widest)
+        {
+            widest = rank;
+        }
+
+        search->prefix[depth] = cluster;
+        search->accepted[depth]++;
+
+        if (depth == last)
+        {
+            search->indices[depth]++;
+
+            // A reconstruction with fewer discrepancies was kept by an
+            // earlier pass, and one within a narrower beam by an earlier
+            // round.
+
+            if ((budget == RANKED_SEARCH_UNBOUNDED ||
+                discrepancies == budget) &&
+                widest >= search->previousWidth)
+            {
+                search->counters.permutations++;
+
+                ranked_search_keep(search, cost);
+            }
+
+            continue;
+        }
+
+        search->used[candidate] = true;
+        search->chosen[depth] = candidate;
+        search->costs[depth] = cost;
+        search->discrepancies[depth] = discrepancies;
+        search->widest[depth] = widest;
+        depth++;
+
+        ranked_search_expand(search, depth, false);
+    }
+}
+
+static void ranked_search_passes(RankedSearch* search)
+{
+    uint32_t budget = 0;
+
+    // The passes of the first round form a limited discrepancy search: each
+    // pass visits only the reconstructions whose ranks among the candidates
+    // accepted at each depth sum to at most its budget. The greedy
+    // reconstruction is found first, and a search stopped at its limit has
+    // tried the alternatives closest to it rather than every alternative deep
+    // in one subtree.
+
+    search->width = RANKED_SEARCH_BRANCHING;
+    search->previousWidth = 0;
+    search->narrowed = false;
+
+    do
+    {
+        search->truncated = false;
+
+        ranked_search_visit(search, budget);
+
+        budget++;
+    }
+    while (search->truncated && !search->stopped);
+
+    // Each later round doubles the beam and visits it in one pass, keeping
+    // only the reconstructions outside the previous beam, until the budget is
+    // spent or the beam holds every candidate. A file whose format rejects
+    // every reconstruction within a narrow beam is still found.
+
+    while (search->narrowed && !search->stopped)
+    {
+        search->previousWidth = search->width;
+        search->width *= 2;
+        search->narrowed = false;
+
+        ranked_search_visit(search, RANKED_SEARCH_UNBOUNDED);
+    }
+}
+
+static int ranked_search_compare(const void* left, const void* right)
+{
+    const RankedSearchResult* a = left;
+    const RankedSearchResult* b = right;
+
+    return (a->cost > b->cost) - (a->cost < b->cost);
+}
+
+static bool ranked_search_allocate(RankedSearch* search)
+{
+    uint32_t k = search->clusters;
+    size_t branches = (size_t)k * RANKED_SEARCH_BRANCHING + search->count;
+
+    search->used = calloc(search->count, sizeof * search->used);
+    search->prefix = malloc(k * sizeof * search->prefix);
+    search->chosen = malloc(k * sizeof * search->chosen);
+    search->costs = malloc(k * sizeof * search->costs);
+    search->children = malloc(branches * sizeof * search->children);
+    search->childCosts = malloc(branches * sizeof * search->childCosts);
+    search->childCounts = malloc(k * sizeof * search->childCounts);
+    search->indices = malloc(k * sizeof * search->indices);
+    search->accepted = malloc(k * sizeof * search->accepted);
+    search->discrepancies = calloc(k, sizeof * search->discrepancies);
+    search->widest = calloc(k, sizeof * search->widest);
+    search->results = malloc(search->capacity * sizeof * search->results);
+    search->chains = malloc(
+        (size_t)search->capacity * k * sizeof * search->chains);
+
+    if (search->format)
+    {
+        search->validators = malloc(k * sizeof * search->validators);
+
+        if (!search->validators)
+        {
+            return false;
+        }
+    }
+
+    if ((!search->used && search->count) || !search->prefix ||
+        !search->chosen || !search->costs || !search->children ||
+        !search->childCosts || !search->childCounts || !search->indices ||
+        !search->accepted || !search->discrepancies || !search->widest ||
+        !search->results || !search->chains)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < search->capacity; i++)
+    {
+        search->results[i].clusters = search->chains + (size_t)i * k;
+    }
+
+    return true;
+}
+
+bool ranked_search(
+    RankedSearch* instance,
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    const Settings* settings)
+{
+    uint32_t hi = iterator->entry->firstClusterHi;
+    uint32_t lo = iterator->entry->firstClusterLo;
+    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+    uint8_t* data = volume_root_data(iterator, firstCluster);
+
+    memset(instance, 0, sizeof * instance);
+
+    instance->clusters = clusters;
+    instance->fileSize = iterator->entry->fileSize;
+    instance->capacity = settings->top;
+    instance->nodeLimit = settings->nodeLimit;
+    instance->edge = iterator->bytesPerCluster / 2;
+    instance->iterator = iterator;
+
+    if (instance->edge > RANKED_SEARCH_EDGE)
+    {
+        instance->edge = RANKED_SEARCH_EDGE;
+    }
+
+    if (!instance->nodeLimit)
+    {
+        instance->nodeLimit = UINT64_MAX;
+
+        if (!settings->timeLimit)
+        {
+            instance->nodeLimit = RANKED_SEARCH_NODE_LIMIT;
+        }
+    }
+
+    if (settings->timeLimit)
+    {
+        instance->deadline = ranked_search_now() + settings->timeLimit;
+    }
+
+    if (!instance->capacity)
+    {
+        errno = EINVAL;
+
+        return false;
+    }
+
+    double start = trace_now(settings->trace);
+
+    stats_begin(settings->stats, STATS_PHASE_CANDIDATES);
+
+    bool candidates = ranked_search_candidates(instance, index, settings);
+
+    if (candidates)
+    {
+        ranked_search_profile(instance, &instance->first, firstCluster);
+    }
+
+    stats_end(settings->stats, STATS_PHASE_CANDIDATES);
+    trace_span(settings->trace, "candidates", start);
+
+    if (!candidates)
+    {
+        goto ranked_search_exit;
+    }
+
+    // As in the combinatorial search, a format is validated only if the first
+    // cluster is itself accepted.
+
+    instance->format = validator_format(data, iterator->bytesPerCluster);
+
+    if (instance->format)
+    {
+        validator(&instance->leafValidator, instance->format);
+
+        if (!validator_update(
+            &instance->leafValidator,
+            data,
+            iterator->bytesPerCluster))
+        {
+            instance->format = NULL;
+        }
+    }
+
+    if (!ranked_search_allocate(instance))
+    {
+        goto ranked_search_exit;
+    }
+
+    start = trace_now(settings->trace);
+    *instance->prefix = firstCluster;
+    *instance->costs = 0;
+
+    if (instance->format)
+    {
+        validator_copy(instance->validators, &instance->leafValidator);
+    }
+
+    stats_begin(settings->stats, STATS_PHASE_SEARCH);
+
+    if (clusters == 1)
+    {
+        ranked_search_keep(instance, 0);
+    }
+    else if (instance->count >= clusters - 1)
+    {
+        ranked_search_passes(instance);
+    }
+
+    qsort(
+        instance->results,
+        instance->resultCount,
+        sizeof * instance->results,
+        ranked_search_compare);
+    stats_end(settings->stats, STATS_PHASE_SEARCH);
+    stats_add(settings->stats, STATS_PHASE_SEARCH, &instance->counters);
+    trace_span(settings->trace, "search", start);
+
+    return true;
+
+ranked_search_exit:
+    finalize_ranked_search(instance);
+
+    return false;
+}
+
+void finalize_ranked_search(RankedSearch* instance)
+{
+    free(instance->candidates);
+    free(instance->profiles);
+    free(instance->used);
+    free(instance->prefix);
+    free(instance->chosen);
+    free(instance->costs);
+    free(instance->children);
+    free(instance->childCosts);
+    free(instance->childCounts);
+    free(instance->indices);
+    free(instance->accepted);
+    free(instance->discrepancies);
+    free(instance->widest);
+    free(instance->validators);
+    free(instance->results);
+    free(instance->chains);
+
+    instance->candidates = NULL;
+    instance->profiles = NULL;
+    instance->used = NULL;
+    instance->prefix = NULL;
+    instance->chosen = NULL;
+    instance->costs = NULL;
+    instance->children = NULL;
+    instance->childCosts = NULL;
+    instance->childCounts = NULL;
+    instance->indices = NULL;
+    instance->accepted = NULL;
+    instance->discrepancies = NULL;
+    instance->widest = NULL;
+    instance->validators = NULL;
+    instance->results = NULL;
+    instance->chains = NULL;
+    instance->resultCount = 0;
+}
@@ -0,0 +1,252 @@
+// ranked_search.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef RANKED_SEARCH_H
+#define RANKED_SEARCH_H
+#include <openssl/sha.h>
+#include "settings.h"
+#include "validator.h"
+#include "volume_index.h"
+#include "volume_root_iterator.h"
+
+/** Specifies the number of bins in the byte histogram of a cluster edge. */
+#define RANKED_SEARCH_BINS 16
+
+/**
+ * Specifies the number of bytes at each edge of a cluster. Clusters smaller
+ * than two edges are split in half.
+ */
+#define RANKED_SEARCH_EDGE 4096
+
+/**
+ * Specifies the number of candidates ranked at a time after each prefix, and
+ * the number of clusters accepted after each prefix by the first round.
+ */
+#define RANKED_SEARCH_BRANCHING 8
+
+/**
+ * Specifies the cost of a last cluster whose slack is not zero, as a divisor of
+ * the size of an edge.
+ */
+#define RANKED_SEARCH_SLACK_DIVISOR 4
+
+/** Specifies the node limit of a search given neither a node nor time limit. */
+#define RANKED_SEARCH_NODE_LIMIT 10000000
+
+/**
+ * Represents the byte distributions at the edges of a candidate cluster. A
+ * boundary between two clusters of the same file seldom changes the kind of
+ * data, so the distribution at the end of one cluster predicts the
+ * distribution at the beginning of the next.
+ */
+struct RankedSearchProfile
+{
+    /** Specifies the histogram of the first bytes, by high nibble. */
+    uint16_t head[RANKED_SEARCH_BINS];
+
+    /**
+     * Specifies the histogram of the first bytes, by high nibble, read as the
+     * last cluster of the file and scaled to the size of an edge.
+     */
+    uint16_t lastHead[RANKED_SEARCH_BINS];
+
+    /** Specifies the histogram of the last bytes, by high nibble. */
+    uint16_t tail[RANKED_SEARCH_BINS];
+
+    /** Specifies the cost of reading the cluster as the last of the file. */
+    uint32_t lastCost;
+};
+
+/** Represents the byte distributions at the edges of a candidate cluster. */
+typedef struct RankedSearchProfile RankedSearchProfile;
+
+/** Represents a reconstruction of a file and its cost. */
+struct RankedSearchResult
+{
+    /** Specifies the sum of the costs of the boundaries between clusters. */
+    uint64_t cost;
+
+    /** Specifies the cluster chain. */
+    uint32_t* clusters;
+};
+
+/** Represents a reconstruction of a file and its cost. */
+typedef struct RankedSearchResult RankedSearchResult;
+
+/**
+ * Represents a branch-and-bound search for the reconstructions of a free file
+ * whose digest is unknown. Each reconstruction costs the sum of the
+ * differences in byte distribution across its cluster boundaries; a
+ * reconstruction that the format of the file rejects is never kept. The search
+ * keeps the best reconstructions found so far in a bounded max-heap and prunes
+ * every prefix that already costs as much as the worst of them. Its passes
+ * visit the reconstructions that depart least from the greedy one first,
+ * within a beam of accepted clusters after each prefix that widens until the
+ * budget is spent or nothing is left outside it.
+ */
+struct RankedSearch
+{
+    /** `true` if the search stopped at its node or time limit. */
+    bool stopped;
+
+    /** `true` if the current pass skipped a candidate over its budget. */
+    bool truncated;
+
+    /** `true` if the current round skipped a candidate outside its beam. */
+    bool narrowed;
+
+    /** Specifies the number of clusters accepted after each prefix. */
+    uint32_t width;
+
+    /**
+     * Specifies the width of the previous round, whose reconstructions are
+     * not kept again, or `0`.
+     */
+    uint32_t previousWidth;
+
+    /** Specifies the number of clusters in the file. */
+    uint32_t clusters;
+
+    /** Specifies the file size in bytes. */
+    uint32_t fileSize;
+
+    /** Specifies the number of candidate clusters. */
+    uint32_t count;
+
+    /** Specifies the number of bytes at each edge of a cluster. */
+    uint32_t edge;
+
+    /** Specifies the maximum number of results. */
+    uint32_t capacity;
+
+    /** Specifies the number of results. */
+    uint32_t resultCount;
+
+    /** Specifies the number of nodes visited. */
+    uint64_t nodes;
+
+    /** Specifies the maximum number of nodes to visit. */
+    uint64_t nodeLimit;
+
+    /** Specifies the time past which the search stops, or `0`. */
+    double deadline;
+
+    /** Specifies the candidate clusters. */
+    uint32_t* candidates;
+
+    /** Specifies the profile of each candidate. */
+    RankedSearchProfile* profiles;
+
+    /** Specifies the profile of the first cluster. */
+    RankedSearchProfile first;
+
+    /** `true` if the corresponding candidate is part of the current prefix. */
+    bool* used;
+
+    /** Specifies the cluster chain of the current prefix. */
+    uint32_t* prefix;
+
+    /** Specifies the candidate chosen at each depth. */
+    uint32_t* chosen;
+
+    /** Specifies the cost of each prefix. */
+    uint64_t* costs;
+
+    /**
+     * Specifies the batch of candidates tried at each depth, best first; the
+     * batch at the last depth may hold every candidate.
+     */
+    uint32_t* children;
+
+    /** Specifies the cost of the boundary before each candidate tried. */
+    uint32_t* childCosts;
+
+    /** Specifies the number of candidates in the batch at each depth. */
+    uint32_t* childCounts;
+
+    /** Specifies the size of the batch ranked at the last depth. */
+    uint32_t lastBatch;
+
+    /** Specifies the rank of the candidate tried at each depth. */
+    uint32_t* indices;
+
+    /** Specifies the number of candidates accepted at each depth. */
+    uint32_t* accepted;
+
+    /**
+     * Specifies the sum of the ranks among the accepted candidates of the
+     * clusters in each prefix.
+     */
+    uint32_t* discrepancies;
+
+    /**
+     * Specifies the greatest rank among the accepted candidates of the
+     * clusters in each prefix.
+     */
+    uint32_t* widest;
+
+    /** The format of the file, or `NULL` if the format is not validated. */
+    const ValidatorFormat* format;
+
+    /** Specifies the validator state after validating each prefix. */
+    Validator* validators;
+
+    /** Specifies the validator state used to finish each candidate. */
+    Validator leafValidator;
+
+    /**
+     * Specifies the results: a max-heap by cost while the search runs, then
+     * sorted from the least cost.
+     */
+    RankedSearchResult* results;
+
+    /** Specifies the cluster chains of the results. */
+    uint32_t* chains;
+
+    /** The work done by the search. */
+    StatsCounters counters;
+
+    /** The iterator used to locate cluster data. */
+    VolumeRootIterator* iterator;
+};
+
+/**
+ * Represents a branch-and-bound search for the reconstructions of a free file
+ * whose digest is unknown.
+ */
+typedef struct RankedSearch RankedSearch;
+
+/**
+ * Initializes an instance of the `RankedSearch` struct by searching for the
+ * `settings->top` reconstructions of least cost of a free file. The first
+ * cluster is taken from the directory entry; every other cluster is drawn
+ * from the clusters that are free in the file allocation table and not
+ * referenced as the first cluster of an indexed entry. The search stops
+ * after `settings->nodeLimit` nodes or `settings->timeLimit` seconds, or after
+ * `RANKED_SEARCH_NODE_LIMIT` nodes if neither is given.
+ *
+ * @param instance the `RankedSearch` instance.
+ * @param clusters the number of clusters in the file.
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param index    the index of the deleted files and directories, whose
+ *                 first clusters are never drawn.
+ * @param settings the search settings.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool ranked_search(
+    RankedSearch* instance,
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    const Settings* settings);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `RankedSearch` instance.
+ */
+void finalize_ranked_search(RankedSearch* instance);
+
+#endif
@@ -5,28 +5,59 @@
 // References
 //  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
 
+#include <errno.h>
 #include <string.h>
 #include "utility.h"
-#include "volume_root_iterator.h"
+#include "volume_extract.h"
+
+bool recover_index(
+    VolumeIndex* index,
+    Volume* volume,
+    const Settings* settings)
+{
+    stats_begin(settings->stats, STATS_PHASE_INDEX);
+
+    bool result = volume_index(
+        index,
+        volume,
+        settings->threads,
+        settings->trace);
+
+    stats_end(settings->stats, STATS_PHASE_INDEX);
+
+    if (result)
+    {
+        StatsCounters counters = { .entries = index->visited };
+
+        stats_add(settings->stats, STATS_PHASE_INDEX, &counters);
+    }
+
+    return result;
+}
+
+void recover_count(StatsCounters* counters, VolumeRootIterator* iterator)
+{
+    uint32_t fileSize = iterator->entry->fileSize;
+
+    counters->clusters += volume_clusters(fileSize, iterator->bytesPerCluster);
+    counters->bytes += fileSize;
+    counters->permutations++;
+}
 
 void recover_contiguous(
-    Fat32BootSector* bootSector, 
-    uint32_t firstCluster, 
+    Volume* volume,
+    uint32_t firstCluster,
     uint32_t clusters)
 {
+    VolumeGeometry* geometry = &volume->geometry;
     uint32_t lastCluster = firstCluster + clusters - 1;
 
-    for (uint32_t fat = 0; fat < bootSector->fats; fat++)
+    for (uint32_t fat = 0; fat < geometry->fatCount; fat++)
     {
         // From specification:
         //   BPB_ResvdSecCnt + (BPB_NumFATs * FATSz)
 
-        uint32_t fatSector = bootSector->reservedSectors;
-
-        fatSector += fat * bootSector->sectorsPerFat;
-
-        uint32_t fatStartByte = fatSector * bootSector->bytesPerSector;
-        uint32_t* fatData = (uint32_t*)((uint8_t*)bootSector + fatStartByte);
+        uint32_t* fatData = geometry->fat + (size_t)fat * geometry->fatEntries;
 
         for (uint32_t cluster = firstCluster; cluster < lastCluster; cluster++)
         {
@@ -34,41 +65,162 @@ void recover_contiguous(
         }
 
         fatData[lastCluster] = VOLUME_EOF;
+
+        volume_dirty(
+            volume,
+            fatData + firstCluster,
+            clusters * sizeof * fatData);
     }
 }
 
-void recover_contiguous_utility(
-    FILE* output,
-    Volume* volume,
+bool recover_contiguous_entry(
+    VolumeRootIterator* iterator,
     const char* recover,
-    unsigned char sha1[SHA_DIGEST_LENGTH])
+    const Settings* settings)
 {
-    VolumeRootIterator it;
+    uint32_t lo = iterator->entry->firstClusterLo;
+    uint32_t hi = iterator->entry->firstClusterHi;
+    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
 
-    volume_root_begin(&it, volume);
+    if (settings->output)
+    {
+        return volume_extract_contiguous(
+            iterator->instance,
+            settings->output,
+            firstCluster,
+            iterator->entry->fileSize);
+    }
 
-    VolumeFindResult find = volume_root_single_free(&it, recover, sha1);
-    const char* message = volume_find_result_to_string(find);
+    *iterator->entry->name = *recover;
 
-    fprintf(output, "%s: %s\n", recover, message);
+    volume_dirty(iterator->instance, iterator->entry->name, 1);
 
-    if (!volume_find_result_is_ok(find))
+    if (!iterator->entry->fileSize)
     {
-        return;
+        return true;
     }
 
-    *it.entry->name = *recover;
+    uint32_t clusters = volume_clusters(
+        iterator->entry->fileSize,
+        iterator->bytesPerCluster);
+
+    recover_contiguous(iterator->instance, firstCluster, clusters);
+
+    return true;
+}
+
+VolumeFindResult recover_contiguous_file(
+    VolumeIndex* index,
+    const char* path,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
+{
+    VolumeIndexEntry* match = NULL;
+    uint32_t matches = 0;
+    StatsCounters counters = { 0 };
+
+    stats_begin(settings->stats, STATS_PHASE_SEARCH);
+
+    // Entries recovered since the index was built are no longer free and are
+    // skipped.
 
-    if (!it.entry->fileSize)
+    for (VolumeIndexEntry* entry = volume_index_find(index, path);
+        entry;
+        entry = volume_index_next(index, entry))
     {
+        if (!fat32_directory_entry_is_end_free(entry->iterator.entry) &&
+            !fat32_directory_entry_is_mid_free(entry->iterator.entry))
+        {
+            continue;
+        }
+
+        if (sha1)
+        {
+            recover_count(&counters, &entry->iterator);
+
+            if (!volume_root_matches(&entry->iterator, sha1))
+            {
+                continue;
+            }
+        }
+
+        if (!match)
+        {
+            match = entry;
+        }
+
+        matches++;
+    }
+
+    stats_end(settings->stats, STATS_PHASE_SEARCH);
+    stats_add(settings->stats, STATS_PHASE_SEARCH, &counters);
+
+    if (!matches)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
+
+    if (matches > 1)
+    {
+        return VOLUME_FIND_RESULT_MULTIPLE_FOUND;
+    }
+
+    const char* fileName = volume_index_file_name(path);
+
+    stats_begin(settings->stats, STATS_PHASE_WRITE);
+
+    bool written = recover_contiguous_entry(
+        &match->iterator,
+        fileName,
+        settings);
+
+    stats_end(settings->stats, STATS_PHASE_WRITE);
+
+    if (!written)
+    {
+        return VOLUME_FIND_RESULT_WRITE_FAILED;
+    }
+
+    if (sha1)
+    {
+        return VOLUME_FIND_RESULT_SHA1_FOUND;
+    }
+
+    return VOLUME_FIND_RESULT_NAME_FOUND;
+}
+
+void recover_contiguous_utility(
+    FILE* output,
+    Volume* volume,
+    const char* recover,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
+{
+    VolumeIndex index;
+
+    if (!recover_index(&index, volume, settings))
+    {
+        fprintf(output, "%s: %s\n", recover, strerror(errno));
+
         return;
     }
 
-    Fat32BootSector* bootSector = volume->data;
-    uint32_t lo = it.entry->firstClusterLo;
-    uint32_t hi = it.entry->firstClusterHi;
-    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
-    uint32_t clusters = volume_clusters(it.entry->fileSize, it.bytesPerCluster);
+    VolumeFindResult find = recover_contiguous_file(
+        &index,
+        recover,
+        sha1,
+        settings);
+
+    if (find == VOLUME_FIND_RESULT_WRITE_FAILED)
+    {
+        fprintf(output, "%s: %s\n", settings->output, strerror(errno));
+    }
+    else
+    {
+        const char* message = volume_find_result_to_string(find);
+
+        fprintf(output, "%s: %s\n", recover, message);
+    }
 
-    recover_contiguous(bootSector, firstCluster, clusters);
+    finalize_volume_index(&index);
 }
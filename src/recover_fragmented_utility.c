@@ -4,328 +4,508 @@
 
 // References
 //  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
-//  - https://docs.openssl.org/1.0.2/man3/sha/
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
-#include "next_permutation.h"
+#include "combinatorial_search.h"
+#include "ranked_search.h"
+#include "run_search.h"
+#include "search_plan.h"
 #include "utility.h"
-#include "volume_root_iterator.h"
-#define COMBINATORIAL_SEARCH_N 20
+#include "volume_extract.h"
 
-static VolumeFindResult combinatorial_search(
-    uint32_t results[5],
-    uint32_t clusters,
+VolumeFindResult recover_fragmented_entry(
     VolumeRootIterator* iterator,
-    unsigned char sha1[SHA_DIGEST_LENGTH])
+    const VolumeIndex* index,
+    const char* recover,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
 {
-    Volume* volume = iterator->instance;
-    VolumeRootIterator it;
-    bool isFirstCluster[COMBINATORIAL_SEARCH_N] = { 0 };
+    VolumeGeometry* geometry = &iterator->instance->geometry;
+    uint32_t clusters = volume_clusters(
+        iterator->entry->fileSize,
+        iterator->bytesPerCluster);
+    uint32_t* results = malloc(clusters * sizeof * results);
+    VolumeFindResult result = VOLUME_FIND_RESULT_NOT_FOUND;
+    SearchStrategy strategy = settings->strategy;
+    bool fallback = false;
+
+    if (!results)
+    {
+        return result;
+    }
 
-    for (volume_root_begin(&it, volume); !it.end; volume_root_next(&it))
+    // A run whose budget is spent leaves the files after it unsearched.
+
+    if (!search_progress_file(settings->progress, recover))
     {
-        uint32_t lo = it.entry->firstClusterLo;
-        uint32_t hi = it.entry->firstClusterHi;
-        uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+        result = VOLUME_FIND_RESULT_STOPPED;
 
-        if (firstCluster - 2 < COMBINATORIAL_SEARCH_N)
-        {
-            isFirstCluster[firstCluster - 2] = true;
-        }
+        goto recover_fragmented_entry_exit;
     }
 
-    uint32_t candidates[COMBINATORIAL_SEARCH_N];
-    uint32_t n = 0;
-
-    for (uint32_t cluster = 2; cluster < COMBINATORIAL_SEARCH_N + 2; cluster++)
+    if (strategy == SEARCH_STRATEGY_AUTO)
     {
-        if (!isFirstCluster[cluster - 2])
+        SearchPlan plan;
+
+        strategy = SEARCH_STRATEGY_PERMUTATION;
+
+        if (search_plan(&plan, clusters, iterator, index, settings))
         {
-            candidates[n] = cluster;
-            n++;
+            strategy = plan.strategy;
+            fallback = plan.fallback;
         }
     }
 
-    uint32_t hi = iterator->entry->firstClusterHi;
-    uint32_t lo = iterator->entry->firstClusterLo;
-    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+    switch (strategy)
+    {
+    case SEARCH_STRATEGY_RUN:
+        result = run_search(
+            results,
+            clusters,
+            iterator,
+            index,
+            sha1,
+            settings);
+        break;
 
-    *results = firstCluster;
+    default:
+        result = combinatorial_search(
+            results,
+            clusters,
+            iterator,
+            index,
+            sha1,
+            settings);
+        break;
+    }
 
-    uint32_t* permutation = results + 1;
+    if (fallback && result == VOLUME_FIND_RESULT_NOT_FOUND)
+    {
+        result = combinatorial_search(
+            results,
+            clusters,
+            iterator,
+            index,
+            sha1,
+            settings);
+    }
+
+    if (!volume_find_result_is_ok(result))
+    {
+        goto recover_fragmented_entry_exit;
+    }
 
-    // TODO: Clean up this atrocity
+    stats_begin(settings->stats, STATS_PHASE_WRITE);
 
-    switch (clusters)
+    if (settings->output)
     {
-    case 2:
-        for (uint32_t d = 0; d < n; d++)
+        if (!volume_extract(
+            iterator->instance,
+            settings->output,
+            results,
+            clusters,
+            iterator->entry->fileSize))
         {
-            permutation[0] = candidates[d];
+            result = VOLUME_FIND_RESULT_WRITE_FAILED;
+        }
 
-            SHA_CTX context;
+        goto recover_fragmented_entry_exit_write;
+    }
 
-            SHA1_Init(&context);
+    *iterator->entry->name = *recover;
 
-            uint8_t* data;
+    volume_dirty(iterator->instance, iterator->entry->name, 1);
 
-            data = volume_root_data(&it, firstCluster);
+    for (uint32_t fat = 0; fat < geometry->fatCount; fat++)
+    {
+        // From specification:
+        //   BPB_ResvdSecCnt + (BPB_NumFATs * FATSz)
 
-            SHA1_Update(&context, data, iterator->bytesPerCluster);
+        uint32_t* fatData = geometry->fat + (size_t)fat * geometry->fatEntries;
 
-            data = volume_root_data(&it, permutation[0]);
+        for (uint32_t i = 0; i < clusters - 1; i++)
+        {
+            fatData[results[i]] = results[i + 1];
+        }
 
-            uint32_t remainder = iterator->entry->fileSize;
+        fatData[results[clusters - 1]] = VOLUME_EOF;
 
-            remainder -= iterator->bytesPerCluster;
+        for (uint32_t i = 0; i < clusters; i++)
+        {
+            volume_dirty(
+                iterator->instance,
+                fatData + results[i],
+                sizeof * fatData);
+        }
+    }
 
-            SHA1_Update(&context, data, remainder);
+recover_fragmented_entry_exit_write:
+    stats_end(settings->stats, STATS_PHASE_WRITE);
 
-            unsigned char digest[SHA_DIGEST_LENGTH];
+recover_fragmented_entry_exit:
+    free(results);
 
-            SHA1_Final(digest, &context);
+    return result;
+}
 
-            if (memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0)
-            {
-                return VOLUME_FIND_RESULT_SHA1_FOUND;
-            }
-        }
-        break;
+VolumeFindResult recover_fragmented_file(
+    VolumeIndex* index,
+    const char* path,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
+{
+    const char* fileName = volume_index_file_name(path);
+    VolumeIndexEntry* first = NULL;
+    VolumeIndexEntry* match = NULL;
+    StatsCounters counters = { 0 };
 
-    case 3:
-        for (uint32_t c = 0; c < n; c++)
+    stats_begin(settings->stats, STATS_PHASE_SEARCH);
+
+    // A file stored contiguously is recovered without a search.
+
+    for (VolumeIndexEntry* entry = volume_index_find(index, path);
+        entry && !match;
+        entry = volume_index_next(index, entry))
+    {
+        if (!fat32_directory_entry_is_end_free(entry->iterator.entry) &&
+            !fat32_directory_entry_is_mid_free(entry->iterator.entry))
         {
-            for (uint32_t d = c + 1; d < n; d++)
-            {
-                permutation[0] = candidates[c];
-                permutation[1] = candidates[d];
+            continue;
+        }
 
-                do
-                {
-                    SHA_CTX context;
+        recover_count(&counters, &entry->iterator);
 
-                    SHA1_Init(&context);
+        if (volume_root_matches(&entry->iterator, sha1))
+        {
+            match = entry;
+        }
+        else if (!first)
+        {
+            first = entry;
+        }
+    }
 
-                    uint8_t* data;
+    stats_end(settings->stats, STATS_PHASE_SEARCH);
+    stats_add(settings->stats, STATS_PHASE_SEARCH, &counters);
 
-                    data = volume_root_data(&it, firstCluster);
+    if (match)
+    {
+        stats_begin(settings->stats, STATS_PHASE_WRITE);
 
-                    SHA1_Update(&context, data, iterator->bytesPerCluster);
+        bool written = recover_contiguous_entry(
+            &match->iterator,
+            fileName,
+            settings);
 
-                    data = volume_root_data(&it, permutation[0]);
+        stats_end(settings->stats, STATS_PHASE_WRITE);
 
-                    SHA1_Update(&context, data, iterator->bytesPerCluster);
+        if (!written)
+        {
+            return VOLUME_FIND_RESULT_WRITE_FAILED;
+        }
 
-                    data = volume_root_data(&it, permutation[1]);
+        return VOLUME_FIND_RESULT_SHA1_FOUND;
+    }
 
-                    uint32_t remainder = iterator->entry->fileSize;
+    if (!first)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
 
-                    remainder -= iterator->bytesPerCluster * 2;
+    return recover_fragmented_entry(
+        &first->iterator,
+        index,
+        fileName,
+        sha1,
+        settings);
+}
 
-                    SHA1_Update(&context, data, remainder);
+static bool recover_ranked_digest(
+    char result[2 * SHA_DIGEST_LENGTH + 1],
+    Volume* volume,
+    const uint32_t clusters[],
+    uint32_t count,
+    uint32_t size)
+{
+    Hash context;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    uint32_t bytesPerCluster = volume->geometry.bytesPerCluster;
 
-                    unsigned char digest[SHA_DIGEST_LENGTH];
+    if (!hash(&context, hash_backend()))
+    {
+        return false;
+    }
 
-                    SHA1_Final(digest, &context);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t length = bytesPerCluster;
 
-                    if (memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0)
-                    {
-                        return VOLUME_FIND_RESULT_SHA1_FOUND;
-                    }
-                } while (next_permutation(permutation, 2));
-            }
-        }
-        break;
-    case 4:
-        for (uint32_t b = 0; b < n; b++)
+        if (length > size)
         {
-            for (uint32_t c = b + 1; c < n; c++)
-            {
-                for (uint32_t d = c + 1; d < n; d++)
-                {
-                    permutation[0] = candidates[b];
-                    permutation[1] = candidates[c];
-                    permutation[2] = candidates[d];
+            length = size;
+        }
 
-                    do
-                    {
-                        SHA_CTX context;
+        hash_update(&context, volume_cluster_data(volume, clusters[i]), length);
 
-                        SHA1_Init(&context);
+        size -= length;
+    }
 
-                        uint8_t* data;
+    hash_final(&context, digest);
+    finalize_hash(&context);
 
-                        data = volume_root_data(&it, firstCluster);
+    for (int i = 0; i < SHA_DIGEST_LENGTH; i++)
+    {
+        sprintf(result + 2 * i, "%02x", digest[i]);
+    }
 
-                        SHA1_Update(&context, data, iterator->bytesPerCluster);
+    return true;
+}
 
-                        for (uint32_t j = 0; j < clusters - 2; j++)
-                        {
-                            data = volume_root_data(&it, permutation[j]);
+static VolumeIndexEntry* recover_free_entry(
+    VolumeIndex* index,
+    const char* path)
+{
+    VolumeIndexEntry* entry = volume_index_find(index, path);
 
-                            SHA1_Update(&context, data, iterator->bytesPerCluster);
-                        }
+    for (; entry; entry = volume_index_next(index, entry))
+    {
+        if (fat32_directory_entry_is_end_free(entry->iterator.entry) ||
+            fat32_directory_entry_is_mid_free(entry->iterator.entry))
+        {
+            break;
+        }
+    }
 
-                        data = volume_root_data(&it, permutation[clusters - 2]);
+    return entry;
+}
 
-                        uint32_t remainder = iterator->entry->fileSize;
+VolumeFindResult recover_explain_file(
+    FILE* output,
+    VolumeIndex* index,
+    const char* path,
+    const Settings* settings)
+{
+    VolumeIndexEntry* entry = recover_free_entry(index, path);
 
-                        remainder -= iterator->bytesPerCluster * (clusters - 1);
+    if (!entry)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
 
-                        SHA1_Update(&context, data, remainder);
+    VolumeRootIterator* iterator = &entry->iterator;
+    uint32_t clusters = volume_clusters(
+        iterator->entry->fileSize,
+        iterator->bytesPerCluster);
+    SearchPlan plan;
 
-                        unsigned char digest[SHA_DIGEST_LENGTH];
+    if (!clusters || !search_plan(&plan, clusters, iterator, index, settings))
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
 
-                        SHA1_Final(digest, &context);
+    if (!search_plan_write(&plan, output, path))
+    {
+        return VOLUME_FIND_RESULT_WRITE_FAILED;
+    }
 
-                        if (memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0)
-                        {
-                            return VOLUME_FIND_RESULT_SHA1_FOUND;
-                        }
-                    } while (next_permutation(permutation, 3));
-                }
-            }
-        }
-        break;
-    case 5:
-        for (uint32_t a = 0; a < n; a++)
-        {
-            for (uint32_t b = a + 1; b < n; b++)
-            {
-                for (uint32_t c = b + 1; c < n; c++)
-                {
-                    for (uint32_t d = c + 1; d < n; d++)
-                    {
-                        permutation[0] = candidates[a];
-                        permutation[1] = candidates[b];
-                        permutation[2] = candidates[c];
-                        permutation[3] = candidates[d];
+    return VOLUME_FIND_RESULT_NAME_FOUND;
+}
+
+VolumeFindResult recover_ranked_file(
+    FILE* output,
+    VolumeIndex* index,
+    const char* path,
+    const Settings* settings)
+{
+    VolumeIndexEntry* entry = recover_free_entry(index, path);
+
+    if (!entry)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
 
-                        do
-                        {
-                            SHA_CTX context;
+    VolumeRootIterator* iterator = &entry->iterator;
+    uint32_t fileSize = iterator->entry->fileSize;
+    uint32_t clusters = volume_clusters(fileSize, iterator->bytesPerCluster);
+    RankedSearch search;
 
-                            SHA1_Init(&context);
+    if (!clusters ||
+        !ranked_search(&search, clusters, iterator, index, settings))
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
 
-                            uint8_t* data;
+    VolumeFindResult result = VOLUME_FIND_RESULT_NOT_FOUND;
+    char* name = malloc(strlen(settings->output) + 12);
 
-                            data = volume_root_data(&it, firstCluster);
+    if (!name)
+    {
+        goto recover_ranked_file_exit;
+    }
 
-                            SHA1_Update(&context, data, iterator->bytesPerCluster);
+    stats_begin(settings->stats, STATS_PHASE_WRITE);
 
-                            for (uint32_t j = 0; j < clusters - 2; j++)
-                            {
-                                data = volume_root_data(&it, permutation[j]);
+    // Each reconstruction is written to its own numbered output file, best
+    // first, with its digest so that it can be checked against other copies.
 
-                                SHA1_Update(&context, data, iterator->bytesPerCluster);
-                            }
+    for (uint32_t i = 0; i < search.resultCount; i++)
+    {
+        RankedSearchResult* reconstruction = search.results + i;
+        char digest[2 * SHA_DIGEST_LENGTH + 1];
+
+        sprintf(name, "%s.%u", settings->output, i + 1);
+
+        if (!volume_extract(
+            iterator->instance,
+            name,
+            reconstruction->clusters,
+            clusters,
+            fileSize) ||
+            !recover_ranked_digest(
+                digest,
+                iterator->instance,
+                reconstruction->clusters,
+                clusters,
+                fileSize))
+        {
+            fprintf(output, "%s: %s\n", name, strerror(errno));
 
-                            data = volume_root_data(&it, permutation[clusters - 2]);
+            result = VOLUME_FIND_RESULT_WRITE_FAILED;
 
-                            uint32_t remainder = iterator->entry->fileSize;
+            break;
+        }
 
-                            remainder -= iterator->bytesPerCluster * (clusters - 1);
+        fprintf(output,
+            "%s: wrote candidate %u to %s (cost %llu, SHA-1 %s)\n",
+            path,
+            i + 1,
+            name,
+            (unsigned long long)reconstruction->cost,
+            digest);
 
-                            SHA1_Update(&context, data, remainder);
+        result = VOLUME_FIND_RESULT_MULTIPLE_FOUND;
+    }
 
-                            unsigned char digest[SHA_DIGEST_LENGTH];
+    stats_end(settings->stats, STATS_PHASE_WRITE);
 
-                            SHA1_Final(digest, &context);
+    if (search.stopped)
+    {
+        fprintf(output,
+            "%s: search stopped at its limit after %llu nodes\n",
+            path,
+            (unsigned long long)search.nodes);
+    }
 
-                            if (memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0)
-                            {
-                                return VOLUME_FIND_RESULT_SHA1_FOUND;
-                            }
-                        } while (next_permutation(permutation, 4));
-                    }
-                }
-            }
-        }
-        break;
+    // The file was found, so a search that kept nothing is not reported as
+    // a missing file.
+
+    if (!search.resultCount)
+    {
+        result = VOLUME_FIND_RESULT_NO_RECONSTRUCTION;
+
+        fprintf(output, "%s: %s\n", path, volume_find_result_to_string(result));
     }
 
-    return VOLUME_FIND_RESULT_NOT_FOUND;
+    free(name);
+
+recover_ranked_file_exit:
+    finalize_ranked_search(&search);
+
+    return result;
 }
 
 void recover_fragmented_utility(
     FILE* output,
     Volume* volume,
     const char* recover,
-    unsigned char sha1[SHA_DIGEST_LENGTH])
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
 {
-    VolumeRootIterator it;
-    VolumeFindResult find;
+    VolumeIndex index;
 
-    volume_root_begin(&it, volume);
+    if (!recover_index(&index, volume, settings))
+    {
+        fprintf(output, "%s: %s\n", recover, strerror(errno));
 
-    find = volume_root_first_free(&it, recover, sha1);
+        return;
+    }
 
-    Fat32BootSector* bootSector = volume->data;
-    uint32_t clusters;
+    VolumeFindResult find;
 
-    if (volume_find_result_is_ok(find))
+    if (settings->explain)
     {
-        *it.entry->name = *recover;
+        find = recover_explain_file(output, &index, recover, settings);
 
-        if (!it.entry->fileSize)
-        {
-            goto recover_fragmented_utility_exit;
-        }
+        // The plan was printed in place of the result of a search, or the
+        // output stream cannot be written.
 
-        uint32_t lo = it.entry->firstClusterLo;
-        uint32_t hi = it.entry->firstClusterHi;
-        uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
-
-        clusters = volume_clusters(it.entry->fileSize, it.bytesPerCluster);
+        if (find != VOLUME_FIND_RESULT_NOT_FOUND)
+        {
+            finalize_volume_index(&index);
 
-        recover_contiguous(bootSector, firstCluster, clusters);
+            return;
+        }
     }
+    else if (!sha1)
+    {
+        find = recover_ranked_file(output, &index, recover, settings);
 
-    volume_root_begin(&it, volume);
+        // Each reconstruction, any failure to write it, and a search that
+        // kept none were reported by the search.
 
-    find = volume_root_first_free(&it, recover, NULL);
+        if (find != VOLUME_FIND_RESULT_NOT_FOUND)
+        {
+            finalize_volume_index(&index);
 
-    if (!volume_find_result_is_ok(find))
+            return;
+        }
+    }
+    else
     {
-        goto recover_fragmented_utility_exit;
+        find = recover_fragmented_file(&index, recover, sha1, settings);
     }
 
-    uint32_t results[5];
-
-    clusters = volume_clusters(it.entry->fileSize, it.bytesPerCluster);
-    find = combinatorial_search(results, clusters, &it, sha1);
-
-    if (!volume_find_result_is_ok(find))
+    if (find == VOLUME_FIND_RESULT_WRITE_FAILED)
     {
-        goto recover_fragmented_utility_exit;
+        fprintf(output, "%s: %s\n", settings->output, strerror(errno));
     }
-
-    *it.entry->name = *recover;
-
-    for (uint32_t fat = 0; fat < bootSector->fats; fat++)
+    else if (find == VOLUME_FIND_RESULT_STOPPED)
     {
-        // From specification:
-        //   BPB_ResvdSecCnt + (BPB_NumFATs * FATSz)
-
-        uint32_t fatSector = bootSector->reservedSectors;
-
-        fatSector += fat * bootSector->sectorsPerFat;
-
-        uint32_t fatStartByte = fatSector * bootSector->bytesPerSector;
-        uint32_t* fatData = (uint32_t*)((uint8_t*)volume->data + fatStartByte);
-
-        for (uint32_t i = 0; i < clusters - 1; i++)
-        {
-            fatData[results[i]] = results[i + 1];
-        }
-
-        fatData[results[clusters - 1]] = VOLUME_EOF;
+        SearchProgress* progress = settings->progress;
+
+        fprintf(output,
+            "%s: search stopped at its limit after %llu permutations, "
+            "%.1f%% of pass %u of %u covered\n",
+            recover,
+            (unsigned long long)progress->spent,
+            100 * progress->covered,
+            progress->pass,
+            progress->passes);
     }
-
-recover_fragmented_utility_exit:
+    else if (find == VOLUME_FIND_RESULT_SKIPPED)
+    {
+        VolumeIndexEntry* entry = recover_free_entry(&index, recover);
+        VolumeRootIterator* iterator = &entry->iterator;
+
+        // The search was declined because of its size, so the size is
+        // reported rather than a missing file.
+
+        fprintf(output,
+            "%s: %s: %u clusters exceeds --max-clusters\n",
+            recover,
+            volume_find_result_to_string(find),
+            volume_clusters(
+                iterator->entry->fileSize,
+                iterator->bytesPerCluster));
+    }
+    else
     {
         const char* message = volume_find_result_to_string(find);
 
         fprintf(output, "%s: %s\n", recover, message);
     }
+
+    finalize_volume_index(&index);
 }
@@ -0,0 +1,423 @@
+// run_search.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+
+#include <stdlib.h>
+#include <string.h>
+#include "run_search.h"
+
+static bool run_search_visit(
+    RunSearch* search,
+    uint32_t remaining,
+    const Hash* prefix);
+
+static bool run_search_overlaps(RunSearch* search, uint32_t cluster)
+{
+    for (uint32_t i = 0; i + 1 < search->fragmentCount; i++)
+    {
+        VolumeFreeRun* fragment = search->fragments + i;
+
+        if (cluster - fragment->first < fragment->length)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void run_search_tick(RunSearch* search)
+{
+    uint32_t count = search->count;
+    double covered = search->firstLength - 1;
+
+    // The first fragment is tried at each of its lengths in turn; at each
+    // length, the second fragment is tried at each free run in turn.
+
+    if (count)
+    {
+        covered += (double)search->secondRun / count;
+    }
+
+    search->published = search->counters.permutations;
+
+    if (!search_progress_update(
+        search->progress,
+        search->published,
+        covered / search->firstLimit))
+    {
+        search->stopped = true;
+    }
+}
+
+static bool run_search_test(
+    RunSearch* search,
+    const Hash* prefix,
+    uint32_t cluster,
+    uint32_t index)
+{
+    uint32_t remainder = search->fileSize;
+
+    remainder -= search->iterator->bytesPerCluster * index;
+
+    uint8_t* data = volume_root_data(search->iterator, cluster);
+    unsigned char digest[SHA_DIGEST_LENGTH];
+
+    if (!hash_copy(&search->leaf, prefix))
+    {
+        return false;
+    }
+
+    hash_update(&search->leaf, data, remainder);
+    hash_final(&search->leaf, digest);
+
+    search->counters.clusters++;
+    search->counters.bytes += remainder;
+    search->counters.permutations++;
+
+    if (search->counters.permutations - search->published >= search->period)
+    {
+        run_search_tick(search);
+    }
+
+    return memcmp(digest, search->sha1, SHA_DIGEST_LENGTH) == 0;
+}
+
+static bool run_search_extend(
+    RunSearch* search,
+    uint32_t first,
+    uint32_t limit,
+    uint32_t remaining,
+    const Hash* prefix)
+{
+    uint32_t bytesPerCluster = search->iterator->bytesPerCluster;
+    uint32_t index = search->clusters - remaining;
+    VolumeFreeRun* fragment = search->fragments + search->fragmentCount;
+    Hash* context = search->contexts + search->fragmentCount;
+
+    if (!hash_copy(context, prefix))
+    {
+        return false;
+    }
+
+    fragment->first = first;
+    fragment->length = 0;
+    search->fragmentCount++;
+
+    // Each length of the fragment extends the previous one by one cluster, so
+    // the saved state is advanced rather than recomputed.
+
+    for (uint32_t length = 1; length <= limit && !search->stopped; length++)
+    {
+        uint32_t cluster = first + length - 1;
+
+        if (search->fragmentCount == 1)
+        {
+            search->firstLength = length;
+            search->secondRun = 0;
+        }
+
+        if (run_search_overlaps(search, cluster))
+        {
+            break;
+        }
+
+        if (length == remaining)
+        {
+            if (run_search_test(search, context, cluster, index + length - 1))
+            {
+                fragment->length = length;
+
+                return true;
+            }
+
+            break;
+        }
+
+        uint8_t* data = volume_root_data(search->iterator, cluster);
+
+        hash_update(context, data, bytesPerCluster);
+
+        search->counters.clusters++;
+        search->counters.bytes += bytesPerCluster;
+
+        fragment->length = length;
+
+        if (search->fragmentCount < search->maxFragments &&
+            run_search_visit(search, remaining - length, context))
+        {
+            return true;
+        }
+    }
+
+    search->fragmentCount--;
+
+    return false;
+}
+
+static bool run_search_visit(
+    RunSearch* search,
+    uint32_t remaining,
+    const Hash* prefix)
+{
+    for (uint32_t i = 0; i < search->count && !search->stopped; i++)
+    {
+        VolumeFreeRun* run = search->runs + i;
+
+        if (search->fragmentCount == 1)
+        {
+            search->secondRun = i;
+        }
+
+        if (run_search_extend(search, run->first, run->length, remaining, prefix))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool run_search_runs(
+    RunSearch* search,
+    Volume* volume,
+    const VolumeIndex* index)
+{
+    VolumeFreeMap freeMap;
+
+    if (!volume_free_map(&freeMap, volume))
+    {
+        return false;
+    }
+
+    volume_free_map_reserve_index(&freeMap, index);
+
+    uint32_t capacity = 0;
+    uint32_t cluster = 0;
+    VolumeFreeRun run;
+
+    search->count = 0;
+    search->runs = NULL;
+
+    while (volume_free_map_next_run(&freeMap, &cluster, &run))
+    {
+        if (search->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+
+            VolumeFreeRun* runs = realloc(
+                search->runs,
+                capacity * sizeof * runs);
+
+            if (!runs)
+            {
+                free(search->runs);
+                finalize_volume_free_map(&freeMap);
+
+                return false;
+            }
+
+            search->runs = runs;
+        }
+
+        search->runs[search->count] = run;
+        search->count++;
+    }
+
+    finalize_volume_free_map(&freeMap);
+
+    return true;
+}
+
+VolumeFindResult run_search(
+    uint32_t results[],
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings)
+{
+    if (!clusters)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
+
+    if (settings->maxClusters && clusters > settings->maxClusters)
+    {
+        return VOLUME_FIND_RESULT_SKIPPED;
+    }
+
+    RunSearch search;
+
+    search.stopped = false;
+    search.clusters = clusters;
+    search.fileSize = iterator->entry->fileSize;
+    search.maxFragments = clusters;
+    search.fragmentCount = 0;
+    search.firstLength = 1;
+    search.secondRun = 0;
+    search.sha1 = sha1;
+    search.iterator = iterator;
+    search.progress = settings->progress;
+    search.period = UINT64_MAX;
+    search.published = 0;
+
+    if (settings->maxRuns && settings->maxRuns < clusters)
+    {
+        search.maxFragments = settings->maxRuns;
+    }
+
+    memset(&search.counters, 0, sizeof search.counters);
+    double start = trace_now(settings->trace);
+
+    stats_begin(settings->stats, STATS_PHASE_CANDIDATES);
+
+    bool runs = run_search_runs(&search, iterator->instance, index);
+
+    stats_end(settings->stats, STATS_PHASE_CANDIDATES);
+    trace_span(settings->trace, "candidates", start);
+
+    if (!runs)
+    {
+        return VOLUME_FIND_RESULT_NOT_FOUND;
+    }
+
+    VolumeFindResult result = VOLUME_FIND_RESULT_NOT_FOUND;
+
+    search.fragments = malloc(search.maxFragments * sizeof * search.fragments);
+
+    if (!search.fragments)
+    {
+        goto run_search_exit;
+    }
+
+    search.contexts = malloc(search.maxFragments * sizeof * search.contexts);
+    search.contextCount = 0;
+
+    if (!search.contexts)
+    {
+        goto run_search_exit_fragments;
+    }
+
+    const HashBackend* backend = hash_backend();
+
+    for (; search.contextCount < search.maxFragments; search.contextCount++)
+    {
+        if (!hash(search.contexts + search.contextCount, backend))
+        {
+            goto run_search_exit_contexts;
+        }
+    }
+
+    if (!hash(&search.leaf, backend))
+    {
+        goto run_search_exit_contexts;
+    }
+
+    // The first fragment begins at the first cluster of the file and may
+    // extend into the free run that immediately follows it.
+
+    uint32_t hi = iterator->entry->firstClusterHi;
+    uint32_t lo = iterator->entry->firstClusterLo;
+    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+    uint32_t limit = 1;
+
+    for (uint32_t i = 0; i < search.count; i++)
+    {
+        if (search.runs[i].first == firstCluster + 1)
+        {
+            limit += search.runs[i].length;
+
+            break;
+        }
+    }
+
+    Hash context;
+
+    if (!hash(&context, backend))
+    {
+        goto run_search_exit_leaf;
+    }
+
+    // The search reports its work often enough to stop close to the node
+    // limit, and never if nobody watches it.
+
+    SearchProgress* progress = search.progress;
+
+    search.firstLimit = limit;
+
+    if (progress)
+    {
+        search.period = SEARCH_PROGRESS_PERMUTATIONS;
+
+        if (progress->nodeLimit > progress->spent &&
+            progress->nodeLimit - progress->spent < search.period)
+        {
+            search.period = progress->nodeLimit - progress->spent;
+        }
+    }
+
+    search_progress_begin(progress, 1, 1);
+
+    start = trace_now(settings->trace);
+
+    stats_begin(settings->stats, STATS_PHASE_SEARCH);
+
+    bool found = run_search_extend(
+        &search,
+        firstCluster,
+        limit,
+        clusters,
+        &context);
+
+    stats_end(settings->stats, STATS_PHASE_SEARCH);
+    stats_add(settings->stats, STATS_PHASE_SEARCH, &search.counters);
+    trace_span(settings->trace, "search", start);
+    search_progress_end(progress, search.counters.permutations);
+    finalize_hash(&context);
+
+    if (!found)
+    {
+        if (search.stopped)
+        {
+            result = VOLUME_FIND_RESULT_STOPPED;
+        }
+
+        goto run_search_exit_leaf;
+    }
+
+    uint32_t* next = results;
+
+    for (uint32_t i = 0; i < search.fragmentCount; i++)
+    {
+        for (uint32_t j = 0; j < search.fragments[i].length; j++)
+        {
+            *next = search.fragments[i].first + j;
+            next++;
+        }
+    }
+
+    result = VOLUME_FIND_RESULT_SHA1_FOUND;
+
+run_search_exit_leaf:
+    finalize_hash(&search.leaf);
+
+run_search_exit_contexts:
+    for (uint32_t i = 0; i < search.contextCount; i++)
+    {
+        finalize_hash(search.contexts + i);
+    }
+
+    free(search.contexts);
+
+run_search_exit_fragments:
+    free(search.fragments);
+
+run_search_exit:
+    free(search.runs);
+
+    return result;
+}
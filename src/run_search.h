@@ -0,0 +1,121 @@
+// run_search.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef RUN_SEARCH_H
+#define RUN_SEARCH_H
+#include <openssl/sha.h>
+#include "hash.h"
+#include "settings.h"
+#include "volume_free_map.h"
+#include "volume_root_iterator.h"
+
+/**
+ * Represents a depth-first search over the ways to split a fragmented file
+ * into contiguous fragments. The first fragment begins at the first cluster of
+ * the file; every other fragment begins at the first cluster of a free run. The
+ * search keeps one saved SHA-1 state per fragment so that extending a fragment
+ * by one cluster hashes only that cluster.
+ */
+struct RunSearch
+{
+    /** `true` if the search spent its budget; otherwise, `false`. */
+    bool stopped;
+
+    /** Specifies the number of clusters in the file. */
+    uint32_t clusters;
+
+    /** Specifies the file size in bytes. */
+    uint32_t fileSize;
+
+    /** Specifies the maximum number of fragments. */
+    uint32_t maxFragments;
+
+    /** Specifies the number of free runs. */
+    uint32_t count;
+
+    /** Specifies the number of fragments in the current prefix. */
+    uint32_t fragmentCount;
+
+    /** Specifies the maximum length of the first fragment. */
+    uint32_t firstLimit;
+
+    /** Specifies the length of the first fragment in the current prefix. */
+    uint32_t firstLength;
+
+    /** Specifies the free run that begins the second fragment, if any. */
+    uint32_t secondRun;
+
+    /** Specifies the free runs. */
+    VolumeFreeRun* runs;
+
+    /** Specifies the fragments in the current prefix. */
+    VolumeFreeRun* fragments;
+
+    /** Specifies the SHA-1 state after hashing each fragment in the prefix. */
+    Hash* contexts;
+
+    /** Specifies the number of initialized elements in `contexts`. */
+    uint32_t contextCount;
+
+    /** Specifies the SHA-1 state used to finish each candidate. */
+    Hash leaf;
+
+    /** The work done by the search. */
+    StatsCounters counters;
+
+    /** The progress and budget of the search, or `NULL`. */
+    SearchProgress* progress;
+
+    /**
+     * Specifies the number of permutations tested between two reports of the
+     * work done.
+     */
+    uint64_t period;
+
+    /** Specifies the number of permutations tested when last reported. */
+    uint64_t published;
+
+    /** The SHA-1 digest to match. */
+    unsigned char* sha1;
+
+    /** The iterator used to locate cluster data. */
+    VolumeRootIterator* iterator;
+};
+
+/**
+ * Represents a depth-first search over the ways to split a fragmented file
+ * into contiguous fragments.
+ */
+typedef struct RunSearch RunSearch;
+
+/**
+ * Searches for the cluster chain of a free file whose SHA-1 digest matches the
+ * given digest, assuming that the file consists of at most
+ * `settings->maxRuns` contiguous fragments. Given `settings->progress`, the
+ * search reports its work to it and stops once it spends the budget of the
+ * run.
+ *
+ * @param results  when this method returns, contains the cluster chain of the
+ *                 file if a match was found. This argument is passed
+ *                 uninitialized and must have room for `clusters` elements.
+ * @param clusters the number of clusters in the file.
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param index    the index of the deleted files and directories, whose
+ *                 first clusters are never drawn.
+ * @param sha1     the SHA-1 digest to match.
+ * @param settings the search settings.
+ * @return `VOLUME_FIND_RESULT_SHA1_FOUND` if a match was found;
+ *         `VOLUME_FIND_RESULT_STOPPED` if the budget was spent first;
+ *         `VOLUME_FIND_RESULT_SKIPPED` if the file has more clusters than
+ *         `--max-clusters`; otherwise, `VOLUME_FIND_RESULT_NOT_FOUND`.
+ */
+VolumeFindResult run_search(
+    uint32_t results[],
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+#endif
@@ -0,0 +1,308 @@
+// search_checkpoint.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man2/fsync.2.html
+//  - https://www.man7.org/linux/man-pages/man2/rename.2.html
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hash.h"
+#include "search_checkpoint.h"
+#include "volume_transaction.h"
+
+bool search_checkpoint_key(
+    unsigned char result[SHA_DIGEST_LENGTH],
+    VolumeRootIterator* iterator,
+    uint32_t count,
+    const unsigned char sha1[SHA_DIGEST_LENGTH])
+{
+    Volume* volume = iterator->instance;
+    VolumeGeometry* geometry = &volume->geometry;
+    uint64_t offset = (uint8_t*)iterator->entry - (uint8_t*)volume->data;
+    Hash context;
+
+    if (!hash(&context, hash_backend()))
+    {
+        return false;
+    }
+
+    // The boot sector and the file allocation table identify the disk image
+    // and fix the candidates; the entry and its position identify the file.
+
+    hash_update(&context, volume->data, (size_t)1 << geometry->sectorShift);
+    hash_update(
+        &context,
+        geometry->fat,
+        (size_t)geometry->fatEntries * sizeof * geometry->fat);
+    hash_update(&context, &offset, sizeof offset);
+    hash_update(&context, iterator->entry, sizeof * iterator->entry);
+    hash_update(&context, &count, sizeof count);
+    hash_update(&context, sha1, SHA_DIGEST_LENGTH);
+    hash_final(&context, result);
+    finalize_hash(&context);
+
+    return true;
+}
+
+bool search_checkpoint(
+    SearchCheckpoint* instance,
+    uint32_t clusters,
+    uint32_t workerCount)
+{
+    instance->clusters = clusters;
+    instance->count = 0;
+    instance->pass = 0;
+    instance->workerCount = workerCount;
+    instance->cursors = calloc(workerCount, sizeof * instance->cursors);
+    instance->ranks = calloc(
+        (size_t)workerCount * clusters,
+        sizeof * instance->ranks);
+
+    if (!instance->cursors || !instance->ranks)
+    {
+        free(instance->cursors);
+        free(instance->ranks);
+
+        return false;
+    }
+
+    for (uint32_t w = 0; w < workerCount; w++)
+    {
+        instance->cursors[w].task = SEARCH_CHECKPOINT_NO_TASK;
+        instance->cursors[w].ranks = instance->ranks + (size_t)w * clusters;
+    }
+
+    return true;
+}
+
+static bool search_checkpoint_write_cursor(
+    FILE* output,
+    const SearchCheckpointCursor* cursor)
+{
+    uint32_t depth = cursor->depth;
+
+    return fwrite(&cursor->head, sizeof cursor->head, 1, output) == 1 &&
+        fwrite(&cursor->tail, sizeof cursor->tail, 1, output) == 1 &&
+        fwrite(&cursor->task, sizeof cursor->task, 1, output) == 1 &&
+        fwrite(&depth, sizeof depth, 1, output) == 1 &&
+        (!depth ||
+            fwrite(cursor->ranks, sizeof * cursor->ranks, depth + 1, output) ==
+            depth + 1);
+}
+
+bool search_checkpoint_write(
+    const SearchCheckpoint* instance,
+    const char* path)
+{
+    size_t length = strlen(path);
+    char* temporary = malloc(length + sizeof ".tmp");
+
+    if (!temporary)
+    {
+        return false;
+    }
+
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", sizeof ".tmp");
+
+    FILE* output = fopen(temporary, "wb");
+    bool result = false;
+
+    if (!output)
+    {
+        goto search_checkpoint_write_exit;
+    }
+
+    uint32_t version = SEARCH_CHECKPOINT_VERSION;
+
+    result = fwrite(SEARCH_CHECKPOINT_MAGIC, 8, 1, output) == 1 &&
+        fwrite(&version, sizeof version, 1, output) == 1 &&
+        fwrite(instance->key, SHA_DIGEST_LENGTH, 1, output) == 1 &&
+        fwrite(
+            &instance->clusters,
+            sizeof instance->clusters,
+            1,
+            output) == 1 &&
+        fwrite(&instance->count, sizeof instance->count, 1, output) == 1 &&
+        fwrite(&instance->pass, sizeof instance->pass, 1, output) == 1 &&
+        fwrite(
+            &instance->workerCount,
+            sizeof instance->workerCount,
+            1,
+            output) == 1;
+
+    for (uint32_t w = 0; result && w < instance->workerCount; w++)
+    {
+        result = search_checkpoint_write_cursor(output, instance->cursors + w);
+    }
+
+    if (result && (fflush(output) == EOF || fsync(fileno(output)) == -1))
+    {
+        result = false;
+    }
+
+    if (fclose(output) == EOF)
+    {
+        result = false;
+    }
+
+    // The complete file replaces the previous checkpoint in one step, and the
+    // new directory entry is flushed so that a crash cannot bring the
+    // previous checkpoint back.
+
+    if (result && rename(temporary, path) == -1)
+    {
+        result = false;
+    }
+
+    if (result && !volume_transaction_sync_directory(path))
+    {
+        result = false;
+
+        goto search_checkpoint_write_exit;
+    }
+
+    if (!result)
+    {
+        int error = errno;
+
+        remove(temporary);
+
+        errno = error;
+    }
+
+search_checkpoint_write_exit:
+    free(temporary);
+
+    return result;
+}
+
+static bool search_checkpoint_read_cursor(
+    FILE* input,
+    SearchCheckpointCursor* cursor,
+    uint32_t clusters,
+    uint32_t count)
+{
+    if (fread(&cursor->head, sizeof cursor->head, 1, input) != 1 ||
+        fread(&cursor->tail, sizeof cursor->tail, 1, input) != 1 ||
+        fread(&cursor->task, sizeof cursor->task, 1, input) != 1 ||
+        fread(&cursor->depth, sizeof cursor->depth, 1, input) != 1 ||
+        cursor->head > cursor->tail ||
+        cursor->depth >= clusters)
+    {
+        return false;
+    }
+
+    if (!cursor->depth)
+    {
+        return true;
+    }
+
+    uint32_t depth = cursor->depth;
+
+    if (fread(cursor->ranks, sizeof * cursor->ranks, depth + 1, input) !=
+        depth + 1)
+    {
+        return false;
+    }
+
+    // The rank at the deepest level is one past the last tried, so it may
+    // equal the number of candidates.
+
+    for (uint32_t d = 0; d < depth; d++)
+    {
+        if (cursor->ranks[d] >= count)
+        {
+            return false;
+        }
+    }
+
+    return cursor->ranks[depth] <= count;
+}
+
+bool search_checkpoint_read(
+    SearchCheckpoint* instance,
+    const char* path,
+    const unsigned char key[SHA_DIGEST_LENGTH],
+    uint32_t clusters,
+    uint32_t count)
+{
+    FILE* input = fopen(path, "rb");
+
+    if (!input)
+    {
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version;
+    uint32_t pass;
+    uint32_t workerCount;
+    unsigned char fileKey[SHA_DIGEST_LENGTH];
+    uint32_t fileClusters;
+    uint32_t fileCount;
+    bool result = false;
+
+    if (fread(magic, sizeof magic, 1, input) != 1 ||
+        fread(&version, sizeof version, 1, input) != 1 ||
+        fread(fileKey, sizeof fileKey, 1, input) != 1 ||
+        fread(&fileClusters, sizeof fileClusters, 1, input) != 1 ||
+        fread(&fileCount, sizeof fileCount, 1, input) != 1 ||
+        fread(&pass, sizeof pass, 1, input) != 1 ||
+        fread(&workerCount, sizeof workerCount, 1, input) != 1 ||
+        memcmp(magic, SEARCH_CHECKPOINT_MAGIC, sizeof magic) != 0 ||
+        version != SEARCH_CHECKPOINT_VERSION ||
+        memcmp(fileKey, key, sizeof fileKey) != 0 ||
+        fileClusters != clusters ||
+        fileCount != count ||
+        !workerCount)
+    {
+        goto search_checkpoint_read_exit;
+    }
+
+    if (!search_checkpoint(instance, clusters, workerCount))
+    {
+        goto search_checkpoint_read_exit;
+    }
+
+    memcpy(instance->key, key, sizeof instance->key);
+
+    instance->count = count;
+    instance->pass = pass;
+    result = true;
+
+    for (uint32_t w = 0; result && w < workerCount; w++)
+    {
+        result = search_checkpoint_read_cursor(
+            input,
+            instance->cursors + w,
+            clusters,
+            count);
+    }
+
+    if (result && fgetc(input) != EOF)
+    {
+        result = false;
+    }
+
+    if (!result)
+    {
+        finalize_search_checkpoint(instance);
+    }
+
+search_checkpoint_read_exit:
+    fclose(input);
+
+    return result;
+}
+
+void finalize_search_checkpoint(SearchCheckpoint* instance)
+{
+    free(instance->cursors);
+    free(instance->ranks);
+}
@@ -0,0 +1,167 @@
+// search_checkpoint.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef SEARCH_CHECKPOINT_H
+#define SEARCH_CHECKPOINT_H
+#include <openssl/sha.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "volume_root_iterator.h"
+
+/** Specifies the bytes that begin a checkpoint file. */
+#define SEARCH_CHECKPOINT_MAGIC "NYUCHECK"
+
+/** Specifies the version of the checkpoint file format. */
+#define SEARCH_CHECKPOINT_VERSION 1
+
+/** Specifies the number of seconds between two checkpoints. */
+#define SEARCH_CHECKPOINT_INTERVAL 10
+
+/** Specifies the task of a worker that is between tasks. */
+#define SEARCH_CHECKPOINT_NO_TASK UINT64_MAX
+
+/**
+ * Represents the position of one worker of a combinatorial search: the slots
+ * left in its queue, and the task in progress with the rank of the candidate
+ * tried at each depth below the prefix that the task fixes.
+ */
+struct SearchCheckpointCursor
+{
+    /** Specifies the slot of the first task in the queue. */
+    uint64_t head;
+
+    /** Specifies the slot one past the last task in the queue. */
+    uint64_t tail;
+
+    /** Specifies the task in progress, or `SEARCH_CHECKPOINT_NO_TASK`. */
+    uint64_t task;
+
+    /**
+     * Specifies the depth of the candidate being tried, or `0` if the task
+     * starts over.
+     */
+    uint32_t depth;
+
+    /**
+     * Specifies the rank of the candidate tried at each depth up to `depth`,
+     * in the order of locality of that depth.
+     */
+    uint32_t* ranks;
+};
+
+/** Represents the position of one worker of a combinatorial search. */
+typedef struct SearchCheckpointCursor SearchCheckpointCursor;
+
+/**
+ * Represents the state of a combinatorial search, from which it resumes after
+ * being stopped. A search is keyed by the disk image, the directory entry of
+ * the file and the digest sought, so that a checkpoint never resumes another.
+ */
+struct SearchCheckpoint
+{
+    /** Specifies the key of the search. */
+    unsigned char key[SHA_DIGEST_LENGTH];
+
+    /** Specifies the number of clusters in the file. */
+    uint32_t clusters;
+
+    /** Specifies the number of candidate clusters. */
+    uint32_t count;
+
+    /** Specifies the pass of the search. */
+    uint32_t pass;
+
+    /** Specifies the number of workers. */
+    uint32_t workerCount;
+
+    /** Specifies the cursor of each worker. */
+    SearchCheckpointCursor* cursors;
+
+    /** Specifies the ranks of every cursor. */
+    uint32_t* ranks;
+};
+
+/**
+ * Represents the state of a combinatorial search, from which it resumes after
+ * being stopped.
+ */
+typedef struct SearchCheckpoint SearchCheckpoint;
+
+/**
+ * Computes the key of a search from the boot sector and first file allocation
+ * table of the disk image, the position and contents of the directory entry
+ * of the file, the number of candidate clusters, and the digest sought.
+ *
+ * @param result   when this method returns, contains the key. This argument
+ *                 is passed uninitialized.
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param count    the number of candidate clusters.
+ * @param sha1     the SHA-1 digest sought.
+ * @return `true` if the operation succeeded; otherwise `false`.
+ */
+bool search_checkpoint_key(
+    unsigned char result[SHA_DIGEST_LENGTH],
+    VolumeRootIterator* iterator,
+    uint32_t count,
+    const unsigned char sha1[SHA_DIGEST_LENGTH]);
+
+/**
+ * Initializes an instance of the `SearchCheckpoint` struct with room for the
+ * cursors of the given number of workers.
+ *
+ * @param instance    the `SearchCheckpoint` instance.
+ * @param clusters    the number of clusters in the file.
+ * @param workerCount the number of workers.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool search_checkpoint(
+    SearchCheckpoint* instance,
+    uint32_t clusters,
+    uint32_t workerCount);
+
+/**
+ * Writes a checkpoint file and flushes it to storage. The file is written
+ * beside the given path and then renamed over it, so that a search stopped
+ * while writing leaves the previous checkpoint whole. The file holds a header
+ * followed by the cursor of each worker. All integers are little-endian.
+ *
+ * @param instance the `SearchCheckpoint` instance.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the checkpoint file to create or replace.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool search_checkpoint_write(
+    const SearchCheckpoint* instance,
+    const char* path);
+
+/**
+ * Initializes an instance of the `SearchCheckpoint` struct from a checkpoint
+ * file written for the search of the given key.
+ *
+ * @param instance the `SearchCheckpoint` instance.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the checkpoint file.
+ * @param key      the key of the search.
+ * @param clusters the number of clusters in the file.
+ * @param count    the number of candidate clusters.
+ * @return `true` if the file holds a checkpoint of the search; otherwise
+ *         `false`.
+ */
+bool search_checkpoint_read(
+    SearchCheckpoint* instance,
+    const char* path,
+    const unsigned char key[SHA_DIGEST_LENGTH],
+    uint32_t clusters,
+    uint32_t count);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `SearchCheckpoint` instance.
+ */
+void finalize_search_checkpoint(SearchCheckpoint* instance);
+
+#endif
@@ -0,0 +1,443 @@
+// search_plan.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+//  - https://en.wikipedia.org/wiki/Permutation#k-permutations_of_n
+//  - https://en.wikipedia.org/wiki/Composition_(combinatorics)
+
+#include <stdlib.h>
+#include "ranked_search.h"
+#include "search_plan.h"
+#include "volume_free_map.h"
+
+static const char* SEARCH_PLAN_STRATEGIES[] =
+{
+    [SEARCH_STRATEGY_PERMUTATION] = "permutation",
+    [SEARCH_STRATEGY_RUN] = "run",
+    [SEARCH_STRATEGY_AUTO] = "auto"
+};
+
+static double search_plan_clamp(double nodes)
+{
+    if (nodes > SEARCH_PLAN_HORIZON)
+    {
+        return SEARCH_PLAN_HORIZON;
+    }
+
+    return nodes;
+}
+
+static double search_plan_permutation_nodes(
+    uint32_t candidates,
+    uint32_t clusters,
+    double acceptance)
+{
+    double result = 0;
+    double level = 1;
+
+    // Depth d places one of the k-permutations of d candidates; below the
+    // second cluster, only the prefixes that the format accepts are extended.
+
+    for (uint32_t d = 1; d < clusters && d <= candidates; d++)
+    {
+        level *= candidates - d + 1;
+
+        if (d == 2)
+        {
+            level *= acceptance;
+        }
+
+        result += level;
+
+        if (result >= SEARCH_PLAN_HORIZON)
+        {
+            break;
+        }
+    }
+
+    return search_plan_clamp(result);
+}
+
+static bool search_plan_run_nodes(
+    double* result,
+    const double atLeast[],
+    uint32_t clusters,
+    uint32_t runs,
+    uint32_t limit,
+    uint32_t maxFragments)
+{
+    double* previous = calloc(clusters, sizeof * previous);
+    double* current = calloc(clusters, sizeof * current);
+
+    if (!previous || !current)
+    {
+        free(previous);
+        free(current);
+
+        return false;
+    }
+
+    // previous[m] counts the nodes below a prefix with m clusters left to
+    // place and f fragments left to begin. Every fragment begins at a free
+    // run and is at most as long as it. A run taken by an earlier fragment is
+    // not taken again, which is approximated by the share of the runs that
+    // the earlier fragments leave; once none is left, the count is zero.
+
+    uint32_t f = 1;
+
+    if (maxFragments > runs + 1)
+    {
+        f = maxFragments - runs;
+    }
+
+    for (; f < maxFragments && f < clusters; f++)
+    {
+        uint32_t taken = maxFragments - 1 - f;
+        double share = 0;
+
+        if (taken < runs)
+        {
+            share = (double)(runs - taken) / runs;
+        }
+
+        for (uint32_t m = 1; m < clusters; m++)
+        {
+            double nodes = 0;
+
+            for (uint32_t length = 1; length <= m && atLeast[length]; length++)
+            {
+                double below = 0;
+
+                if (length < m)
+                {
+                    below = previous[m - length];
+                }
+
+                nodes += share * atLeast[length] * (1 + below);
+            }
+
+            current[m] = search_plan_clamp(nodes);
+        }
+
+        double* swap = previous;
+
+        previous = current;
+        current = swap;
+
+        if (previous[clusters - 1] >= SEARCH_PLAN_HORIZON)
+        {
+            break;
+        }
+    }
+
+    // The first fragment begins at the first cluster of the file.
+
+    double nodes = 0;
+
+    for (uint32_t length = 1; length <= limit && length <= clusters; length++)
+    {
+        nodes++;
+
+        if (length < clusters)
+        {
+            nodes += previous[clusters - length];
+        }
+    }
+
+    *result = search_plan_clamp(nodes);
+
+    free(previous);
+    free(current);
+
+    return true;
+}
+
+static bool search_plan_accepts(
+    const SearchPlan* plan,
+    const Validator* first,
+    VolumeRootIterator* iterator,
+    uint32_t cluster)
+{
+    Validator validator;
+    uint32_t size = iterator->bytesPerCluster;
+    uint8_t* data = volume_root_data(iterator, cluster);
+
+    validator_copy(&validator, first);
+
+    if (plan->clusters == 2)
+    {
+        size = iterator->entry->fileSize - size;
+
+        return validator_update(&validator, data, size) &&
+            validator_final(&validator);
+    }
+
+    return validator_update(&validator, data, size);
+}
+
+bool search_plan(
+    SearchPlan* instance,
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    const Settings* settings)
+{
+    uint32_t hi = iterator->entry->firstClusterHi;
+    uint32_t lo = iterator->entry->firstClusterLo;
+    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+    uint8_t* data = volume_root_data(iterator, firstCluster);
+    Validator first;
+
+    instance->skipped = !settings->top &&
+        settings->maxClusters && clusters > settings->maxClusters;
+    instance->ranked = settings->top != 0;
+    instance->fallback = false;
+    instance->strategy = settings->strategy;
+    instance->clusters = clusters;
+    instance->runs = 0;
+    instance->maxFragments = clusters;
+    instance->acceptance = 1;
+    instance->contiguousNodes = 1;
+    instance->runNodes = 0;
+    instance->permutationNodes = 0;
+    instance->rankedNodes = settings->nodeLimit;
+
+    if (settings->maxRuns && settings->maxRuns < clusters)
+    {
+        instance->maxFragments = settings->maxRuns;
+    }
+
+    if (!settings->nodeLimit && !settings->timeLimit)
+    {
+        instance->rankedNodes = RANKED_SEARCH_NODE_LIMIT;
+    }
+
+    // As in the searches, a format is validated only if the first cluster is
+    // itself accepted.
+
+    instance->format = validator_format(data, iterator->bytesPerCluster);
+
+    if (instance->format)
+    {
+        validator(&first, instance->format);
+
+        if (!validator_update(&first, data, iterator->bytesPerCluster))
+        {
+            instance->format = NULL;
+        }
+    }
+
+    VolumeFreeMap freeMap;
+
+    if (!volume_free_map(&freeMap, iterator->instance))
+    {
+        return false;
+    }
+
+    volume_free_map_reserve_index(&freeMap, index);
+
+    double* atLeast = calloc(clusters + 1, sizeof * atLeast);
+
+    if (!atLeast)
+    {
+        finalize_volume_free_map(&freeMap);
+
+        return false;
+    }
+
+    uint32_t n = freeMap.count;
+
+    if (settings->maxCandidates && n > settings->maxCandidates)
+    {
+        n = settings->maxCandidates;
+    }
+
+    // The candidates are sampled evenly, in the order in which the searches
+    // take them.
+
+    uint32_t stride = n / SEARCH_PLAN_SAMPLE + 1;
+    uint32_t sampled = 0;
+    uint32_t accepted = 0;
+    uint32_t limit = 1;
+    uint32_t position = 0;
+    uint32_t cluster = 0;
+    VolumeFreeRun run;
+
+    instance->candidates = n;
+
+    while (volume_free_map_next_run(&freeMap, &cluster, &run))
+    {
+        uint32_t length = run.length;
+
+        instance->runs++;
+
+        if (run.first == firstCluster + 1)
+        {
+            limit += run.length;
+        }
+
+        if (length > clusters)
+        {
+            length = clusters;
+        }
+
+        atLeast[length]++;
+
+        for (uint32_t i = 0; i < run.length && position < n; i++, position++)
+        {
+            if (instance->format && position % stride == 0)
+            {
+                sampled++;
+
+                if (search_plan_accepts(
+                    instance,
+                    &first,
+                    iterator,
+                    run.first + i))
+                {
+                    accepted++;
+                }
+            }
+        }
+    }
+
+    finalize_volume_free_map(&freeMap);
+
+    // A run at least l clusters long can hold a fragment of length l.
+
+    for (uint32_t length = clusters; length > 1; length--)
+    {
+        atLeast[length - 1] += atLeast[length];
+    }
+
+    if (sampled)
+    {
+        instance->acceptance = (double)accepted / sampled;
+    }
+
+    instance->permutationNodes = search_plan_permutation_nodes(
+        n,
+        clusters,
+        instance->acceptance);
+
+    bool result = search_plan_run_nodes(
+        &instance->runNodes,
+        atLeast,
+        clusters,
+        instance->runs,
+        limit,
+        instance->maxFragments);
+
+    free(atLeast);
+
+    // A run search that fails leaves only the fragmentations it cannot
+    // express, so the permutation search follows it.
+
+    if (settings->strategy == SEARCH_STRATEGY_AUTO)
+    {
+        instance->strategy = SEARCH_STRATEGY_PERMUTATION;
+
+        if (instance->runNodes < instance->permutationNodes)
+        {
+            instance->strategy = SEARCH_STRATEGY_RUN;
+            instance->fallback = true;
+        }
+    }
+
+    return result;
+}
+
+static void search_plan_write_nodes(FILE* output, double nodes)
+{
+    if (nodes >= SEARCH_PLAN_HORIZON)
+    {
+        fprintf(output, "more than %.0e nodes", SEARCH_PLAN_HORIZON);
+    }
+    else if (nodes < 1e6)
+    {
+        fprintf(output, "%.0f node%s", nodes, nodes == 1 ? "" : "s");
+    }
+    else
+    {
+        fprintf(output, "%.2e nodes", nodes);
+    }
+}
+
+bool search_plan_write(
+    const SearchPlan* instance,
+    FILE* output,
+    const char* path)
+{
+    fprintf(output,
+        "%s: %u clusters, %u candidates in %u free runs\n",
+        path,
+        instance->clusters,
+        instance->candidates,
+        instance->runs);
+
+    if (instance->format)
+    {
+        fprintf(output,
+            "%s: %s format, %.1f%% of candidates accepted after the first "
+            "cluster\n",
+            path,
+            instance->format->name,
+            100 * instance->acceptance);
+    }
+    else
+    {
+        fprintf(output, "%s: format not validated\n", path);
+    }
+
+    // The ranked search replaces the others, which need a digest.
+
+    if (instance->ranked)
+    {
+        fprintf(output, "%s:   ranked       ", path);
+
+        if (instance->rankedNodes)
+        {
+            fputs("at most ", output);
+            search_plan_write_nodes(output, instance->rankedNodes);
+        }
+        else
+        {
+            fputs("until the time limit", output);
+        }
+
+        fprintf(output, "\n%s: plan: ranked\n", path);
+
+        return fflush(output) != EOF && !ferror(output);
+    }
+
+    fprintf(output, "%s:   contiguous   ", path);
+    search_plan_write_nodes(output, instance->contiguousNodes);
+    fprintf(output, "\n%s:   run          ", path);
+    search_plan_write_nodes(output, instance->runNodes);
+    fprintf(output, ", at most %u fragments", instance->maxFragments);
+    fprintf(output, "\n%s:   permutation  ", path);
+    search_plan_write_nodes(output, instance->permutationNodes);
+    fprintf(output, "\n%s: plan: contiguous, then ", path);
+
+    if (instance->skipped)
+    {
+        fputs("no search (more clusters than --max-clusters)", output);
+    }
+    else
+    {
+        fputs(SEARCH_PLAN_STRATEGIES[instance->strategy], output);
+
+        if (instance->fallback)
+        {
+            fprintf(output,
+                ", then %s",
+                SEARCH_PLAN_STRATEGIES[SEARCH_STRATEGY_PERMUTATION]);
+        }
+    }
+
+    fputc('\n', output);
+
+    return fflush(output) != EOF && !ferror(output);
+}
@@ -0,0 +1,125 @@
+// search_plan.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef SEARCH_PLAN_H
+#define SEARCH_PLAN_H
+#include <stdio.h>
+#include "settings.h"
+#include "validator.h"
+#include "volume_index.h"
+#include "volume_root_iterator.h"
+
+/**
+ * Specifies the number of candidates validated as the second cluster of the
+ * file to estimate the fraction that the format accepts.
+ */
+#define SEARCH_PLAN_SAMPLE 1024
+
+/**
+ * Specifies the number of nodes past which an estimate is no longer refined.
+ * No search of this size finishes.
+ */
+#define SEARCH_PLAN_HORIZON 1e30
+
+/**
+ * Represents an estimate of the work done by each strategy of the fragmented
+ * search for one file, and the strategy chosen. Each estimate counts the
+ * clusters placed in a candidate cluster chain, in the worst case, when the
+ * file is not found.
+ */
+struct SearchPlan
+{
+    /** `true` if the file is too large to be searched. */
+    bool skipped;
+
+    /** `true` if the digest is unknown and the ranked search is used. */
+    bool ranked;
+
+    /** `true` if the permutation search follows a run search that fails. */
+    bool fallback;
+
+    /** Specifies the strategy chosen. */
+    SearchStrategy strategy;
+
+    /** Specifies the number of clusters in the file. */
+    uint32_t clusters;
+
+    /** Specifies the number of candidate clusters. */
+    uint32_t candidates;
+
+    /** Specifies the number of free runs. */
+    uint32_t runs;
+
+    /** Specifies the maximum number of fragments tried by the run search. */
+    uint32_t maxFragments;
+
+    /** The format of the file, or `NULL` if the format is not validated. */
+    const ValidatorFormat* format;
+
+    /**
+     * Specifies the fraction of the sampled candidates that the format accepts
+     * as the second cluster of the file, or `1` if the format is not
+     * validated.
+     */
+    double acceptance;
+
+    /** Specifies the estimated number of nodes of the contiguous check. */
+    double contiguousNodes;
+
+    /** Specifies the estimated number of nodes of the run search. */
+    double runNodes;
+
+    /** Specifies the estimated number of nodes of the permutation search. */
+    double permutationNodes;
+
+    /**
+     * Specifies the maximum number of nodes of the ranked search, or `0` if
+     * only its time limit bounds it.
+     */
+    double rankedNodes;
+};
+
+/**
+ * Represents an estimate of the work done by each strategy of the fragmented
+ * search for one file.
+ */
+typedef struct SearchPlan SearchPlan;
+
+/**
+ * Initializes an instance of the `SearchPlan` struct by estimating the work
+ * done by each strategy from the number of clusters in a free file, the
+ * lengths of the free runs, and the fraction of candidates that its format
+ * accepts. Given `SEARCH_STRATEGY_AUTO`, the strategy of fewest nodes is
+ * chosen; otherwise, the strategy given is kept.
+ *
+ * @param instance the `SearchPlan` instance.
+ * @param clusters the number of clusters in the file.
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param index    the index of the deleted files and directories, whose
+ *                 first clusters are never drawn.
+ * @param settings the search settings.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool search_plan(
+    SearchPlan* instance,
+    uint32_t clusters,
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    const Settings* settings);
+
+/**
+ * Writes a search plan as text, one line per strategy.
+ *
+ * @param instance the `SearchPlan` instance.
+ * @param output   the output stream.
+ * @param path     the path of the file, which begins each line.
+ * @return `true` if the operation succeeded; otherwise `false`.
+ */
+bool search_plan_write(
+    const SearchPlan* instance,
+    FILE* output,
+    const char* path);
+
+#endif
@@ -0,0 +1,229 @@
+// search_progress.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+//  - https://www.man7.org/linux/man-pages/man3/isatty.3.html
+
+#include <time.h>
+#include <unistd.h>
+#include "search_progress.h"
+
+static double search_progress_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void search_progress(
+    SearchProgress* instance,
+    FILE* output,
+    uint64_t nodeLimit,
+    double timeLimit)
+{
+    instance->stopped = false;
+    instance->pending = false;
+    instance->output = output;
+    instance->name = NULL;
+    instance->nodeLimit = nodeLimit;
+    instance->timeLimit = timeLimit;
+    instance->deadline = 0;
+    instance->spent = 0;
+    instance->nodes = 0;
+    instance->pass = 1;
+    instance->passes = 1;
+    instance->start = 0;
+    instance->measured = 0;
+    instance->measuredCovered = -1;
+    instance->covered = 0;
+    instance->reported = 0;
+}
+
+bool search_progress_file(SearchProgress* instance, const char* name)
+{
+    if (!instance)
+    {
+        return true;
+    }
+
+    double now = search_progress_now();
+
+    // The time limit is counted from the first search of the run, so that a
+    // manifest shares one budget.
+
+    if (instance->timeLimit && !instance->deadline)
+    {
+        instance->deadline = now + instance->timeLimit;
+    }
+
+    instance->name = name;
+
+    if (instance->deadline && now >= instance->deadline)
+    {
+        instance->stopped = true;
+    }
+
+    return !instance->stopped;
+}
+
+void search_progress_begin(
+    SearchProgress* instance,
+    uint32_t pass,
+    uint32_t passes)
+{
+    if (!instance)
+    {
+        return;
+    }
+
+    instance->nodes = 0;
+    instance->pass = pass;
+    instance->passes = passes;
+    instance->start = search_progress_now();
+    instance->measured = instance->start;
+    instance->measuredCovered = -1;
+    instance->covered = 0;
+    instance->reported = instance->start;
+}
+
+static void search_progress_write_eta(SearchProgress* instance, double now)
+{
+    FILE* output = instance->output;
+    double covered = instance->covered - instance->measuredCovered;
+
+    if (instance->measuredCovered < 0 || covered <= 0)
+    {
+        fputs("unknown", output);
+
+        return;
+    }
+
+    // The rest of the pass is assumed to go at the pace measured so far. A
+    // resumed pass is measured from where it resumed.
+
+    double seconds = (now - instance->measured) *
+        (1 - instance->covered) / covered;
+
+    if (seconds >= 360000)
+    {
+        fprintf(output, "%.3g days", seconds / 86400);
+
+        return;
+    }
+
+    unsigned long total = seconds + 0.5;
+
+    fprintf(output,
+        "%lu:%02lu:%02lu",
+        total / 3600,
+        total / 60 % 60,
+        total % 60);
+}
+
+static void search_progress_write(SearchProgress* instance, double now)
+{
+    FILE* output = instance->output;
+    double elapsed = now - instance->start;
+    double rate = 0;
+    bool terminal = isatty(fileno(output));
+
+    if (elapsed > 0)
+    {
+        rate = instance->nodes / elapsed;
+    }
+
+    // A terminal shows one line, rewritten in place; any other stream keeps
+    // every line.
+
+    fprintf(output,
+        "%s%s: pass %u of %u, %.1f%% covered, %.3g permutations/s, ETA ",
+        terminal ? "\r" : "",
+        instance->name,
+        instance->pass,
+        instance->passes,
+        100 * instance->covered,
+        rate);
+    search_progress_write_eta(instance, now);
+
+    if (terminal)
+    {
+        fputs("\033[K", output);
+
+        instance->pending = true;
+    }
+    else
+    {
+        fputc('\n', output);
+    }
+
+    fflush(output);
+}
+
+bool search_progress_update(
+    SearchProgress* instance,
+    uint64_t nodes,
+    double covered)
+{
+    if (!instance)
+    {
+        return true;
+    }
+
+    double now = search_progress_now();
+
+    instance->nodes = nodes;
+    instance->covered = covered;
+
+    if (instance->measuredCovered < 0)
+    {
+        instance->measuredCovered = covered;
+        instance->measured = now;
+    }
+
+    if ((instance->nodeLimit &&
+        instance->spent + nodes >= instance->nodeLimit) ||
+        (instance->deadline && now >= instance->deadline))
+    {
+        instance->stopped = true;
+    }
+
+    if (instance->output &&
+        now - instance->reported >= SEARCH_PROGRESS_INTERVAL)
+    {
+        search_progress_write(instance, now);
+
+        instance->reported = now;
+    }
+
+    return !instance->stopped;
+}
+
+void search_progress_end(SearchProgress* instance, uint64_t nodes)
+{
+    if (!instance)
+    {
+        return;
+    }
+
+    instance->nodes = nodes;
+    instance->spent += nodes;
+
+    // A search that spent the rest of the budget between two updates stops
+    // the run as surely as one stopped by an update.
+
+    if (instance->nodeLimit && instance->spent >= instance->nodeLimit)
+    {
+        instance->stopped = true;
+    }
+
+    if (instance->pending)
+    {
+        fputc('\n', instance->output);
+
+        instance->pending = false;
+    }
+}
@@ -0,0 +1,149 @@
+// search_progress.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef SEARCH_PROGRESS_H
+#define SEARCH_PROGRESS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Specifies the number of seconds between two progress lines. */
+#define SEARCH_PROGRESS_INTERVAL 1
+
+/**
+ * Specifies the number of permutations a search tests between two updates of
+ * its progress.
+ */
+#define SEARCH_PROGRESS_PERMUTATIONS 65536
+
+/**
+ * Represents the progress and budget of the fragmented searches of a run. The
+ * budget is shared by every search of the run; a search that spends it stops
+ * with the part of its search space it has covered. The progress is updated
+ * by one thread at a time.
+ */
+struct SearchProgress
+{
+    /** `true` if a search spent the budget. */
+    bool stopped;
+
+    /** `true` if a progress line is waiting for its line break. */
+    bool pending;
+
+    /** The stream to which progress lines are written, or `NULL`. */
+    FILE* output;
+
+    /**
+     * A pointer to a zero-terminated string containing the name of the file
+     * searched for.
+     */
+    const char* name;
+
+    /** Specifies the number of permutations in the budget, or `0`. */
+    uint64_t nodeLimit;
+
+    /** Specifies the number of seconds in the budget, or `0`. */
+    double timeLimit;
+
+    /** Specifies the time past which every search stops, or `0`. */
+    double deadline;
+
+    /** Specifies the number of permutations tested by earlier passes. */
+    uint64_t spent;
+
+    /** Specifies the number of permutations tested by the current pass. */
+    uint64_t nodes;
+
+    /** Specifies the pass of the current search, from `1`. */
+    uint32_t pass;
+
+    /** Specifies the number of passes of the current search. */
+    uint32_t passes;
+
+    /** Specifies the time at which the current pass began. */
+    double start;
+
+    /** Specifies the time at which the current pass was first measured. */
+    double measured;
+
+    /**
+     * Specifies the fraction of the current pass covered when it was first
+     * measured, or a negative number if it was not yet measured.
+     */
+    double measuredCovered;
+
+    /** Specifies the fraction of the current pass covered. */
+    double covered;
+
+    /** Specifies the time at which the last progress line was written. */
+    double reported;
+};
+
+/** Represents the progress and budget of the fragmented searches of a run. */
+typedef struct SearchProgress SearchProgress;
+
+/**
+ * Initializes an instance of the `SearchProgress` struct.
+ *
+ * @param instance  the `SearchProgress` instance.
+ * @param output    the stream to which progress lines are written, or `NULL`
+ *                  to write none.
+ * @param nodeLimit the number of permutations in the budget, or `0` if there
+ *                  is no limit.
+ * @param timeLimit the number of seconds in the budget, counted from the first
+ *                  search, or `0` if there is no limit.
+ */
+void search_progress(
+    SearchProgress* instance,
+    FILE* output,
+    uint64_t nodeLimit,
+    double timeLimit);
+
+/**
+ * Marks the beginning of the searches for a file.
+ *
+ * @param instance the `SearchProgress` instance, or `NULL`.
+ * @param name     a pointer to a zero-terminated string containing the name of
+ *                 the file searched for.
+ * @return `false` if the budget is already spent; otherwise, `true`.
+ */
+bool search_progress_file(SearchProgress* instance, const char* name);
+
+/**
+ * Marks the beginning of a pass of a search.
+ *
+ * @param instance the `SearchProgress` instance, or `NULL`.
+ * @param pass     the pass, from `1`.
+ * @param passes   the number of passes of the search.
+ */
+void search_progress_begin(
+    SearchProgress* instance,
+    uint32_t pass,
+    uint32_t passes);
+
+/**
+ * Records the work done by the current pass, stops the search once the budget
+ * is spent, and writes a progress line once one is due. The line gives the
+ * permutations tested per second, the fraction of the pass covered and the
+ * time left until the pass is finished at that pace.
+ *
+ * @param instance the `SearchProgress` instance, or `NULL`.
+ * @param nodes    the number of permutations tested by the pass.
+ * @param covered  the fraction of the pass covered.
+ * @return `false` if the search must stop; otherwise, `true`.
+ */
+bool search_progress_update(
+    SearchProgress* instance,
+    uint64_t nodes,
+    double covered);
+
+/**
+ * Marks the end of the current pass.
+ *
+ * @param instance the `SearchProgress` instance, or `NULL`.
+ * @param nodes    the number of permutations tested by the pass.
+ */
+void search_progress_end(SearchProgress* instance, uint64_t nodes);
+
+#endif
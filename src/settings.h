@@ -0,0 +1,114 @@
+// settings.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "search_progress.h"
+#include "stats.h"
+#include "trace.h"
+
+/** Specifies the strategy used by the fragmented search. */
+enum SearchStrategy
+{
+    /** Try every ordering of individual candidate clusters. */
+    SEARCH_STRATEGY_PERMUTATION = 0,
+
+    /** Try every split of the file into contiguous fragments. */
+    SEARCH_STRATEGY_RUN,
+
+    /** Try the strategy whose estimated number of nodes is least. */
+    SEARCH_STRATEGY_AUTO
+};
+
+/** Specifies the strategy used by the fragmented search. */
+typedef enum SearchStrategy SearchStrategy;
+
+/** Represents the tunable settings shared by the file-system utilities. */
+struct Settings
+{
+    /** Specifies the strategy used by the fragmented search. */
+    SearchStrategy strategy;
+
+    /**
+     * Specifies the number of threads used by the fragmented search and by the
+     * walk of the directory tree.
+     */
+    uint32_t threads;
+
+    /**
+     * Specifies the maximum number of candidate clusters considered by the
+     * fragmented search, or `0` if there is no limit.
+     */
+    uint32_t maxCandidates;
+
+    /**
+     * Specifies the maximum number of clusters in a file recovered by the
+     * fragmented search, or `0` if there is no limit.
+     */
+    uint32_t maxClusters;
+
+    /**
+     * Specifies the maximum number of contiguous fragments considered by the
+     * run search, or `0` if there is no limit.
+     */
+    uint32_t maxRuns;
+
+    /**
+     * Specifies the number of reconstructions kept by the fragmented search of
+     * a file whose digest is unknown, or `0` if a digest is required.
+     */
+    uint32_t top;
+
+    /**
+     * Specifies the maximum number of nodes visited by the ranked search, or
+     * of permutations tested by the other fragmented searches, or `0` if
+     * there is no limit.
+     */
+    uint64_t nodeLimit;
+
+    /**
+     * Specifies the maximum number of seconds spent by the fragmented
+     * searches, or `0` if there is no limit.
+     */
+    double timeLimit;
+
+    /** `true` to print the search plan instead of searching. */
+    bool explain;
+
+    /**
+     * A pointer to a zero-terminated string containing the path of the file
+     * to which the permutation search saves its progress, or `NULL` if its
+     * progress is not saved.
+     */
+    const char* checkpoint;
+
+    /** `true` to resume the permutation search from its checkpoint file. */
+    bool resume;
+
+    /**
+     * A pointer to a zero-terminated string containing the path of the file to
+     * which a recovered file is written, or `NULL` to recover the file in
+     * place.
+     */
+    const char* output;
+
+    /** The performance counters of the run, or `NULL` if none are kept. */
+    Stats* stats;
+
+    /** The timeline of the run, or `NULL` if none is recorded. */
+    Trace* trace;
+
+    /**
+     * The progress and budget of the fragmented searches that match a digest,
+     * or `NULL` if they are unbounded and silent.
+     */
+    SearchProgress* progress;
+};
+
+/** Represents the tunable settings shared by the file-system utilities. */
+typedef struct Settings Settings;
+
+#endif
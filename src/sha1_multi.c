@@ -0,0 +1,219 @@
+// sha1_multi.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - FIPS 180-4 Secure Hash Standard (SHS)
+//  - https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html
+//  - https://gcc.gnu.org/onlinedocs/gcc/Function-Specific-Option-Pragmas.html
+//  - https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+
+#include <string.h>
+#include "sha1_multi.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SHA1_MULTI_X86
+#endif
+
+#define SHA1_MULTI_BLOCK 64
+
+// Without SIMD intrinsics, each vector is an array of words. With GCC, the
+// array is a generic vector that the compiler lowers to the baseline
+// instruction set; otherwise, each operation is a loop over the lanes.
+
+#ifdef __GNUC__
+typedef uint32_t Sha1MultiWords
+    __attribute__ ((vector_size(SHA1_MULTI_LANES * sizeof(uint32_t))));
+
+#define sha1_multi_words_get(x, lane) ((x)[lane])
+#define sha1_multi_words_add(x, y) ((x) + (y))
+#define sha1_multi_words_and(x, y) ((x) & (y))
+#define sha1_multi_words_or(x, y) ((x) | (y))
+#define sha1_multi_words_xor(x, y) ((x) ^ (y))
+#define sha1_multi_words_rol(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define sha1_multi_words_set1(x) ((Sha1MultiWords){ 0 } + (x))
+#else
+typedef struct
+{
+    uint32_t lanes[SHA1_MULTI_LANES];
+} Sha1MultiWords;
+
+#define SHA1_MULTI_WORDS_OPERATION(name, operator) \
+    static Sha1MultiWords sha1_multi_words_##name( \
+        Sha1MultiWords x, \
+        Sha1MultiWords y) \
+    { \
+        for (int i = 0; i < SHA1_MULTI_LANES; i++) \
+        { \
+            x.lanes[i] operator y.lanes[i]; \
+        } \
+        \
+        return x; \
+    }
+
+SHA1_MULTI_WORDS_OPERATION(add, +=)
+SHA1_MULTI_WORDS_OPERATION(and, &=)
+SHA1_MULTI_WORDS_OPERATION(or, |=)
+SHA1_MULTI_WORDS_OPERATION(xor, ^=)
+
+static Sha1MultiWords sha1_multi_words_set1(uint32_t value)
+{
+    Sha1MultiWords result;
+
+    for (int i = 0; i < SHA1_MULTI_LANES; i++)
+    {
+        result.lanes[i] = value;
+    }
+
+    return result;
+}
+
+static Sha1MultiWords sha1_multi_words_rol(Sha1MultiWords x, int n)
+{
+    for (int i = 0; i < SHA1_MULTI_LANES; i++)
+    {
+        x.lanes[i] = (x.lanes[i] << n) | (x.lanes[i] >> (32 - n));
+    }
+
+    return x;
+}
+
+#define sha1_multi_words_get(x, lane) ((x).lanes[lane])
+#endif
+
+static void sha1_multi_portable_schedule(
+    Sha1MultiWords w[16],
+    const uint8_t* const data[],
+    uint64_t offset)
+{
+    for (int t = 0; t < 16; t++)
+    {
+        for (int lane = 0; lane < SHA1_MULTI_LANES; lane++)
+        {
+            const uint8_t* word = data[lane] + offset + t * 4;
+
+            sha1_multi_words_get(w[t], lane) = ((uint32_t)word[0] << 24) |
+                ((uint32_t)word[1] << 16) | ((uint32_t)word[2] << 8) | word[3];
+        }
+    }
+}
+
+#define SHA1_MULTI_KERNEL(name) sha1_multi_portable_##name
+#define SHA1_MULTI_KERNEL_LANES SHA1_MULTI_LANES
+#define Sha1MultiVector Sha1MultiWords
+#define sha1_multi_schedule sha1_multi_portable_schedule
+#define sha1_multi_set1(x) sha1_multi_words_set1(x)
+#define sha1_multi_add(x, y) sha1_multi_words_add(x, y)
+#define sha1_multi_and(x, y) sha1_multi_words_and(x, y)
+#define sha1_multi_or(x, y) sha1_multi_words_or(x, y)
+#define sha1_multi_xor(x, y) sha1_multi_words_xor(x, y)
+#define sha1_multi_rol(x, n) sha1_multi_words_rol(x, n)
+#define sha1_multi_store(words, x) memcpy(words, &(x), sizeof (x))
+
+#include "sha1_multi_kernel.h"
+#undef SHA1_MULTI_KERNEL
+#undef SHA1_MULTI_KERNEL_LANES
+#undef Sha1MultiVector
+#undef sha1_multi_schedule
+#undef sha1_multi_set1
+#undef sha1_multi_add
+#undef sha1_multi_and
+#undef sha1_multi_or
+#undef sha1_multi_xor
+#undef sha1_multi_rol
+#undef sha1_multi_store
+
+#ifdef SHA1_MULTI_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#define SHA1_MULTI_KERNEL(name) sha1_multi_avx2_##name
+#define SHA1_MULTI_KERNEL_LANES 8
+#define Sha1MultiVector __m256i
+#define sha1_multi_schedule sha1_multi_avx2_schedule
+#define sha1_multi_set1(x) _mm256_set1_epi32(x)
+#define sha1_multi_add(x, y) _mm256_add_epi32(x, y)
+#define sha1_multi_and(x, y) _mm256_and_si256(x, y)
+#define sha1_multi_or(x, y) _mm256_or_si256(x, y)
+#define sha1_multi_xor(x, y) _mm256_xor_si256(x, y)
+#define sha1_multi_rol(x, n) \
+    _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define sha1_multi_store(words, x) _mm256_storeu_si256((__m256i*)(words), x)
+
+static void sha1_multi_avx2_schedule(
+    __m256i w[16],
+    const uint8_t* const data[],
+    uint64_t offset)
+{
+    const __m256i swap = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    // Each group of eight words is loaded from every lane and transposed so
+    // that one vector holds the same word of all eight lanes.
+
+    for (int q = 0; q < 2; q++)
+    {
+        __m256i r[8];
+
+        for (int lane = 0; lane < 8; lane++)
+        {
+            r[lane] = _mm256_loadu_si256(
+                (const __m256i*)(data[lane] + offset + q * 32));
+        }
+
+        __m256i t[8];
+
+        for (int i = 0; i < 4; i++)
+        {
+            t[i * 2] = _mm256_unpacklo_epi32(r[i * 2], r[i * 2 + 1]);
+            t[i * 2 + 1] = _mm256_unpackhi_epi32(r[i * 2], r[i * 2 + 1]);
+        }
+
+        __m256i u[8];
+
+        for (int i = 0; i < 2; i++)
+        {
+            u[i * 4] = _mm256_unpacklo_epi64(t[i * 4], t[i * 4 + 2]);
+            u[i * 4 + 1] = _mm256_unpackhi_epi64(t[i * 4], t[i * 4 + 2]);
+            u[i * 4 + 2] = _mm256_unpacklo_epi64(t[i * 4 + 1], t[i * 4 + 3]);
+            u[i * 4 + 3] = _mm256_unpackhi_epi64(t[i * 4 + 1], t[i * 4 + 3]);
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            __m256i low = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+            __m256i high = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+
+            w[q * 8 + i] = _mm256_shuffle_epi8(low, swap);
+            w[q * 8 + i + 4] = _mm256_shuffle_epi8(high, swap);
+        }
+    }
+}
+
+#include "sha1_multi_kernel.h"
+
+#pragma GCC pop_options
+
+#endif
+
+void sha1_multi_digest(
+    unsigned char digests[][SHA1_MULTI_DIGEST_LENGTH],
+    const uint32_t state[5],
+    uint64_t length,
+    const uint8_t* const data[],
+    uint32_t size,
+    uint32_t lanes)
+{
+#ifdef SHA1_MULTI_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        sha1_multi_avx2_digest(digests, state, length, data, size, lanes);
+
+        return;
+    }
+#endif
+
+    sha1_multi_portable_digest(digests, state, length, data, size, lanes);
+}
@@ -0,0 +1,39 @@
+// sha1_multi.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef SHA1_MULTI_H
+#define SHA1_MULTI_H
+#include <stdint.h>
+
+/** Specifies the SHA-1 hash digest length. */
+#define SHA1_MULTI_DIGEST_LENGTH 20
+
+/** Specifies the number of messages hashed in lockstep. */
+#define SHA1_MULTI_LANES 8
+
+/**
+ * Computes the SHA-1 digests of several messages that share a common prefix
+ * and whose suffixes all have the same length. The suffixes are hashed in
+ * lockstep, one message per SIMD lane, using AVX2 when the processor supports
+ * it.
+ *
+ * @param digests when this method returns, contains the digest of each
+ *                message. This argument is passed uninitialized.
+ * @param state   the SHA-1 intermediate hash value after the prefix.
+ * @param length  the length of the prefix in bytes. This value must be a
+ *                multiple of the 64-byte block size.
+ * @param data    a pointer to the suffix of each message.
+ * @param size    the length of each suffix in bytes.
+ * @param lanes   the number of messages, which must be between `1` and
+ *                `SHA1_MULTI_LANES`, inclusive.
+ */
+void sha1_multi_digest(
+    unsigned char digests[][SHA1_MULTI_DIGEST_LENGTH],
+    const uint32_t state[5],
+    uint64_t length,
+    const uint8_t* const data[],
+    uint32_t size,
+    uint32_t lanes);
+
+#endif
@@ -0,0 +1,170 @@
+// sha1_multi_kernel.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - FIPS 180-4 Secure Hash Standard (SHS)
+
+// This file is included by <sha1_multi.c> once per instruction set. Before
+// each inclusion, the includer defines:
+//  - `SHA1_MULTI_KERNEL(name)`, which decorates a function name;
+//  - `SHA1_MULTI_KERNEL_LANES`, the number of lanes per vector;
+//  - `Sha1MultiVector`, the vector type; and
+//  - the `sha1_multi_*` vector operations used below.
+
+static void SHA1_MULTI_KERNEL(compress)(
+    Sha1MultiVector state[5],
+    const uint8_t* const data[],
+    uint64_t offset)
+{
+    Sha1MultiVector w[16];
+
+    sha1_multi_schedule(w, data, offset);
+
+    Sha1MultiVector a = state[0];
+    Sha1MultiVector b = state[1];
+    Sha1MultiVector c = state[2];
+    Sha1MultiVector d = state[3];
+    Sha1MultiVector e = state[4];
+
+    for (int t = 0; t < 80; t++)
+    {
+        if (t >= 16)
+        {
+            Sha1MultiVector x = sha1_multi_xor(w[(t - 3) & 15], w[(t - 8) & 15]);
+
+            x = sha1_multi_xor(x, w[(t - 14) & 15]);
+            x = sha1_multi_xor(x, w[t & 15]);
+            w[t & 15] = sha1_multi_rol(x, 1);
+        }
+
+        Sha1MultiVector f;
+        uint32_t k;
+
+        if (t < 20)
+        {
+            f = sha1_multi_xor(d, sha1_multi_and(b, sha1_multi_xor(c, d)));
+            k = 0x5a827999;
+        }
+        else if (t < 40)
+        {
+            f = sha1_multi_xor(sha1_multi_xor(b, c), d);
+            k = 0x6ed9eba1;
+        }
+        else if (t < 60)
+        {
+            f = sha1_multi_or(
+                sha1_multi_and(b, c),
+                sha1_multi_and(d, sha1_multi_or(b, c)));
+            k = 0x8f1bbcdc;
+        }
+        else
+        {
+            f = sha1_multi_xor(sha1_multi_xor(b, c), d);
+            k = 0xca62c1d6;
+        }
+
+        Sha1MultiVector temp = sha1_multi_add(sha1_multi_rol(a, 5), f);
+
+        temp = sha1_multi_add(temp, e);
+        temp = sha1_multi_add(temp, sha1_multi_set1(k));
+        temp = sha1_multi_add(temp, w[t & 15]);
+        e = d;
+        d = c;
+        c = sha1_multi_rol(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] = sha1_multi_add(state[0], a);
+    state[1] = sha1_multi_add(state[1], b);
+    state[2] = sha1_multi_add(state[2], c);
+    state[3] = sha1_multi_add(state[3], d);
+    state[4] = sha1_multi_add(state[4], e);
+}
+
+static void SHA1_MULTI_KERNEL(digest)(
+    unsigned char digests[][SHA1_MULTI_DIGEST_LENGTH],
+    const uint32_t state[5],
+    uint64_t length,
+    const uint8_t* const data[],
+    uint32_t size,
+    uint32_t lanes)
+{
+    const uint8_t* lane[SHA1_MULTI_KERNEL_LANES];
+
+    // Unused lanes repeat the first message; their digests are discarded.
+
+    for (uint32_t i = 0; i < SHA1_MULTI_KERNEL_LANES; i++)
+    {
+        lane[i] = data[i < lanes ? i : 0];
+    }
+
+    Sha1MultiVector vectors[5];
+
+    for (int i = 0; i < 5; i++)
+    {
+        vectors[i] = sha1_multi_set1(state[i]);
+    }
+
+    uint32_t blocks = size / SHA1_MULTI_BLOCK;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        SHA1_MULTI_KERNEL(compress)(
+            vectors,
+            lane,
+            (uint64_t)block * SHA1_MULTI_BLOCK);
+    }
+
+    // From FIPS 180-4:
+    //   Append the bit "1" to the end of the message, followed by k zero bits
+    //   [...] Then append the 64-bit block that is equal to the number l
+    //   expressed using a binary representation.
+
+    uint32_t remainder = size % SHA1_MULTI_BLOCK;
+    uint32_t tailBlocks = remainder < SHA1_MULTI_BLOCK - 8 ? 1 : 2;
+    uint32_t tailSize = tailBlocks * SHA1_MULTI_BLOCK;
+    uint64_t bits = (length + size) * 8;
+    uint8_t tails[SHA1_MULTI_KERNEL_LANES][2 * SHA1_MULTI_BLOCK];
+
+    for (uint32_t i = 0; i < SHA1_MULTI_KERNEL_LANES; i++)
+    {
+        uint8_t* tail = tails[i];
+
+        memset(tail, 0, tailSize);
+        memcpy(tail, lane[i] + (uint64_t)blocks * SHA1_MULTI_BLOCK, remainder);
+
+        tail[remainder] = 0x80;
+
+        for (int j = 0; j < 8; j++)
+        {
+            tail[tailSize - 1 - j] = (uint8_t)(bits >> (8 * j));
+        }
+
+        lane[i] = tail;
+    }
+
+    for (uint32_t block = 0; block < tailBlocks; block++)
+    {
+        SHA1_MULTI_KERNEL(compress)(vectors, lane, block * SHA1_MULTI_BLOCK);
+    }
+
+    uint32_t words[5][SHA1_MULTI_KERNEL_LANES];
+
+    for (int i = 0; i < 5; i++)
+    {
+        sha1_multi_store(words[i], vectors[i]);
+    }
+
+    for (uint32_t i = 0; i < lanes; i++)
+    {
+        for (int j = 0; j < 5; j++)
+        {
+            digests[i][j * 4] = words[j][i] >> 24;
+            digests[i][j * 4 + 1] = words[j][i] >> 16;
+            digests[i][j * 4 + 2] = words[j][i] >> 8;
+            digests[i][j * 4 + 3] = words[j][i];
+        }
+    }
+}
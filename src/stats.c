@@ -0,0 +1,165 @@
+// stats.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man2/getrusage.2.html
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+//  - https://www.json.org/json-en.html
+
+#include <sys/resource.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static const char* STATS_PHASES[] =
+{
+    [STATS_PHASE_INDEX] = "index",
+    [STATS_PHASE_CANDIDATES] = "candidates",
+    [STATS_PHASE_SEARCH] = "search",
+    [STATS_PHASE_WRITE] = "write"
+};
+
+static double stats_seconds(clockid_t clock)
+{
+    struct timespec now;
+
+    if (clock_gettime(clock, &now) == -1)
+    {
+        return 0;
+    }
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void stats_sample(StatsSample* result)
+{
+    struct rusage usage;
+
+    result->wallTime = stats_seconds(CLOCK_MONOTONIC);
+    result->cpuTime = stats_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    result->minorFaults = 0;
+    result->majorFaults = 0;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        result->minorFaults = usage.ru_minflt;
+        result->majorFaults = usage.ru_majflt;
+    }
+}
+
+void stats(Stats* instance)
+{
+    memset(instance->phases, 0, sizeof instance->phases);
+    stats_sample(&instance->start);
+}
+
+void stats_begin(Stats* instance, StatsPhase phase)
+{
+    if (!instance)
+    {
+        return;
+    }
+
+    instance->phases[phase].calls++;
+
+    stats_sample(&instance->phases[phase].start);
+}
+
+void stats_end(Stats* instance, StatsPhase phase)
+{
+    if (!instance)
+    {
+        return;
+    }
+
+    StatsTotals* totals = instance->phases + phase;
+    StatsSample now;
+
+    stats_sample(&now);
+
+    totals->used.wallTime += now.wallTime - totals->start.wallTime;
+    totals->used.cpuTime += now.cpuTime - totals->start.cpuTime;
+    totals->used.minorFaults += now.minorFaults - totals->start.minorFaults;
+    totals->used.majorFaults += now.majorFaults - totals->start.majorFaults;
+}
+
+static void stats_counters_add(
+    StatsCounters* instance,
+    const StatsCounters* counters)
+{
+    instance->entries += counters->entries;
+    instance->clusters += counters->clusters;
+    instance->bytes += counters->bytes;
+    instance->permutations += counters->permutations;
+}
+
+void stats_add(
+    Stats* instance,
+    StatsPhase phase,
+    const StatsCounters* counters)
+{
+    if (!instance)
+    {
+        return;
+    }
+
+    stats_counters_add(&instance->phases[phase].counters, counters);
+}
+
+static void stats_write_json_object(
+    FILE* output,
+    const StatsCounters* counters,
+    const StatsSample* used)
+{
+    fprintf(output,
+        "{\"entries\":%llu,\"clusters\":%llu,\"bytes\":%llu,"
+        "\"permutations\":%llu,\"wall_seconds\":%.6f,\"cpu_seconds\":%.6f,"
+        "\"minor_faults\":%llu,\"major_faults\":%llu",
+        (unsigned long long)counters->entries,
+        (unsigned long long)counters->clusters,
+        (unsigned long long)counters->bytes,
+        (unsigned long long)counters->permutations,
+        used->wallTime,
+        used->cpuTime,
+        (unsigned long long)used->minorFaults,
+        (unsigned long long)used->majorFaults);
+}
+
+bool stats_write_json(Stats* instance, FILE* output)
+{
+    StatsCounters counters = { 0 };
+    StatsSample now;
+
+    stats_sample(&now);
+    fputs("{\"phases\":{", output);
+
+    for (int phase = 0; phase < STATS_PHASE_COUNT; phase++)
+    {
+        StatsTotals* totals = instance->phases + phase;
+
+        if (phase)
+        {
+            fputc(',', output);
+        }
+
+        fprintf(output, "\"%s\":", STATS_PHASES[phase]);
+        stats_write_json_object(output, &totals->counters, &totals->used);
+        fprintf(output, ",\"calls\":%llu}", (unsigned long long)totals->calls);
+        stats_counters_add(&counters, &totals->counters);
+    }
+
+    // The totals cover the whole run, including the time spent outside of any
+    // phase.
+
+    now.wallTime -= instance->start.wallTime;
+    now.cpuTime -= instance->start.cpuTime;
+    now.minorFaults -= instance->start.minorFaults;
+    now.majorFaults -= instance->start.majorFaults;
+
+    fputs("},\"total\":", output);
+    stats_write_json_object(output, &counters, &now);
+    fputs("}}\n", output);
+
+    return fflush(output) != EOF && !ferror(output);
+}
@@ -0,0 +1,156 @@
+// stats.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef STATS_H
+#define STATS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Specifies a phase of a run. */
+enum StatsPhase
+{
+    /** Walk the directory tree. */
+    STATS_PHASE_INDEX = 0,
+
+    /** Collect the free clusters or runs considered by a search. */
+    STATS_PHASE_CANDIDATES,
+
+    /** Hash the file, or search for its cluster chain. */
+    STATS_PHASE_SEARCH,
+
+    /** Write the file allocation tables and the recovered files. */
+    STATS_PHASE_WRITE,
+
+    /** The number of phases. */
+    STATS_PHASE_COUNT
+};
+
+/** Specifies a phase of a run. */
+typedef enum StatsPhase StatsPhase;
+
+/** Represents the work done during a phase. */
+struct StatsCounters
+{
+    /** Specifies the number of directory entries visited. */
+    uint64_t entries;
+
+    /** Specifies the number of clusters hashed. */
+    uint64_t clusters;
+
+    /** Specifies the number of bytes hashed. */
+    uint64_t bytes;
+
+    /** Specifies the number of complete cluster chains tested. */
+    uint64_t permutations;
+};
+
+/** Represents the work done during a phase. */
+typedef struct StatsCounters StatsCounters;
+
+/** Represents the resources used by the process at a point in time. */
+struct StatsSample
+{
+    /** Specifies the monotonic wall-clock time in seconds. */
+    double wallTime;
+
+    /** Specifies the processor time used by every thread in seconds. */
+    double cpuTime;
+
+    /** Specifies the number of page faults serviced without any I/O. */
+    uint64_t minorFaults;
+
+    /** Specifies the number of page faults that required I/O. */
+    uint64_t majorFaults;
+};
+
+/** Represents the resources used by the process at a point in time. */
+typedef struct StatsSample StatsSample;
+
+/** Represents the totals of one phase over every time it was entered. */
+struct StatsTotals
+{
+    /** Specifies the number of times the phase was entered. */
+    uint64_t calls;
+
+    /** The work done. */
+    StatsCounters counters;
+
+    /** The resources used, as differences between samples. */
+    StatsSample used;
+
+    /** The sample taken when the phase was last entered. */
+    StatsSample start;
+};
+
+/** Represents the totals of one phase over every time it was entered. */
+typedef struct StatsTotals StatsTotals;
+
+/**
+ * Represents the performance counters of a run, collected per phase. Phases
+ * are entered and left on the calling thread and do not nest; the counters of
+ * worker threads are added once the workers are joined.
+ */
+struct Stats
+{
+    /** The totals of each phase. */
+    StatsTotals phases[STATS_PHASE_COUNT];
+
+    /** The sample taken when the run began. */
+    StatsSample start;
+};
+
+/** Represents the performance counters of a run, collected per phase. */
+typedef struct Stats Stats;
+
+/**
+ * Initializes an instance of the `Stats` struct and takes the sample that
+ * marks the beginning of the run.
+ *
+ * @param instance the `Stats` instance.
+ */
+void stats(Stats* instance);
+
+/**
+ * Enters a phase. This method does nothing if `instance` is `NULL`.
+ *
+ * @param instance the `Stats` instance, or `NULL`.
+ * @param phase    the phase.
+ */
+void stats_begin(Stats* instance, StatsPhase phase);
+
+/**
+ * Leaves a phase and adds the resources used since it was entered. This
+ * method does nothing if `instance` is `NULL`.
+ *
+ * @param instance the `Stats` instance, or `NULL`.
+ * @param phase    the phase.
+ */
+void stats_end(Stats* instance, StatsPhase phase);
+
+/**
+ * Adds to the counters of a phase. This method does nothing if `instance` is
+ * `NULL`.
+ *
+ * @param instance the `Stats` instance, or `NULL`.
+ * @param phase    the phase.
+ * @param counters the work to add.
+ */
+void stats_add(
+    Stats* instance,
+    StatsPhase phase,
+    const StatsCounters* counters);
+
+/**
+ * Writes the counters of every phase, and the totals of the run so far, as a
+ * JSON object.
+ *
+ * @param instance the `Stats` instance.
+ * @param output   the output stream.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool stats_write_json(Stats* instance, FILE* output);
+
+#endif
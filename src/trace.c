@@ -0,0 +1,156 @@
+// trace.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+//  - https://en.cppreference.com/w/c/language/storage_duration
+//  - https://www.man7.org/linux/man-pages/man3/clock_gettime.3.html
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "trace.h"
+
+static _Thread_local uint32_t traceThread;
+
+static double trace_clock(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+bool trace(Trace* instance)
+{
+    instance->overflow = false;
+    instance->count = 0;
+    instance->capacity = 0;
+    instance->events = NULL;
+    instance->origin = trace_clock();
+
+    atomic_init(&instance->threads, 0);
+
+    int error = pthread_mutex_init(&instance->mutex, NULL);
+
+    if (error)
+    {
+        errno = error;
+
+        return false;
+    }
+
+    return true;
+}
+
+double trace_now(Trace* instance)
+{
+    if (!instance)
+    {
+        return 0;
+    }
+
+    return trace_clock() - instance->origin;
+}
+
+void trace_span(Trace* instance, const char* name, double start)
+{
+    if (!instance)
+    {
+        return;
+    }
+
+    double end = trace_now(instance);
+
+    // Threads are numbered on their first event rather than by their system
+    // identifiers, which are not exposed by POSIX.
+
+    if (!traceThread)
+    {
+        traceThread = atomic_fetch_add(&instance->threads, 1) + 1;
+    }
+
+    pthread_mutex_lock(&instance->mutex);
+
+    if (instance->count == instance->capacity)
+    {
+        uint32_t capacity = instance->capacity ? instance->capacity * 2 : 256;
+        TraceEvent* events = realloc(
+            instance->events,
+            capacity * sizeof * events);
+
+        if (!events)
+        {
+            instance->overflow = true;
+
+            pthread_mutex_unlock(&instance->mutex);
+
+            return;
+        }
+
+        instance->events = events;
+        instance->capacity = capacity;
+    }
+
+    TraceEvent* event = instance->events + instance->count;
+
+    event->name = name;
+    event->thread = traceThread;
+    event->start = start;
+    event->duration = end - start;
+    instance->count++;
+
+    pthread_mutex_unlock(&instance->mutex);
+}
+
+bool trace_write(Trace* instance, const char* path)
+{
+    FILE* output = fopen(path, "w");
+
+    if (!output)
+    {
+        return false;
+    }
+
+    fputs("{\"traceEvents\":[", output);
+
+    for (uint32_t i = 0; i < instance->count; i++)
+    {
+        TraceEvent* event = instance->events + i;
+
+        fprintf(output,
+            "%s\n{\"name\":\"%s\",\"cat\":\"nyufile\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+            i ? "," : "",
+            event->name,
+            event->start,
+            event->duration,
+            event->thread);
+    }
+
+    fprintf(output,
+        "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%s}}\n",
+        instance->overflow ? "true" : "false");
+
+    bool result = !ferror(output);
+
+    if (fclose(output) == EOF)
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+void finalize_trace(Trace* instance)
+{
+    pthread_mutex_destroy(&instance->mutex);
+    free(instance->events);
+
+    instance->count = 0;
+    instance->capacity = 0;
+    instance->events = NULL;
+}
@@ -0,0 +1,112 @@
+// trace.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Represents a span of time spent by a thread in a named region. */
+struct TraceEvent
+{
+    /** The name of the region, a string with static storage duration. */
+    const char* name;
+
+    /** Specifies the thread, numbered from `1` in order of its first event. */
+    uint32_t thread;
+
+    /** Specifies the time at which the region was entered in microseconds. */
+    double start;
+
+    /** Specifies the time spent in the region in microseconds. */
+    double duration;
+};
+
+/** Represents a span of time spent by a thread in a named region. */
+typedef struct TraceEvent TraceEvent;
+
+/**
+ * Represents a timeline of the regions entered by every thread, written in the
+ * Chrome trace event format. Each region is recorded as one complete event
+ * when it is left. Every method accepts `NULL` and then does nothing, so that
+ * a disabled trace costs one predictable branch per region.
+ */
+struct Trace
+{
+    /** `true` if an event was dropped for lack of memory. */
+    bool overflow;
+
+    /** Specifies the number of events. */
+    uint32_t count;
+
+    /** Specifies the number of events for which there is room. */
+    uint32_t capacity;
+
+    /** Specifies the number of threads seen so far. */
+    atomic_uint threads;
+
+    /** Specifies the time at which the trace began in microseconds. */
+    double origin;
+
+    /** Specifies the events. */
+    TraceEvent* events;
+
+    /** The mutex that guards the events. */
+    pthread_mutex_t mutex;
+};
+
+/** Represents a timeline of the regions entered by every thread. */
+typedef struct Trace Trace;
+
+/**
+ * Initializes an instance of the `Trace` struct.
+ *
+ * @param instance the `Trace` instance.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool trace(Trace* instance);
+
+/**
+ * Gets the current time, to be passed to `trace_span` when the region is left.
+ *
+ * @param instance the `Trace` instance, or `NULL`.
+ * @return The time in microseconds since the trace began, or `0` if
+ *         `instance` is `NULL`.
+ */
+double trace_now(Trace* instance);
+
+/**
+ * Records a region entered by the calling thread at the given time and left
+ * now.
+ *
+ * @param instance the `Trace` instance, or `NULL`.
+ * @param name     the name of the region, a string with static storage
+ *                 duration.
+ * @param start    the time returned by `trace_now` when the region was
+ *                 entered.
+ */
+void trace_span(Trace* instance, const char* name, double start);
+
+/**
+ * Writes the events to a file in the Chrome trace event format.
+ *
+ * @param instance the `Trace` instance.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the file.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool trace_write(Trace* instance, const char* path);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `Trace` instance.
+ */
+void finalize_trace(Trace* instance);
+
+#endif
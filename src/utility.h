@@ -5,7 +5,9 @@
 #include <openssl/sha.h>
 #include <stdio.h>
 #include "fat32_boot_sector.h"
+#include "settings.h"
 #include "volume.h"
+#include "volume_index.h"
 #ifdef __GNUC__
 #define UTILITY_UNUSED __attribute__ ((unused))
 #else
@@ -17,73 +19,273 @@ typedef void (*Utility)(
     FILE* output, 
     Volume* volume, 
     const char* recover, 
-    unsigned char sha1[SHA_DIGEST_LENGTH]);
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+/**
+ * Applies a patch file exported by a recovery in private mode. The patch is
+ * staged as changes to the disk image and committed with them as one
+ * journaled transaction.
+ *
+ * @param output   the output stream.
+ * @param volume   the FAT32 disk image.
+ * @param recover  a pointer to a zero-terminated string containing the path
+ *                 of the patch file.
+ * @param sha1     unused.
+ * @param settings unused.
+ */
+void apply_utility(
+    FILE* output,
+    Volume* volume,
+    const char* recover,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
 
 /**
  * Prints the file system information.
  *
- * @param output  the output stream.
- * @param volume  the FAT32 disk image.
- * @param recover unused.
- * @param sha1    unused.
+ * @param output   the output stream.
+ * @param volume   the FAT32 disk image.
+ * @param recover  unused.
+ * @param sha1     unused.
+ * @param settings unused.
  */
 void information_utility(
     FILE* output,
     Volume* volume,
     const char* recover,
-    unsigned char sha1[SHA_DIGEST_LENGTH]);
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
 
 /**
  * Lists the entries in the root directory.
  *
- * @param output  the output stream.
- * @param volume  the FAT32 disk image.
- * @param recover unused.
- * @param sha1    unused.
+ * @param output   the output stream.
+ * @param volume   the FAT32 disk image.
+ * @param recover  unused.
+ * @param sha1     unused.
+ * @param settings unused.
  */
 void list_utility(
     FILE* output,
     Volume* volume,
     const char* recover,
-    unsigned char sha1[SHA_DIGEST_LENGTH]);
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
 
 /**
- * 
- * @param bootSector
- * @param firstCluster
- * @param clusters
+ * Initializes an instance of the `VolumeIndex` struct for the recovery
+ * utilities and counts the walk in the index phase of the run.
+ *
+ * @param index    the `VolumeIndex` instance.
+ * @param volume   the FAT32 disk image.
+ * @param settings the settings that give the number of threads and the
+ *                 performance counters.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool recover_index(
+    VolumeIndex* index,
+    Volume* volume,
+    const Settings* settings);
+
+/**
+ * Counts the work of testing the digest of the file at the current directory
+ * entry, read as if it were stored contiguously.
+ *
+ * @param counters the counters to which the work is added.
+ * @param iterator an iterator pointing to the directory entry of the file.
+ */
+void recover_count(StatsCounters* counters, VolumeRootIterator* iterator);
+
+/**
+ * Links consecutive clusters into a chain in every file allocation table.
+ *
+ * @param volume       the FAT32 disk image.
+ * @param firstCluster the first cluster of the chain.
+ * @param clusters     the number of clusters in the chain.
  */
 void recover_contiguous(
-    Fat32BootSector* bootSector, 
-    uint32_t firstCluster, 
+    Volume* volume,
+    uint32_t firstCluster,
     uint32_t clusters);
 
+/**
+ * Recovers the contiguous file at the current directory entry by restoring the
+ * first character of its name and its cluster chain or, if an output file is
+ * given, by copying its data to the output file.
+ *
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param recover  a pointer to a zero-terminated string containing the name
+ *                 of the file to recover.
+ * @param settings the settings that give the output file, if any.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool recover_contiguous_entry(
+    VolumeRootIterator* iterator,
+    const char* recover,
+    const Settings* settings);
+
+/**
+ * Searches for the cluster chain of the fragmented file at the current
+ * directory entry and, if a match is found, recovers the file or, if an output
+ * file is given, copies its data to the output file.
+ *
+ * @param iterator an iterator pointing to the directory entry of the file.
+ * @param index    the index of the deleted files and directories.
+ * @param recover  a pointer to a zero-terminated string containing the name
+ *                 of the file to recover.
+ * @param sha1     the SHA1 hash digest of the file.
+ * @param settings the search settings.
+ * @return `VOLUME_FIND_RESULT_SHA1_FOUND` if the file was recovered,
+ *         `VOLUME_FIND_RESULT_WRITE_FAILED` if the output file could not be
+ *         written, or `VOLUME_FIND_RESULT_NOT_FOUND` if there is no match.
+ */
+VolumeFindResult recover_fragmented_entry(
+    VolumeRootIterator* iterator,
+    const VolumeIndex* index,
+    const char* recover,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+/**
+ * Recovers the single deleted file with the given path, stored contiguously,
+ * whose SHA1 hash digest matches the given digest, if any.
+ *
+ * @param index    the index of the deleted files.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the file to recover.
+ * @param sha1     the SHA1 hash digest of the file, or `NULL`.
+ * @param settings the settings that give the output file, if any.
+ * @return `VOLUME_FIND_RESULT_NAME_FOUND` or `VOLUME_FIND_RESULT_SHA1_FOUND`
+ *         if the file was recovered, `VOLUME_FIND_RESULT_MULTIPLE_FOUND` if
+ *         there are multiple matches, `VOLUME_FIND_RESULT_WRITE_FAILED` if the
+ *         output file could not be written, or `VOLUME_FIND_RESULT_NOT_FOUND`
+ *         if there is no match.
+ */
+VolumeFindResult recover_contiguous_file(
+    VolumeIndex* index,
+    const char* path,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+/**
+ * Recovers the first deleted file with the given path whose SHA1 hash digest
+ * matches the given digest, either as stored contiguously or by searching for
+ * its fragments.
+ *
+ * @param index    the index of the deleted files.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the file to recover.
+ * @param sha1     the SHA1 hash digest of the file.
+ * @param settings the search settings.
+ * @return `VOLUME_FIND_RESULT_SHA1_FOUND` if the file was recovered,
+ *         `VOLUME_FIND_RESULT_WRITE_FAILED` if the output file could not be
+ *         written, or `VOLUME_FIND_RESULT_NOT_FOUND` if there is no match.
+ */
+VolumeFindResult recover_fragmented_file(
+    VolumeIndex* index,
+    const char* path,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+/**
+ * Estimates the work done by each strategy of the fragmented search for the
+ * first deleted file with the given path, and prints the plan instead of
+ * searching.
+ *
+ * @param output   the output stream.
+ * @param index    the index of the deleted files.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the file to recover.
+ * @param settings the search settings.
+ * @return `VOLUME_FIND_RESULT_NAME_FOUND` if the plan was printed,
+ *         `VOLUME_FIND_RESULT_WRITE_FAILED` if it could not be written, or
+ *         `VOLUME_FIND_RESULT_NOT_FOUND` if there is no such file.
+ */
+VolumeFindResult recover_explain_file(
+    FILE* output,
+    VolumeIndex* index,
+    const char* path,
+    const Settings* settings);
+
+/**
+ * Searches for the reconstructions of least cost of the first deleted file
+ * with the given path, whose digest is unknown, and writes each to a numbered
+ * output file, reporting its cost and digest.
+ *
+ * @param output   the output stream.
+ * @param index    the index of the deleted files.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the file to recover.
+ * @param settings the search settings, which give the number of
+ *                 reconstructions, the limits of the search and the prefix of
+ *                 the output files.
+ * @return `VOLUME_FIND_RESULT_MULTIPLE_FOUND` if any reconstruction was
+ *         written, `VOLUME_FIND_RESULT_WRITE_FAILED` if an output file could
+ *         not be written, or `VOLUME_FIND_RESULT_NOT_FOUND` if there is no
+ *         reconstruction.
+ */
+VolumeFindResult recover_ranked_file(
+    FILE* output,
+    VolumeIndex* index,
+    const char* path,
+    const Settings* settings);
+
 /**
  * Recovers a contiguous file.
  *
- * @param output  the output stream.
- * @param volume  the FAT32 disk image.
- * @param recover a pointer to a zero-terminated string containing the name of
- *                the file to recover.
- * @param sha1    the SHA1 hash digest of the file, or `NULL`.
+ * @param output   the output stream.
+ * @param volume   the FAT32 disk image.
+ * @param recover  a pointer to a zero-terminated string containing the path
+ *                 of the file to recover.
+ * @param sha1     the SHA1 hash digest of the file, or `NULL`.
+ * @param settings the settings that give the number of threads.
  */
 void recover_contiguous_utility(
     FILE* output,
     Volume* volume,
     const char* recover,
-    unsigned char sha1[SHA_DIGEST_LENGTH]);
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
 
 /**
- * Recovers a fragmented (non-contiguous) file.
+ * Recovers a fragmented (non-contiguous) file or, if its digest is unknown,
+ * writes its likeliest reconstructions to numbered output files. Given
+ * `settings->explain`, prints the search plan instead.
  *
- * @param output  the output stream.
- * @param volume  the FAT32 disk image.
- * @param recover a pointer to a zero-terminated string containing the name of
- *                the file to recover.
- * @param sha1    the SHA1 hash digest of the file.
+ * @param output   the output stream.
+ * @param volume   the FAT32 disk image.
+ * @param recover  a pointer to a zero-terminated string containing the path
+ *                 of the file to recover.
+ * @param sha1     the SHA1 hash digest of the file, or `NULL`.
+ * @param settings the search settings.
  */
 void recover_fragmented_utility(
     FILE* output,
     Volume* volume,
     const char* recover,
-    unsigned char sha1[SHA_DIGEST_LENGTH]);
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
+
+/**
+ * Recovers every file listed in a manifest. Each line of the manifest holds a
+ * file path followed, in any order, by its optional SHA1 hash digest and by
+ * either `contiguous` (the default) or `fragmented`, which requires a digest.
+ * Blank lines and lines that begin with `#` are ignored. The deleted files are
+ * indexed once and every line is resolved against the index.
+ *
+ * @param output   the output stream.
+ * @param volume   the FAT32 disk image.
+ * @param recover  a pointer to a zero-terminated string containing the path
+ *                 to the manifest.
+ * @param sha1     unused.
+ * @param settings the search settings, used for fragmented files.
+ */
+void manifest_utility(
+    FILE* output,
+    Volume* volume,
+    const char* recover,
+    unsigned char sha1[SHA_DIGEST_LENGTH],
+    const Settings* settings);
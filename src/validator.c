@@ -0,0 +1,807 @@
+// validator.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.w3.org/TR/png-3/#5Chunk-layout
+//  - https://www.w3.org/TR/png-3/#D-CRCAppendix
+//  - https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+//  - https://www.w3.org/Graphics/JPEG/itu-t81.pdf
+//  - https://opensource.adobe.com/dc-acrobat-sdk-docs/pdfstandards/PDF32000_2008.pdf
+//  - https://www.man7.org/linux/man-pages/man3/pthread_once.3p.html
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include "validator.h"
+
+/** Specifies a state of the PNG parser. */
+enum ValidatorPngPhase
+{
+    /** Read the eight-byte signature. */
+    VALIDATOR_PNG_PHASE_SIGNATURE = 0,
+
+    /** Read the length and type of a chunk. */
+    VALIDATOR_PNG_PHASE_HEADER,
+
+    /** Read the data of a chunk. */
+    VALIDATOR_PNG_PHASE_DATA,
+
+    /** Read the CRC of a chunk. */
+    VALIDATOR_PNG_PHASE_CRC
+};
+
+/** Specifies a state of the ZIP parser. */
+enum ValidatorZipPhase
+{
+    /** Read the signature of a record. */
+    VALIDATOR_ZIP_PHASE_SIGNATURE = 0,
+
+    /** Read the fixed-size part of a record. */
+    VALIDATOR_ZIP_PHASE_HEADER,
+
+    /** Skip the variable-size part of a record. */
+    VALIDATOR_ZIP_PHASE_DATA
+};
+
+/** Specifies a state of the JPEG parser. */
+enum ValidatorJpegPhase
+{
+    /** Read the `0xff` that begins a marker. */
+    VALIDATOR_JPEG_PHASE_PREFIX = 0,
+
+    /** Read the code of a marker, skipping any fill bytes. */
+    VALIDATOR_JPEG_PHASE_MARKER,
+
+    /** Read the length of a marker segment. */
+    VALIDATOR_JPEG_PHASE_LENGTH,
+
+    /** Skip the payload of a marker segment. */
+    VALIDATOR_JPEG_PHASE_DATA,
+
+    /** Scan the entropy-coded data of a scan for its next `0xff`. */
+    VALIDATOR_JPEG_PHASE_ENTROPY,
+
+    /** Read the byte after a `0xff` in entropy-coded data. */
+    VALIDATOR_JPEG_PHASE_ENTROPY_PREFIX
+};
+
+static const uint8_t VALIDATOR_PNG_SIGNATURE[] =
+{
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+};
+
+static pthread_once_t validatorCrcOnce = PTHREAD_ONCE_INIT;
+static uint32_t validatorCrcTable[256];
+
+static void validator_crc_initialize(void)
+{
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+
+        for (int k = 0; k < 8; k++)
+        {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+
+        validatorCrcTable[n] = c;
+    }
+}
+
+static uint32_t validator_crc(uint32_t crc, const uint8_t* data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc = validatorCrcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static uint32_t validator_be16(const uint8_t* data)
+{
+    return (uint32_t)data[0] << 8 | data[1];
+}
+
+static uint32_t validator_be32(const uint8_t* data)
+{
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+        (uint32_t)data[2] << 8 | data[3];
+}
+
+static uint32_t validator_le16(const uint8_t* data)
+{
+    return data[0] | (uint32_t)data[1] << 8;
+}
+
+static uint32_t validator_le32(const uint8_t* data)
+{
+    return validator_le16(data) | validator_le16(data + 2) << 16;
+}
+
+static uint64_t validator_le64(const uint8_t* data)
+{
+    return validator_le32(data) | (uint64_t)validator_le32(data + 4) << 32;
+}
+
+static bool validator_collect(
+    Validator* instance,
+    const uint8_t** data,
+    uint32_t* size,
+    uint32_t length)
+{
+    uint32_t count = length - instance->headerLength;
+
+    if (count > *size)
+    {
+        count = *size;
+    }
+
+    memcpy(instance->header + instance->headerLength, *data, count);
+
+    instance->headerLength += count;
+    instance->offset += count;
+    *data += count;
+    *size -= count;
+
+    return instance->headerLength == length;
+}
+
+static uint32_t validator_skip(Validator* instance, uint32_t size)
+{
+    uint64_t remaining = instance->next - instance->offset;
+    uint32_t count = size;
+
+    if (remaining < count)
+    {
+        count = remaining;
+    }
+
+    instance->offset += count;
+
+    return count;
+}
+
+static bool validator_png_match(const uint8_t* data, uint32_t size)
+{
+    return size >= sizeof VALIDATOR_PNG_SIGNATURE &&
+        memcmp(data, VALIDATOR_PNG_SIGNATURE, sizeof VALIDATOR_PNG_SIGNATURE)
+            == 0;
+}
+
+static bool validator_png_type(const uint8_t type[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t c = type[i] | 0x20;
+
+        if (c < 'a' || c > 'z')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void validator_png_update(
+    Validator* instance,
+    const uint8_t* data,
+    uint32_t size)
+{
+    // Each chunk is a 4-byte length, a 4-byte type, the data and a CRC-32 of
+    // the type and the data. The CRC is carried across clusters, so that a
+    // chunk is checked as soon as its last byte is read.
+
+    while (size && instance->valid && !instance->done)
+    {
+        switch (instance->phase)
+        {
+        case VALIDATOR_PNG_PHASE_SIGNATURE:
+            if (!validator_collect(instance, &data, &size, 8))
+            {
+                break;
+            }
+
+            instance->valid = validator_png_match(instance->header, 8);
+            instance->headerLength = 0;
+            instance->phase = VALIDATOR_PNG_PHASE_HEADER;
+            break;
+
+        case VALIDATOR_PNG_PHASE_HEADER:
+            if (!validator_collect(instance, &data, &size, 8))
+            {
+                break;
+            }
+
+            uint32_t length = validator_be32(instance->header);
+
+            if (length > 0x7fffffff ||
+                !validator_png_type(instance->header + 4))
+            {
+                instance->valid = false;
+
+                break;
+            }
+
+            instance->crc = validator_crc(0xffffffff, instance->header + 4, 4);
+            instance->next = instance->offset + length;
+            instance->phase = VALIDATOR_PNG_PHASE_DATA;
+            break;
+
+        case VALIDATOR_PNG_PHASE_DATA:
+        {
+            uint32_t count = validator_skip(instance, size);
+
+            instance->crc = validator_crc(instance->crc, data, count);
+            data += count;
+            size -= count;
+        }
+            break;
+
+        case VALIDATOR_PNG_PHASE_CRC:
+            if (!validator_collect(instance, &data, &size, 12))
+            {
+                break;
+            }
+
+            if (validator_be32(instance->header + 8) != ~instance->crc)
+            {
+                instance->valid = false;
+
+                break;
+            }
+
+            // Data after the image trailer is ignored by decoders, so it is
+            // not validated.
+
+            instance->done = memcmp(instance->header + 4, "IEND", 4) == 0;
+            instance->headerLength = 0;
+            instance->phase = VALIDATOR_PNG_PHASE_HEADER;
+            break;
+        }
+
+        if (instance->phase == VALIDATOR_PNG_PHASE_DATA &&
+            instance->offset == instance->next)
+        {
+            instance->phase = VALIDATOR_PNG_PHASE_CRC;
+        }
+    }
+}
+
+static bool validator_png_final(const Validator* instance)
+{
+    return instance->done;
+}
+
+static bool validator_zip_match(const uint8_t* data, uint32_t size)
+{
+    return size >= 4 && memcmp(data, "PK\3\4", 4) == 0;
+}
+
+static uint32_t validator_zip_header(const uint8_t signature[4])
+{
+    if (signature[0] != 'P' || signature[1] != 'K')
+    {
+        return 0;
+    }
+
+    switch (validator_be16(signature + 2))
+    {
+    case 0x0304:
+        return 30;
+
+    case 0x0102:
+        return 46;
+
+    case 0x0505:
+        return 6;
+
+    case 0x0506:
+        return 22;
+
+    case 0x0606:
+        return 12;
+
+    case 0x0607:
+        return 20;
+    }
+
+    return 0;
+}
+
+static void validator_zip_record(Validator* instance)
+{
+    const uint8_t* header = instance->header;
+    uint64_t length = 0;
+
+    switch (validator_be16(header + 2))
+    {
+    case 0x0304:
+    {
+        // The sizes of an entry written with a data descriptor, or of a
+        // ZIP64 entry, are not known from its local header, so the records
+        // after it cannot be located.
+
+        uint32_t compressedSize = validator_le32(header + 18);
+
+        if (validator_le16(header + 6) & 0x8 || compressedSize == 0xffffffff)
+        {
+            instance->done = true;
+
+            return;
+        }
+
+        length = validator_le16(header + 26) + validator_le16(header + 28) +
+            compressedSize;
+    }
+        break;
+
+    case 0x0102:
+        length = validator_le16(header + 28) + validator_le16(header + 30) +
+            validator_le16(header + 32);
+        break;
+
+    case 0x0505:
+        length = validator_le16(header + 4);
+        break;
+
+    case 0x0506:
+        // The end of central directory record ends the archive.
+
+        instance->done = true;
+
+        return;
+
+    case 0x0606:
+        length = validator_le64(header + 4);
+
+        if (length < 44 || length > UINT64_MAX - instance->offset)
+        {
+            instance->valid = false;
+
+            return;
+        }
+        break;
+    }
+
+    instance->next = instance->offset + length;
+    instance->phase = VALIDATOR_ZIP_PHASE_DATA;
+}
+
+static void validator_zip_update(
+    Validator* instance,
+    const uint8_t* data,
+    uint32_t size)
+{
+    // Each record begins with a signature and a fixed-size header that gives
+    // the size of the rest of the record, so the signature of the next record
+    // is checked without reading the compressed data.
+
+    while (size && instance->valid && !instance->done)
+    {
+        switch (instance->phase)
+        {
+        case VALIDATOR_ZIP_PHASE_SIGNATURE:
+            if (!validator_collect(instance, &data, &size, 4))
+            {
+                break;
+            }
+
+            if (!validator_zip_header(instance->header))
+            {
+                instance->valid = false;
+
+                break;
+            }
+
+            instance->phase = VALIDATOR_ZIP_PHASE_HEADER;
+            break;
+
+        case VALIDATOR_ZIP_PHASE_HEADER:
+            if (validator_collect(
+                instance,
+                &data,
+                &size,
+                validator_zip_header(instance->header)))
+            {
+                validator_zip_record(instance);
+            }
+            break;
+
+        case VALIDATOR_ZIP_PHASE_DATA:
+        {
+            uint32_t count = validator_skip(instance, size);
+
+            data += count;
+            size -= count;
+        }
+            break;
+        }
+
+        if (instance->phase == VALIDATOR_ZIP_PHASE_DATA &&
+            instance->offset == instance->next)
+        {
+            instance->headerLength = 0;
+            instance->phase = VALIDATOR_ZIP_PHASE_SIGNATURE;
+        }
+    }
+}
+
+static bool validator_zip_final(const Validator* instance)
+{
+    return instance->done;
+}
+
+static bool validator_jpeg_match(const uint8_t* data, uint32_t size)
+{
+    return size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff;
+}
+
+static void validator_jpeg_marker(Validator* instance, uint8_t marker)
+{
+    // Only the codes from 0xc0 through 0xfe, and TEM (0x01), are assigned to
+    // markers; the others are reserved and never appear in a file.
+
+    if (marker == 0xff)
+    {
+        instance->phase = VALIDATOR_JPEG_PHASE_MARKER;
+    }
+    else if (marker == 0xd9)
+    {
+        instance->done = true;
+    }
+    else if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8))
+    {
+        instance->phase = VALIDATOR_JPEG_PHASE_PREFIX;
+    }
+    else if (marker >= 0xc0)
+    {
+        instance->header[0] = marker;
+        instance->headerLength = 1;
+        instance->phase = VALIDATOR_JPEG_PHASE_LENGTH;
+    }
+    else
+    {
+        instance->valid = false;
+    }
+}
+
+static void validator_jpeg_update(
+    Validator* instance,
+    const uint8_t* data,
+    uint32_t size)
+{
+    // Outside of a scan, the file is a sequence of markers, most of which
+    // begin a segment of known length. Inside a scan, every 0xff is followed
+    // by a stuffed zero, a restart marker, or the marker that ends the scan.
+
+    while (size && instance->valid && !instance->done)
+    {
+        switch (instance->phase)
+        {
+        case VALIDATOR_JPEG_PHASE_PREFIX:
+            if (*data != 0xff)
+            {
+                instance->valid = false;
+
+                break;
+            }
+
+            instance->phase = VALIDATOR_JPEG_PHASE_MARKER;
+            instance->offset++;
+            data++;
+            size--;
+            break;
+
+        case VALIDATOR_JPEG_PHASE_MARKER:
+        {
+            uint8_t marker = *data;
+
+            instance->offset++;
+            data++;
+            size--;
+
+            validator_jpeg_marker(instance, marker);
+        }
+            break;
+
+        case VALIDATOR_JPEG_PHASE_LENGTH:
+            if (!validator_collect(instance, &data, &size, 3))
+            {
+                break;
+            }
+
+            uint32_t length = validator_be16(instance->header + 1);
+
+            if (length < 2)
+            {
+                instance->valid = false;
+
+                break;
+            }
+
+            instance->next = instance->offset + length - 2;
+            instance->phase = VALIDATOR_JPEG_PHASE_DATA;
+            break;
+
+        case VALIDATOR_JPEG_PHASE_DATA:
+        {
+            uint32_t count = validator_skip(instance, size);
+
+            data += count;
+            size -= count;
+        }
+            break;
+
+        case VALIDATOR_JPEG_PHASE_ENTROPY:
+        {
+            const uint8_t* prefix = memchr(data, 0xff, size);
+            uint32_t count = size;
+
+            if (prefix)
+            {
+                count = prefix - data + 1;
+                instance->phase = VALIDATOR_JPEG_PHASE_ENTROPY_PREFIX;
+            }
+
+            instance->offset += count;
+            data += count;
+            size -= count;
+        }
+            break;
+
+        case VALIDATOR_JPEG_PHASE_ENTROPY_PREFIX:
+        {
+            uint8_t code = *data;
+
+            instance->offset++;
+            data++;
+            size--;
+
+            if (code == 0x00 || (code >= 0xd0 && code <= 0xd7))
+            {
+                instance->phase = VALIDATOR_JPEG_PHASE_ENTROPY;
+            }
+            else
+            {
+                validator_jpeg_marker(instance, code);
+            }
+        }
+            break;
+        }
+
+        if (instance->phase == VALIDATOR_JPEG_PHASE_DATA &&
+            instance->offset == instance->next)
+        {
+            // The entropy-coded data of a scan follows its header (SOS).
+
+            if (instance->header[0] == 0xda)
+            {
+                instance->phase = VALIDATOR_JPEG_PHASE_ENTROPY;
+            }
+            else
+            {
+                instance->phase = VALIDATOR_JPEG_PHASE_PREFIX;
+            }
+        }
+    }
+}
+
+static bool validator_jpeg_final(const Validator* instance)
+{
+    return instance->done;
+}
+
+static bool validator_pdf_match(const uint8_t* data, uint32_t size)
+{
+    return size >= 5 && memcmp(data, "%PDF-", 5) == 0;
+}
+
+static void validator_pdf_update(
+    Validator* instance,
+    const uint8_t* data,
+    uint32_t size)
+{
+    // The body of a PDF file may hold arbitrary binary streams, so only the
+    // trailer is checked, once the whole file is read.
+
+    if (size >= VALIDATOR_WINDOW)
+    {
+        memcpy(instance->window, data + size - VALIDATOR_WINDOW,
+            VALIDATOR_WINDOW);
+
+        instance->windowLength = VALIDATOR_WINDOW;
+    }
+    else
+    {
+        uint32_t keep = VALIDATOR_WINDOW - size;
+
+        if (keep > instance->windowLength)
+        {
+            keep = instance->windowLength;
+        }
+
+        memmove(
+            instance->window,
+            instance->window + instance->windowLength - keep,
+            keep);
+        memcpy(instance->window + keep, data, size);
+
+        instance->windowLength = keep + size;
+    }
+
+    instance->offset += size;
+}
+
+static const uint8_t* validator_find_last(
+    const uint8_t* data,
+    uint32_t size,
+    const char* value)
+{
+    uint32_t length = strlen(value);
+
+    for (uint32_t i = size; i >= length; i--)
+    {
+        if (memcmp(data + i - length, value, length) == 0)
+        {
+            return data + i - length;
+        }
+    }
+
+    return NULL;
+}
+
+static bool validator_pdf_final(const Validator* instance)
+{
+    // From ISO 32000-1:2008, 7.5.5:
+    //   The last line of the file shall contain only the end-of-file marker,
+    //   %%EOF. The two preceding lines shall contain, one per line and in
+    //   order, the keyword startxref and the byte offset in the decoded
+    //   stream from the beginning of the file to the beginning of the xref
+    //   keyword in the last cross-reference section.
+    //
+    // Readers look for the marker within the last 1024 bytes of the file.
+
+    const uint8_t* window = instance->window;
+    const uint8_t* end = validator_find_last(
+        window,
+        instance->windowLength,
+        "%%EOF");
+
+    if (!end)
+    {
+        return false;
+    }
+
+    const uint8_t* keyword = validator_find_last(
+        window,
+        end - window,
+        "startxref");
+
+    if (!keyword)
+    {
+        return true;
+    }
+
+    const uint8_t* p = keyword + 9;
+    uint64_t offset = 0;
+
+    while (p < end && (*p == ' ' || *p == '\r' || *p == '\n'))
+    {
+        p++;
+    }
+
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        offset = offset * 10 + *p - '0';
+
+        if (offset >= instance->offset)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static const ValidatorFormat VALIDATOR_FORMAT_PNG =
+{
+    .name = "png",
+    .match = validator_png_match,
+    .update = validator_png_update,
+    .final = validator_png_final
+};
+
+static const ValidatorFormat VALIDATOR_FORMAT_ZIP =
+{
+    .name = "zip",
+    .match = validator_zip_match,
+    .update = validator_zip_update,
+    .final = validator_zip_final
+};
+
+static const ValidatorFormat VALIDATOR_FORMAT_JPEG =
+{
+    .name = "jpeg",
+    .match = validator_jpeg_match,
+    .update = validator_jpeg_update,
+    .final = validator_jpeg_final
+};
+
+static const ValidatorFormat VALIDATOR_FORMAT_PDF =
+{
+    .name = "pdf",
+    .match = validator_pdf_match,
+    .update = validator_pdf_update,
+    .final = validator_pdf_final
+};
+
+const ValidatorFormat* const VALIDATOR_FORMATS[] =
+{
+    &VALIDATOR_FORMAT_PNG,
+    &VALIDATOR_FORMAT_ZIP,
+    &VALIDATOR_FORMAT_JPEG,
+    &VALIDATOR_FORMAT_PDF,
+    NULL
+};
+
+const ValidatorFormat* validator_format(const uint8_t* data, uint32_t size)
+{
+    pthread_once(&validatorCrcOnce, validator_crc_initialize);
+
+    for (const ValidatorFormat* const* p = VALIDATOR_FORMATS; *p; p++)
+    {
+        if ((*p)->match(data, size))
+        {
+            return *p;
+        }
+    }
+
+    return NULL;
+}
+
+void validator(Validator* instance, const ValidatorFormat* format)
+{
+    instance->format = format;
+    instance->valid = true;
+    instance->done = false;
+    instance->offset = 0;
+    instance->next = 0;
+    instance->phase = 0;
+    instance->crc = 0;
+    instance->headerLength = 0;
+    instance->windowLength = 0;
+}
+
+void validator_copy(Validator* instance, const Validator* source)
+{
+    // Only the part of the window in use is copied, since the window is most
+    // of the state and is unused by most formats.
+
+    memcpy(
+        instance,
+        source,
+        offsetof(Validator, window) + source->windowLength);
+}
+
+bool validator_update(Validator* instance, const uint8_t* data, uint32_t size)
+{
+    if (size && instance->valid && !instance->done)
+    {
+        instance->format->update(instance, data, size);
+    }
+
+    return instance->valid;
+}
+
+bool validator_final(const Validator* instance)
+{
+    return instance->valid && instance->format->final(instance);
+}
@@ -0,0 +1,154 @@
+// validator.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VALIDATOR_H
+#define VALIDATOR_H
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Specifies the size of the longest record header read by a validator. */
+#define VALIDATOR_HEADER 46
+
+/** Specifies the number of trailing bytes kept for the trailer of a file. */
+#define VALIDATOR_WINDOW 1024
+
+struct ValidatorFormat;
+
+/**
+ * Represents the state of an incremental validation. The state holds no
+ * pointers besides its format, so that it can be saved after each prefix of a
+ * file and copied with `validator_copy`.
+ */
+struct Validator
+{
+    /** The format of the file. */
+    const struct ValidatorFormat* format;
+
+    /** `false` once the data is known not to be a file of the format. */
+    bool valid;
+
+    /** `true` once the rest of the file can no longer be validated. */
+    bool done;
+
+    /** Specifies the number of bytes validated so far. */
+    uint64_t offset;
+
+    /** Specifies the offset of the next record. */
+    uint64_t next;
+
+    /** Specifies a format-specific parser state. */
+    uint32_t phase;
+
+    /** Specifies the running CRC-32 of the current record. */
+    uint32_t crc;
+
+    /** Specifies the number of bytes in `header`. */
+    uint32_t headerLength;
+
+    /** Specifies the number of bytes in `window`. */
+    uint32_t windowLength;
+
+    /** Specifies the bytes of the current record header read so far. */
+    uint8_t header[VALIDATOR_HEADER];
+
+    /** Specifies the last bytes validated, for formats with a trailer. */
+    uint8_t window[VALIDATOR_WINDOW];
+};
+
+/** Represents the state of an incremental validation. */
+typedef struct Validator Validator;
+
+/**
+ * Represents a file format whose internal structure can be checked as the
+ * file is reassembled one cluster at a time. A format rejects only data that
+ * no well-formed file of the format contains, so that pruning a reassembly it
+ * rejects never discards a well-formed file.
+ */
+struct ValidatorFormat
+{
+    /** The name of the format. */
+    const char* name;
+
+    /**
+     * Determines whether the first cluster of a file begins with the
+     * signature of the format.
+     *
+     * @param data the first cluster.
+     * @param size the number of bytes in `data`.
+     * @return `true` if the signature matches; otherwise, `false`.
+     */
+    bool (*match)(const uint8_t* data, uint32_t size);
+
+    /**
+     * Validates additional data. The data is never empty, and the instance is
+     * neither invalid nor done.
+     *
+     * @param instance the `Validator` instance.
+     * @param data     the data.
+     * @param size     the number of bytes in `data`.
+     */
+    void (*update)(Validator* instance, const uint8_t* data, uint32_t size);
+
+    /**
+     * Validates the end of the file.
+     *
+     * @param instance the `Validator` instance, after every byte of the file
+     *                 was validated.
+     * @return `true` if the file may be well-formed; otherwise, `false`.
+     */
+    bool (*final)(const Validator* instance);
+};
+
+/** Represents a file format whose internal structure can be checked. */
+typedef struct ValidatorFormat ValidatorFormat;
+
+/** Specifies every format, followed by `NULL`. */
+extern const ValidatorFormat* const VALIDATOR_FORMATS[];
+
+/**
+ * Gets the format of a file from its first cluster.
+ *
+ * @param data the first cluster.
+ * @param size the number of bytes in `data`.
+ * @return The format whose signature matches, or `NULL` if there is none.
+ */
+const ValidatorFormat* validator_format(const uint8_t* data, uint32_t size);
+
+/**
+ * Initializes an instance of the `Validator` struct.
+ *
+ * @param instance the `Validator` instance.
+ * @param format   the format of the file.
+ */
+void validator(Validator* instance, const ValidatorFormat* format);
+
+/**
+ * Copies the state of one `Validator` instance to another.
+ *
+ * @param instance the destination.
+ * @param source   the source.
+ */
+void validator_copy(Validator* instance, const Validator* source);
+
+/**
+ * Validates additional data.
+ *
+ * @param instance the `Validator` instance.
+ * @param data     the data.
+ * @param size     the number of bytes in `data`.
+ * @return `true` if the data validated so far may begin a well-formed file;
+ *         otherwise, `false`.
+ */
+bool validator_update(Validator* instance, const uint8_t* data, uint32_t size);
+
+/**
+ * Validates the end of the file.
+ *
+ * @param instance the `Validator` instance.
+ * @return `true` if the data validated may be a well-formed file; otherwise,
+ *         `false`.
+ */
+bool validator_final(const Validator* instance);
+
+#endif
@@ -8,31 +8,198 @@
 //  - https://www.man7.org/linux/man-pages/man2/mmap.2.html
 //  - https://www.man7.org/linux/man-pages/man2/open.2.html
 //  - https://www.man7.org/linux/man-pages/man3/stat.3type.html
-//  - https://docs.openssl.org/1.0.2/man3/sha
 //  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
 
 #include <openssl/sha.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "fat32_attributes.h"
 #include "fat32_boot_sector.h"
+#include "hash.h"
 #include "volume_root_iterator.h"
+#include "volume_transaction.h"
 
-// From specification:
-//   If(FATContent >= 0x0FFFFFF8)
-//        IsEOF = TRUE;
+static uint32_t volume_log2(uint32_t value)
+{
+    uint32_t result = 0;
 
-#define volume_is_eof(value) ((value) >= 0x0ffffff8)
+    while ((uint32_t)1 << result < value)
+    {
+        result++;
+    }
 
-bool volume(Volume* instance, const char* path)
+    return result;
+}
+
+static bool volume_geometry(VolumeGeometry* instance, Volume* volume)
 {
-    bool result = false;
-    int descriptor = open(path, O_RDWR);
+    Fat32BootSector* bootSector = volume->data;
+
+    if ((size_t)volume->size < sizeof * bootSector)
+    {
+        return false;
+    }
+
+    uint32_t bytesPerSector = bootSector->bytesPerSector;
+    uint32_t sectorsPerCluster = bootSector->sectorsPerCluster;
+
+    if (bytesPerSector < sizeof(Fat32DirectoryEntry) ||
+        bytesPerSector & (bytesPerSector - 1) ||
+        !sectorsPerCluster ||
+        sectorsPerCluster & (sectorsPerCluster - 1))
+    {
+        return false;
+    }
+
+    instance->sectorShift = volume_log2(bytesPerSector);
+    instance->clusterShift = instance->sectorShift +
+        volume_log2(sectorsPerCluster);
+    instance->bytesPerCluster = (uint32_t)1 << instance->clusterShift;
+    instance->clusterMask = instance->bytesPerCluster - 1;
+
+    // From specification:
+
+    //   RootDirSectors =
+    //     ((BPB_RootEntCnt * 32) + (BPB_BytsPerSec – 1)) / BPB_BytsPerSec;
+
+    uint32_t rootSectors = bootSector->rootEntries;
+
+    rootSectors *= sizeof(Fat32DirectoryEntry);
+    rootSectors += bytesPerSector - 1;
+    rootSectors >>= instance->sectorShift;
+
+    // From specification:
+
+    //   FirstDataSector =
+    //     BPB_ResvdSecCnt + (BPB_NumFATs * FATSz) + RootDirSectors;
+
+    uint32_t firstDataSector = bootSector->reservedSectors;
+
+    firstDataSector += bootSector->fats * bootSector->sectorsPerFat;
+    firstDataSector += rootSectors;
+    instance->firstDataSector = firstDataSector;
+
+    // From specification:
+    //   DataSec = TotSec – (BPB_ResvdSecCnt + (BPB_NumFATs * FATSz) +
+    //     RootDirSectors);
+    //   CountofClusters = DataSec / BPB_SecPerClus;
+
+    uint64_t totalSectors = (uint64_t)volume->size >> instance->sectorShift;
+
+    if (totalSectors > bootSector->totalSectors)
+    {
+        totalSectors = bootSector->totalSectors;
+    }
+
+    uint32_t clusterCount = 0;
+    uint32_t fatEntries = bootSector->sectorsPerFat;
+
+    fatEntries <<= instance->sectorShift;
+    fatEntries /= sizeof(uint32_t);
+
+    if (totalSectors > firstDataSector)
+    {
+        clusterCount = (totalSectors - firstDataSector) >>
+            (instance->clusterShift - instance->sectorShift);
+    }
+
+    if (fatEntries < 2)
+    {
+        clusterCount = 0;
+    }
+    else if (clusterCount > fatEntries - 2)
+    {
+        clusterCount = fatEntries - 2;
+    }
+
+    uint8_t* data = volume->data;
+
+    instance->clusterCount = clusterCount;
+    instance->fatCount = bootSector->fats;
+    instance->fatEntries = fatEntries;
+    instance->fat = (uint32_t*)(data +
+        ((size_t)bootSector->reservedSectors << instance->sectorShift));
+    instance->clusters = data +
+        ((size_t)firstDataSector << instance->sectorShift);
+
+    return true;
+}
+
+static bool volume_open_journal(Volume* instance, const char* path)
+{
+    size_t length = strlen(path);
+
+    instance->journal = malloc(length + sizeof VOLUME_JOURNAL_SUFFIX);
+
+    if (!instance->journal)
+    {
+        return false;
+    }
+
+    memcpy(instance->journal, path, length);
+    memcpy(
+        instance->journal + length,
+        VOLUME_JOURNAL_SUFFIX,
+        sizeof VOLUME_JOURNAL_SUFFIX);
+
+    // A journal left behind by an interrupted commit is rolled back before the
+    // disk image is mapped.
+
+    if (!volume_transaction_recover(instance))
+    {
+        free(instance->journal);
+
+        return false;
+    }
+
+    void* shared = mmap(
+        NULL,
+        instance->size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        instance->descriptor,
+        0);
+
+    if (shared == MAP_FAILED)
+    {
+        free(instance->journal);
+
+        return false;
+    }
+
+    instance->shared = shared;
+
+    return true;
+}
+
+bool volume(Volume* instance, const char* path, VolumeMode mode)
+{
+    int flags = O_RDONLY;
+    int protection = PROT_READ | PROT_WRITE;
+    int sharing = MAP_PRIVATE;
+
+    switch (mode)
+    {
+    case VOLUME_MODE_READ_ONLY:
+        protection = PROT_READ;
+        sharing = MAP_SHARED;
+        break;
+
+    case VOLUME_MODE_PRIVATE:
+        break;
+
+    default:
+        flags = O_RDWR;
+        break;
+    }
+
+    int descriptor = open(path, flags);
 
     if (descriptor == -1)
     {
@@ -46,28 +213,59 @@ bool volume(Volume* instance, const char* path)
         goto volume_exit_open;
     }
 
+    instance->size = status.st_size;
+    instance->descriptor = descriptor;
+    instance->mode = mode;
+    instance->shared = NULL;
+    instance->journal = NULL;
+    instance->rangeCount = 0;
+    instance->rangeCapacity = 0;
+    instance->overflow = false;
+    instance->ranges = NULL;
+
+    if (mode == VOLUME_MODE_READ_WRITE && !volume_open_journal(instance, path))
+    {
+        goto volume_exit_open;
+    }
+
     void* data = mmap(
         NULL,
         status.st_size,
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
+        protection,
+        sharing,
         descriptor,
         0);
 
     if (data == MAP_FAILED)
     {
-        goto volume_exit_open;
+        goto volume_exit_shared;
     }
 
-    instance->size = status.st_size;
     instance->data = data;
-    result = true;
+
+    if (!volume_geometry(&instance->geometry, instance))
+    {
+        munmap(data, status.st_size);
+
+        errno = EINVAL;
+
+        goto volume_exit_shared;
+    }
+
+    return true;
+
+volume_exit_shared:
+    if (instance->shared)
+    {
+        munmap(instance->shared, status.st_size);
+        free(instance->journal);
+    }
 
 volume_exit_open:
     close(descriptor);
 
 volume_exit:
-    return result;
+    return false;
 }
 
 void volume_display_name(char buffer[13], uint8_t name[11])
@@ -125,127 +323,78 @@ uint32_t volume_clusters(uint32_t fileSize, uint32_t bytesPerCluster)
     return (fileSize + bytesPerCluster - 1) / bytesPerCluster;
 }
 
-static void volume_root_reset_offset(VolumeRootIterator* iterator)
-{
-    Fat32BootSector* bootSector = iterator->instance->data;
-
-    // From specification:
-    //   FirstSectorofCluster = ((N – 2) * BPB_SecPerClus) + FirstDataSector;
-
-    uint32_t sector = (iterator->cluster - 2) * bootSector->sectorsPerCluster;
-
-    sector += iterator->firstDataSector;
-
-    uint8_t* data = iterator->instance->data;
-
-    data += sector * bootSector->bytesPerSector;
-    iterator->offset = 0;
-    iterator->data = data;
-}
-
 void volume_root_begin(VolumeRootIterator* iterator, Volume* instance)
 {
-    iterator->instance = instance;
-
     Fat32BootSector* bootSector = instance->data;
 
-    // From specification:
-
-    //   RootDirSectors =
-    //     ((BPB_RootEntCnt * 32) + (BPB_BytsPerSec – 1)) / BPB_BytsPerSec;
-
-    uint32_t rootSectors = bootSector->rootEntries;
-
-    rootSectors *= sizeof(Fat32DirectoryEntry);
-    rootSectors += bootSector->bytesPerSector - 1;
-    rootSectors /= bootSector->bytesPerSector;
-
-    // From specification:
-
-    //   FirstDataSector =
-    //     BPB_ResvdSecCnt + (BPB_NumFATs * FATSz) + RootDirSectors;
-
-    uint32_t firstDataSector = bootSector->reservedSectors;
-
-    firstDataSector += bootSector->fats * bootSector->sectorsPerFat;
-    firstDataSector += rootSectors;
-
-    uint32_t bytesPerCluster = bootSector->sectorsPerCluster;
-
-    bytesPerCluster *= bootSector->bytesPerSector;
+    iterator->instance = instance;
     iterator->cluster = bootSector->rootCluster;
-    iterator->firstDataSector = firstDataSector;
-    iterator->bytesPerCluster = bytesPerCluster;
+    iterator->bytesPerCluster = instance->geometry.bytesPerCluster;
+    iterator->end = !volume_is_cluster(instance, iterator->cluster);
 
-    volume_root_reset_offset(iterator);
+    if (iterator->end)
+    {
+        iterator->data = NULL;
+        iterator->entry = NULL;
 
-    iterator->entry = (Fat32DirectoryEntry*)(iterator->data + iterator->offset);
-    iterator->end = volume_is_eof(iterator->cluster);
+        return;
+    }
+
+    iterator->data = volume_cluster_data(instance, iterator->cluster);
+    iterator->entry = (Fat32DirectoryEntry*)iterator->data;
 }
 
 void volume_root_next(VolumeRootIterator* iterator)
 {
-    uint32_t step = sizeof(Fat32DirectoryEntry);
+    Fat32DirectoryEntry* next = iterator->entry + 1;
 
-    if (iterator->offset < iterator->bytesPerCluster - step)
+    if ((uint8_t*)next < iterator->data + iterator->bytesPerCluster)
     {
-        iterator->offset += step;
-
-        uint8_t* pointer = iterator->data + iterator->offset;
-
-        iterator->entry = (Fat32DirectoryEntry*)pointer;
-        iterator->end = false;
+        iterator->entry = next;
 
         return;
     }
 
-    if (volume_is_eof(iterator->cluster))
+    Volume* instance = iterator->instance;
+    uint32_t cluster = volume_next_cluster(instance, iterator->cluster);
+
+    // A chain that ends, or that leaves the data region because the table is
+    // corrupt, ends the iteration.
+
+    if (!volume_is_cluster(instance, cluster))
     {
         iterator->end = true;
 
         return;
     }
 
-    // From specification:
-    //   FATOffset = N * 4;
-
-    uint32_t fatOffset = iterator->cluster * 4;
-
-    // From specification:
-    //   ThisFATSecNum = BPB_ResvdSecCnt + (FATOffset / BPB_BytsPerSec);
-
-    Fat32BootSector* bootSector = iterator->instance->data;
-    uint32_t fatSector = bootSector->reservedSectors;
-
-    fatSector += fatOffset / bootSector->bytesPerSector;
-
-    uint32_t fatEntryOffset = fatOffset % bootSector->bytesPerSector;
-
-    // From specification:
-
-    //   FAT32ClusEntryVal =
-    //     (*((DWORD *) &SecBuff[ThisFATEntOffset])) & 0x0FFFFFFF;
-
-    uint8_t* buffer = iterator->instance->data;
-
-    buffer += fatSector * bootSector->bytesPerSector;
-    iterator->cluster = *(uint32_t*)(buffer + fatEntryOffset) & 0x0fffffff;
-
-    volume_root_reset_offset(iterator);
-
-    iterator->entry = (Fat32DirectoryEntry*)(iterator->data + iterator->offset);
-    iterator->end = volume_is_eof(iterator->cluster);
+    iterator->cluster = cluster;
+    iterator->data = volume_cluster_data(instance, cluster);
+    iterator->entry = (Fat32DirectoryEntry*)iterator->data;
 }
 
 uint8_t* volume_root_data(VolumeRootIterator* iterator, uint32_t cluster)
 {
-    Fat32BootSector* bootSector = iterator->instance->data;
-    uint8_t* result = iterator->instance->data;
+    return volume_cluster_data(iterator->instance, cluster);
+}
 
-    result += iterator->firstDataSector * bootSector->bytesPerSector;
-    result += (cluster - 2) * iterator->bytesPerCluster;
+uint32_t volume_root_cluster_count(VolumeRootIterator* iterator)
+{
+    return iterator->instance->geometry.clusterCount;
+}
 
-    return result;
+bool volume_root_matches(
+    VolumeRootIterator* iterator,
+    unsigned char sha1[SHA_DIGEST_LENGTH])
+{
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    uint32_t hi = iterator->entry->firstClusterHi;
+    uint32_t lo = iterator->entry->firstClusterLo;
+    uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
+    uint8_t* data = volume_root_data(iterator, firstCluster);
+
+    return hash_digest(digest, data, iterator->entry->fileSize) &&
+        memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0;
 }
 
 VolumeFindResult volume_root_first_free(
@@ -280,15 +429,7 @@ VolumeFindResult volume_root_first_free(
                 return VOLUME_FIND_RESULT_NAME_FOUND;
             }
 
-            unsigned char digest[SHA_DIGEST_LENGTH];
-            uint32_t hi = iterator->entry->firstClusterHi;
-            uint32_t lo = iterator->entry->firstClusterLo;
-            uint32_t firstCluster = fat32_directory_entry_first_cluster(lo, hi);
-            uint8_t* data = volume_root_data(iterator, firstCluster);
-            
-            SHA1(data, iterator->entry->fileSize * sizeof * data, digest);
-
-            if (memcmp(digest, sha1, SHA_DIGEST_LENGTH) == 0)
+            if (volume_root_matches(iterator, sha1))
             {
                 return VOLUME_FIND_RESULT_SHA1_FOUND;
             }
@@ -324,7 +465,99 @@ VolumeFindResult volume_root_single_free(
     return first;
 }
 
+void volume_dirty(Volume* instance, const void* address, uint32_t length)
+{
+    off_t offset = (const uint8_t*)address - (const uint8_t*)instance->data;
+
+    if (instance->rangeCount)
+    {
+        VolumeRange* last = instance->ranges + instance->rangeCount - 1;
+
+        if (last->offset + last->length == offset)
+        {
+            last->length += length;
+
+            return;
+        }
+    }
+
+    if (instance->rangeCount == instance->rangeCapacity)
+    {
+        uint32_t capacity = instance->rangeCapacity;
+
+        capacity = capacity ? capacity * 2 : 16;
+
+        VolumeRange* ranges = realloc(
+            instance->ranges,
+            capacity * sizeof * ranges);
+
+        if (!ranges)
+        {
+            instance->overflow = true;
+
+            return;
+        }
+
+        instance->ranges = ranges;
+        instance->rangeCapacity = capacity;
+    }
+
+    instance->ranges[instance->rangeCount].offset = offset;
+    instance->ranges[instance->rangeCount].length = length;
+    instance->rangeCount++;
+}
+
+static int volume_compare_ranges(const void* left, const void* right)
+{
+    const VolumeRange* x = left;
+    const VolumeRange* y = right;
+
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+void volume_merge_ranges(Volume* instance)
+{
+    VolumeRange* ranges = instance->ranges;
+    uint32_t count = 0;
+
+    qsort(ranges, instance->rangeCount, sizeof * ranges, volume_compare_ranges);
+
+    for (uint32_t i = 0; i < instance->rangeCount; i++)
+    {
+        if (count)
+        {
+            VolumeRange* last = ranges + count - 1;
+            off_t end = last->offset + last->length;
+
+            if (ranges[i].offset <= end)
+            {
+                off_t next = ranges[i].offset + ranges[i].length;
+
+                if (next > end)
+                {
+                    last->length = next - last->offset;
+                }
+
+                continue;
+            }
+        }
+
+        ranges[count] = ranges[i];
+        count++;
+    }
+
+    instance->rangeCount = count;
+}
+
 void finalize_volume(Volume* instance)
 {
+    if (instance->shared)
+    {
+        munmap(instance->shared, instance->size);
+    }
+
+    free(instance->journal);
+    free(instance->ranges);
     munmap(instance->data, instance->size);
+    close(instance->descriptor);
 }
@@ -19,26 +19,201 @@
 /** Specifies the value used to indicate the end of a cluster chain. */
 #define VOLUME_EOF 0x0fffffff
 
+// From specification:
+//   Note that a FAT32 FAT entry is actually only a 28-bit entry. The high 4
+//   bits of a FAT32 FAT entry are reserved.
+
+/** Specifies the bits of a FAT entry that hold the cluster number. */
+#define VOLUME_MASK 0x0fffffff
+
+/**
+ * Represents the layout of a FAT32 disk image, computed once from its boot
+ * sector. Sector and cluster sizes are powers of two, so that byte offsets are
+ * computed by shifting and masking.
+ */
+struct VolumeGeometry
+{
+    /** Specifies the base-2 logarithm of the number of bytes per sector. */
+    uint32_t sectorShift;
+
+    /** Specifies the base-2 logarithm of the number of bytes per cluster. */
+    uint32_t clusterShift;
+
+    /** Specifies the number of bytes per cluster. */
+    uint32_t bytesPerCluster;
+
+    /** Specifies the number of bytes per cluster minus one. */
+    uint32_t clusterMask;
+
+    /** Specifies the sector number of the first data sector. */
+    uint32_t firstDataSector;
+
+    /**
+     * Specifies the number of data clusters. Valid cluster numbers range from
+     * `2` to one more than this value, inclusive.
+     */
+    uint32_t clusterCount;
+
+    /** Specifies the number of file allocation tables. */
+    uint32_t fatCount;
+
+    /** Specifies the number of entries in each file allocation table. */
+    uint32_t fatEntries;
+
+    /** The first file allocation table. */
+    uint32_t* fat;
+
+    /** The data of cluster `2`, the first data cluster. */
+    uint8_t* clusters;
+};
+
+/** Represents the layout of a FAT32 disk image. */
+typedef struct VolumeGeometry VolumeGeometry;
+
+/** Specifies how a disk image is opened and mapped. */
+enum VolumeMode
+{
+    /**
+     * Keep changes in private, copy-on-write pages until they are committed
+     * to the disk image as a transaction.
+     */
+    VOLUME_MODE_READ_WRITE = 0,
+
+    /** Map the disk image for reading only. */
+    VOLUME_MODE_READ_ONLY,
+
+    /**
+     * Open the disk image for reading only and keep changes in private,
+     * copy-on-write pages, so that they can be exported as a patch.
+     */
+    VOLUME_MODE_PRIVATE
+};
+
+/** Specifies how a disk image is opened and mapped. */
+typedef enum VolumeMode VolumeMode;
+
+/** Represents a range of bytes changed in a disk image. */
+struct VolumeRange
+{
+    /** Specifies the offset of the first byte. */
+    off_t offset;
+
+    /** Specifies the number of bytes. */
+    uint32_t length;
+};
+
+/** Represents a range of bytes changed in a disk image. */
+typedef struct VolumeRange VolumeRange;
+
 /** Represents a FAT32 disk image. */
 struct Volume
 {
     off_t size;
     void* data;
+
+    /** The file descriptor of the disk image, kept open for copying. */
+    int descriptor;
+
+    /**
+     * A shared mapping of the disk image through which transactions are
+     * committed, or `NULL` unless the disk image is opened for writing.
+     */
+    uint8_t* shared;
+
+    /**
+     * A pointer to a zero-terminated string containing the path of the undo
+     * journal, or `NULL` unless the disk image is opened for writing.
+     */
+    char* journal;
+
+    /** Specifies how the disk image is opened and mapped. */
+    VolumeMode mode;
+
+    /** Specifies the number of changed ranges. */
+    uint32_t rangeCount;
+
+    /** Specifies the number of changed ranges for which there is room. */
+    uint32_t rangeCapacity;
+
+    /** `true` if a changed range could not be recorded; otherwise, `false`. */
+    bool overflow;
+
+    /** Specifies the changed ranges in the order in which they were made. */
+    VolumeRange* ranges;
+
+    /** The layout of the disk image. */
+    VolumeGeometry geometry;
 };
 
 /** Represents a FAT32 disk image. */
 typedef struct Volume Volume;
 
 /**
- * Initializes an instance of the `Volume` struct.
+ * Determines whether a cluster number refers to a data cluster of a volume.
+ *
+ * @param instance the `Volume` instance.
+ * @param cluster  the cluster number.
+ * @return `true` if the cluster is a data cluster; otherwise, `false`.
+ */
+#define volume_is_cluster(instance, cluster) \
+    ((cluster) >= 2 && (cluster) - 2 < (instance)->geometry.clusterCount)
+
+/**
+ * Gets the data of a cluster.
+ *
+ * @param instance the `Volume` instance.
+ * @param cluster  the cluster number, which must be a data cluster.
+ * @return A pointer to the first byte of the cluster.
+ */
+#define volume_cluster_data(instance, cluster) \
+    ((instance)->geometry.clusters + \
+        ((size_t)((cluster) - 2) << (instance)->geometry.clusterShift))
+
+/**
+ * Gets the byte offset of a cluster within the disk image.
+ *
+ * @param instance the `Volume` instance.
+ * @param cluster  the cluster number, which must be a data cluster.
+ * @return The offset of the first byte of the cluster.
+ */
+#define volume_cluster_offset(instance, cluster) \
+    ((off_t)((instance)->geometry.clusters - (uint8_t*)(instance)->data) + \
+        ((off_t)((cluster) - 2) << (instance)->geometry.clusterShift))
+
+/**
+ * Gets the cluster that follows a cluster in its chain, according to the first
+ * file allocation table.
+ *
+ * @param instance the `Volume` instance.
+ * @param cluster  the cluster number, which must be a data cluster.
+ * @return The value of the FAT entry of the cluster.
+ */
+#define volume_next_cluster(instance, cluster) \
+    ((instance)->geometry.fat[cluster] & VOLUME_MASK)
+
+/**
+ * Initializes an instance of the `Volume` struct. The boot sector must
+ * describe power-of-two sector and cluster sizes.
  * 
  * @param instance the `Volume` instance.
  * @param path     a pointer to a zero-terminated string containing the path to
  *                 the disk image.
+ * @param mode     specifies how the disk image is opened and mapped.
  * @return `true` if the operation succeeded; otherwise `false`. When `false`,
  *         `errno` is assigned to indicate the error.
  */
-bool volume(Volume* instance, const char* path);
+bool volume(Volume* instance, const char* path, VolumeMode mode);
+
+/**
+ * Records that a range of the disk image has been changed through the mapping.
+ * Every write to the disk image is followed by a call to this method. A range
+ * that extends the previous one is merged with it.
+ *
+ * @param instance the `Volume` instance.
+ * @param address  a pointer to the first changed byte in the mapping.
+ * @param length   the number of changed bytes.
+ */
+void volume_dirty(Volume* instance, const void* address, uint32_t length);
 
 /**
  * Converts a short directory entry name to a short display name.
@@ -58,7 +233,15 @@ void volume_display_name(char buffer[13], uint8_t name[11]);
 uint32_t volume_clusters(uint32_t fileSize, uint32_t bytesPerCluster);
 
 /**
- * Frees all resources.
+ * Sorts the changed ranges by offset and merges those that overlap or are
+ * adjacent.
+ *
+ * @param instance the `Volume` instance.
+ */
+void volume_merge_ranges(Volume* instance);
+
+/**
+ * Frees all resources. Changes that have not been committed are discarded.
  * 
  * @param instance the `Volume` instance. This method corrupts the `instance`
  *                 argument.
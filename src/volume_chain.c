@@ -0,0 +1,71 @@
+// volume_chain.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+
+#include <stdlib.h>
+#include "volume_chain.h"
+
+static bool volume_chain_reserve(VolumeChain* instance)
+{
+    uint32_t capacity = instance->capacity ? instance->capacity * 2 : 16;
+    uint32_t* clusters = realloc(
+        instance->clusters,
+        capacity * sizeof * clusters);
+
+    if (!clusters)
+    {
+        return false;
+    }
+
+    instance->clusters = clusters;
+
+    uint8_t** data = realloc(instance->data, capacity * sizeof * data);
+
+    if (!data)
+    {
+        return false;
+    }
+
+    instance->data = data;
+    instance->capacity = capacity;
+
+    return true;
+}
+
+bool volume_chain(VolumeChain* instance, Volume* volume, uint32_t firstCluster)
+{
+    uint32_t limit = volume->geometry.clusterCount;
+
+    instance->count = 0;
+    instance->capacity = 0;
+    instance->clusters = NULL;
+    instance->data = NULL;
+
+    for (uint32_t cluster = firstCluster;
+        instance->count < limit && volume_is_cluster(volume, cluster);
+        cluster = volume_next_cluster(volume, cluster))
+    {
+        if (instance->count == instance->capacity &&
+            !volume_chain_reserve(instance))
+        {
+            finalize_volume_chain(instance);
+
+            return false;
+        }
+
+        instance->clusters[instance->count] = cluster;
+        instance->data[instance->count] = volume_cluster_data(volume, cluster);
+        instance->count++;
+    }
+
+    return true;
+}
+
+void finalize_volume_chain(VolumeChain* instance)
+{
+    free(instance->clusters);
+    free(instance->data);
+}
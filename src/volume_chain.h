@@ -0,0 +1,50 @@
+// volume_chain.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VOLUME_CHAIN_H
+#define VOLUME_CHAIN_H
+#include "volume.h"
+
+/** Represents a cluster chain resolved to the data of each of its clusters. */
+struct VolumeChain
+{
+    /** Specifies the number of clusters in the chain. */
+    uint32_t count;
+
+    /** Specifies the number of clusters for which there is room. */
+    uint32_t capacity;
+
+    /** Specifies the cluster numbers in the order of the chain. */
+    uint32_t* clusters;
+
+    /** Specifies the data of each cluster in the order of the chain. */
+    uint8_t** data;
+};
+
+/** Represents a cluster chain resolved to the data of each of its clusters. */
+typedef struct VolumeChain VolumeChain;
+
+/**
+ * Initializes an instance of the `VolumeChain` struct by following a cluster
+ * chain through the first file allocation table in a single pass. The chain
+ * ends at the first FAT entry that is not a data cluster. A chain that loops
+ * ends after as many clusters as the volume holds.
+ *
+ * @param instance     the `VolumeChain` instance.
+ * @param volume       the FAT32 disk image.
+ * @param firstCluster the first cluster of the chain.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_chain(VolumeChain* instance, Volume* volume, uint32_t firstCluster);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `VolumeChain` instance. This method corrupts the
+ *                 `instance` argument.
+ */
+void finalize_volume_chain(VolumeChain* instance);
+
+#endif
@@ -0,0 +1,247 @@
+// volume_extract.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man2/copy_file_range.2.html
+//  - https://www.man7.org/linux/man-pages/man2/sendfile.2.html
+//  - https://www.man7.org/linux/man-pages/man2/open.2.html
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sys/sendfile.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "volume_extract.h"
+
+/** Specifies the method used to copy data from the volume. */
+enum VolumeExtractMethod
+{
+    /** Copy between files inside the kernel, possibly sharing extents. */
+    VOLUME_EXTRACT_METHOD_COPY_FILE_RANGE = 0,
+
+    /** Copy from the volume inside the kernel. */
+    VOLUME_EXTRACT_METHOD_SENDFILE,
+
+    /** Write from the mapping of the volume. */
+    VOLUME_EXTRACT_METHOD_WRITE
+};
+
+/** Specifies the method used to copy data from the volume. */
+typedef enum VolumeExtractMethod VolumeExtractMethod;
+
+static ssize_t volume_extract_copy(
+    Volume* volume,
+    int output,
+    off_t offset,
+    size_t length,
+    VolumeExtractMethod* method)
+{
+    ssize_t result = -1;
+
+#ifdef __linux__
+    if (*method == VOLUME_EXTRACT_METHOD_COPY_FILE_RANGE)
+    {
+        result = copy_file_range(
+            volume->descriptor,
+            &offset,
+            output,
+            NULL,
+            length,
+            0);
+
+        if (result != -1)
+        {
+            return result;
+        }
+
+        // Older kernels and some file systems cannot copy between the two
+        // files; each fallback is tried once and then kept.
+
+        if (errno != EXDEV && errno != ENOSYS && errno != EINVAL &&
+            errno != EOPNOTSUPP)
+        {
+            return -1;
+        }
+
+        *method = VOLUME_EXTRACT_METHOD_SENDFILE;
+    }
+
+    if (*method == VOLUME_EXTRACT_METHOD_SENDFILE)
+    {
+        result = sendfile(output, volume->descriptor, &offset, length);
+
+        if (result != -1)
+        {
+            return result;
+        }
+
+        if (errno != ENOSYS && errno != EINVAL)
+        {
+            return -1;
+        }
+
+        *method = VOLUME_EXTRACT_METHOD_WRITE;
+    }
+#endif
+
+    return write(output, (uint8_t*)volume->data + offset, length);
+}
+
+static bool volume_extract_run(
+    Volume* volume,
+    int output,
+    uint32_t firstCluster,
+    size_t length,
+    VolumeExtractMethod* method)
+{
+    off_t offset = volume_cluster_offset(volume, firstCluster);
+
+    if (offset + (off_t)length > volume->size)
+    {
+        errno = EINVAL;
+
+        return false;
+    }
+
+    while (length)
+    {
+        ssize_t copied = volume_extract_copy(
+            volume,
+            output,
+            offset,
+            length,
+            method);
+
+        if (copied == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (copied <= 0)
+        {
+            if (!copied)
+            {
+                errno = EIO;
+            }
+
+            return false;
+        }
+
+        offset += copied;
+        length -= copied;
+    }
+
+    return true;
+}
+
+bool volume_extract(
+    Volume* volume,
+    const char* path,
+    const uint32_t clusters[],
+    uint32_t count,
+    uint32_t size)
+{
+    VolumeGeometry* geometry = &volume->geometry;
+    VolumeExtractMethod method = VOLUME_EXTRACT_METHOD_COPY_FILE_RANGE;
+    uint64_t capacity = (uint64_t)count << geometry->clusterShift;
+
+    if (size > capacity)
+    {
+        errno = EINVAL;
+
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!volume_is_cluster(volume, clusters[i]))
+        {
+            errno = EINVAL;
+
+            return false;
+        }
+    }
+
+    int output = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (output == -1)
+    {
+        return false;
+    }
+
+    bool result = true;
+    uint32_t remaining = size;
+
+    // Consecutive clusters are coalesced into runs, so that a contiguous file
+    // is copied by one request and a fragmented file by one per fragment.
+
+    for (uint32_t i = 0; result && remaining; )
+    {
+        uint32_t first = i;
+
+        for (i++; i < count && clusters[i] == clusters[i - 1] + 1; i++) { }
+
+        uint64_t length = (uint64_t)(i - first) << geometry->clusterShift;
+
+        if (length > remaining)
+        {
+            length = remaining;
+        }
+
+        result = volume_extract_run(
+            volume,
+            output,
+            clusters[first],
+            length,
+            &method);
+        remaining -= length;
+    }
+
+    if (close(output) == -1)
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+bool volume_extract_contiguous(
+    Volume* volume,
+    const char* path,
+    uint32_t firstCluster,
+    uint32_t size)
+{
+    VolumeGeometry* geometry = &volume->geometry;
+    uint32_t count = volume_clusters(size, geometry->bytesPerCluster);
+    uint32_t lastCluster = firstCluster + count - 1;
+
+    if (count &&
+        (!volume_is_cluster(volume, firstCluster) ||
+            !volume_is_cluster(volume, lastCluster)))
+    {
+        errno = EINVAL;
+
+        return false;
+    }
+
+    VolumeExtractMethod method = VOLUME_EXTRACT_METHOD_COPY_FILE_RANGE;
+    int output = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (output == -1)
+    {
+        return false;
+    }
+
+    bool result = !size ||
+        volume_extract_run(volume, output, firstCluster, size, &method);
+
+    if (close(output) == -1)
+    {
+        result = false;
+    }
+
+    return result;
+}
@@ -0,0 +1,49 @@
+// volume_extract.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VOLUME_EXTRACT_H
+#define VOLUME_EXTRACT_H
+#include "volume.h"
+
+/**
+ * Writes a file stored in a sequence of clusters to a new file, leaving the
+ * volume unchanged. Each run of consecutive clusters is copied by a single
+ * in-kernel request from the descriptor of the volume, without passing through
+ * a user-space buffer where the system supports it.
+ *
+ * @param volume   the FAT32 disk image.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the file to create or truncate.
+ * @param clusters the clusters of the file, in order.
+ * @param count    the number of clusters.
+ * @param size     the file size in bytes.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_extract(
+    Volume* volume,
+    const char* path,
+    const uint32_t clusters[],
+    uint32_t count,
+    uint32_t size);
+
+/**
+ * Writes a file stored contiguously to a new file, leaving the volume
+ * unchanged.
+ *
+ * @param volume       the FAT32 disk image.
+ * @param path         a pointer to a zero-terminated string containing the path
+ *                     of the file to create or truncate.
+ * @param firstCluster the first cluster of the file.
+ * @param size         the file size in bytes.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_extract_contiguous(
+    Volume* volume,
+    const char* path,
+    uint32_t firstCluster,
+    uint32_t size);
+
+#endif
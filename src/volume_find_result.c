@@ -10,7 +10,11 @@ static const char* VOLUME_FIND_RESULT_STRINGS[VOLUME_FIND_RESULT_COUNT] =
     [VOLUME_FIND_RESULT_NAME_FOUND] = "successfully recovered",
     [VOLUME_FIND_RESULT_SHA1_FOUND] = "successfully recovered with SHA-1",
     [VOLUME_FIND_RESULT_NOT_FOUND] = "file not found",
-    [VOLUME_FIND_RESULT_MULTIPLE_FOUND] = "multiple candidates found"
+    [VOLUME_FIND_RESULT_MULTIPLE_FOUND] = "multiple candidates found",
+    [VOLUME_FIND_RESULT_WRITE_FAILED] = "could not write the output file",
+    [VOLUME_FIND_RESULT_STOPPED] = "search stopped at its limit",
+    [VOLUME_FIND_RESULT_NO_RECONSTRUCTION] = "no reconstruction found",
+    [VOLUME_FIND_RESULT_SKIPPED] = "skipped"
 };
 
 const char* volume_find_result_to_string(VolumeFindResult value)
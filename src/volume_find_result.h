@@ -2,6 +2,8 @@
 // Copyright (c) 2024 Ishan Pranav
 // Licensed under the MIT license.
 
+#ifndef VOLUME_FIND_RESULT_H
+#define VOLUME_FIND_RESULT_H
 /**
  * Determine whether a given result indicates a successful search.
  *
@@ -26,6 +28,18 @@ enum VolumeFindResult
     /** Multiple candidates were discovered. */
     VOLUME_FIND_RESULT_MULTIPLE_FOUND,
 
+    /** A candidate was discovered, but it could not be written out. */
+    VOLUME_FIND_RESULT_WRITE_FAILED,
+
+    /** The search spent its budget before a candidate was discovered. */
+    VOLUME_FIND_RESULT_STOPPED,
+
+    /** The file was found, but no reconstruction of its content was. */
+    VOLUME_FIND_RESULT_NO_RECONSTRUCTION,
+
+    /** The file was found, but it has more clusters than a search allows. */
+    VOLUME_FIND_RESULT_SKIPPED,
+
     /** The number of volume find result enumeration members. */
     VOLUME_FIND_RESULT_COUNT
 };
@@ -41,3 +55,5 @@ typedef enum VolumeFindResult VolumeFindResult;
  *         value should not be modified or passed as an argument to `free`.
  */
 const char* volume_find_result_to_string(VolumeFindResult value);
+
+#endif
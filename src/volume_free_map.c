@@ -0,0 +1,237 @@
+// volume_free_map.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+//  - https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html
+//  - https://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
+
+#include <stdlib.h>
+#include "volume_free_map.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static uint64_t volume_free_map_scan(const uint32_t* fat)
+{
+    uint64_t result = 0;
+
+#if defined(__AVX2__)
+    __m256i mask = _mm256_set1_epi32(VOLUME_MASK);
+    __m256i zero = _mm256_setzero_si256();
+
+    for (int i = 0; i < 64; i += 8)
+    {
+        __m256i entries = _mm256_loadu_si256((const __m256i*)(fat + i));
+
+        entries = _mm256_cmpeq_epi32(_mm256_and_si256(entries, mask), zero);
+
+        uint64_t bits = _mm256_movemask_ps(_mm256_castsi256_ps(entries));
+
+        result |= bits << i;
+    }
+#elif defined(__SSE2__)
+    __m128i mask = _mm_set1_epi32(VOLUME_MASK);
+    __m128i zero = _mm_setzero_si128();
+
+    for (int i = 0; i < 64; i += 4)
+    {
+        __m128i entries = _mm_loadu_si128((const __m128i*)(fat + i));
+
+        entries = _mm_cmpeq_epi32(_mm_and_si128(entries, mask), zero);
+
+        uint64_t bits = _mm_movemask_ps(_mm_castsi128_ps(entries));
+
+        result |= bits << i;
+    }
+#else
+    for (int i = 0; i < 64; i++)
+    {
+        if (!(fat[i] & VOLUME_MASK))
+        {
+            result |= (uint64_t)1 << i;
+        }
+    }
+#endif
+
+    return result;
+}
+
+static uint32_t volume_free_map_popcount(uint64_t value)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(value);
+#else
+    uint32_t result = 0;
+
+    for (; value; value &= value - 1)
+    {
+        result++;
+    }
+
+    return result;
+#endif
+}
+
+static uint32_t volume_free_map_ctz(uint64_t value)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(value);
+#else
+    uint32_t result = 0;
+
+    for (; !(value & 1); value >>= 1)
+    {
+        result++;
+    }
+
+    return result;
+#endif
+}
+
+bool volume_free_map(VolumeFreeMap* instance, Volume* volume)
+{
+    uint32_t end = volume->geometry.clusterCount + 2;
+    uint32_t words = (end + 63) / 64;
+    uint64_t* bits = calloc(words, sizeof * bits);
+
+    if (!bits)
+    {
+        return false;
+    }
+
+    const uint32_t* fat = volume->geometry.fat;
+    uint32_t count = 0;
+    uint32_t word = 0;
+
+    for (; (word + 1) * 64 <= end; word++)
+    {
+        bits[word] = volume_free_map_scan(fat + word * 64);
+    }
+
+    for (uint32_t cluster = word * 64; cluster < end; cluster++)
+    {
+        if (!(fat[cluster] & VOLUME_MASK))
+        {
+            bits[word] |= (uint64_t)1 << (cluster & 63);
+        }
+    }
+
+    // Clusters 0 and 1 are reserved and never hold data.
+
+    *bits &= ~(uint64_t)3;
+
+    for (word = 0; word < words; word++)
+    {
+        count += volume_free_map_popcount(bits[word]);
+    }
+
+    instance->end = end;
+    instance->count = count;
+    instance->bits = bits;
+
+    return true;
+}
+
+void volume_free_map_reserve(VolumeFreeMap* instance, uint32_t cluster)
+{
+    if (cluster >= instance->end || !volume_free_map_is_free(instance, cluster))
+    {
+        return;
+    }
+
+    instance->bits[cluster >> 6] &= ~((uint64_t)1 << (cluster & 63));
+    instance->count--;
+}
+
+void volume_free_map_reserve_index(
+    VolumeFreeMap* instance,
+    const VolumeIndex* index)
+{
+    for (uint32_t i = 0; i < index->count; i++)
+    {
+        const Fat32DirectoryEntry* entry = index->entries[i].iterator.entry;
+        uint32_t lo = entry->firstClusterLo;
+        uint32_t hi = entry->firstClusterHi;
+
+        volume_free_map_reserve(
+            instance,
+            fat32_directory_entry_first_cluster(lo, hi));
+    }
+}
+
+bool volume_free_map_next_run(
+    const VolumeFreeMap* instance,
+    uint32_t* cluster,
+    VolumeFreeRun* result)
+{
+    uint32_t end = instance->end;
+    uint32_t words = (end + 63) / 64;
+    uint32_t current = *cluster;
+
+    if (current >= end)
+    {
+        return false;
+    }
+
+    // Skip allocated clusters one word at a time.
+
+    uint32_t word = current >> 6;
+    uint64_t bits = instance->bits[word] & (~(uint64_t)0 << (current & 63));
+
+    while (!bits)
+    {
+        word++;
+
+        if (word >= words)
+        {
+            *cluster = end;
+
+            return false;
+        }
+
+        bits = instance->bits[word];
+    }
+
+    uint32_t first = word * 64 + volume_free_map_ctz(bits);
+
+    // Skip free clusters one word at a time.
+
+    bits = ~instance->bits[word] & (~(uint64_t)0 << (first & 63));
+
+    while (!bits)
+    {
+        word++;
+
+        if (word >= words)
+        {
+            break;
+        }
+
+        bits = ~instance->bits[word];
+    }
+
+    uint32_t last = end;
+
+    if (word < words)
+    {
+        last = word * 64 + volume_free_map_ctz(bits);
+    }
+
+    if (last > end)
+    {
+        last = end;
+    }
+
+    result->first = first;
+    result->length = last - first;
+    *cluster = last;
+
+    return true;
+}
+
+void finalize_volume_free_map(VolumeFreeMap* instance)
+{
+    free(instance->bits);
+}
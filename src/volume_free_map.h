@@ -0,0 +1,108 @@
+// volume_free_map.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VOLUME_FREE_MAP_H
+#define VOLUME_FREE_MAP_H
+#include "volume.h"
+#include "volume_index.h"
+
+/**
+ * Determines whether a given cluster is free.
+ *
+ * @param instance a pointer to the `VolumeFreeMap` instance.
+ * @param cluster  the cluster number.
+ * @return `true` if `cluster` is free; otherwise, `false`.
+ */
+#define volume_free_map_is_free(instance, cluster) \
+    (((instance)->bits[(cluster) >> 6] >> ((cluster) & 63)) & 1)
+
+/** Represents a bitmap of the free clusters in a volume. */
+struct VolumeFreeMap
+{
+    /** Specifies one more than the greatest valid cluster number. */
+    uint32_t end;
+
+    /** Specifies the number of free clusters. */
+    uint32_t count;
+
+    /**
+     * The bitmap. Bit `n % 64` of word `n / 64` is set if and only if cluster
+     * `n` is free.
+     */
+    uint64_t* bits;
+};
+
+/** Represents a bitmap of the free clusters in a volume. */
+typedef struct VolumeFreeMap VolumeFreeMap;
+
+/** Represents a maximal run of consecutive free clusters. */
+struct VolumeFreeRun
+{
+    /** Specifies the first cluster in the run. */
+    uint32_t first;
+
+    /** Specifies the number of clusters in the run. */
+    uint32_t length;
+};
+
+/** Represents a maximal run of consecutive free clusters. */
+typedef struct VolumeFreeRun VolumeFreeRun;
+
+/**
+ * Initializes an instance of the `VolumeFreeMap` struct from a single pass
+ * over the first file allocation table of a volume. A cluster is free if its
+ * FAT entry is zero.
+ *
+ * @param instance the `VolumeFreeMap` instance.
+ * @param volume   the FAT32 disk image.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_free_map(VolumeFreeMap* instance, Volume* volume);
+
+/**
+ * Marks a cluster as allocated so that it is excluded from the free clusters.
+ *
+ * @param instance the `VolumeFreeMap` instance.
+ * @param cluster  the cluster number.
+ */
+void volume_free_map_reserve(VolumeFreeMap* instance, uint32_t cluster);
+
+/**
+ * Marks the first cluster of every entry in an index as allocated. The first
+ * cluster of a deleted file or of a directory, in any directory, is known to
+ * belong to that entry, so no other file is rebuilt from it.
+ *
+ * @param instance the `VolumeFreeMap` instance.
+ * @param index    the index of the deleted files and directories.
+ */
+void volume_free_map_reserve_index(
+    VolumeFreeMap* instance,
+    const VolumeIndex* index);
+
+/**
+ * Finds the next run of free clusters.
+ *
+ * @param instance the `VolumeFreeMap` instance.
+ * @param cluster  the cluster number from which to begin the search. When this
+ *                 method returns, contains the cluster number immediately
+ *                 following the run.
+ * @param result   when this method returns, contains the run, if any. This
+ *                 argument is passed uninitialized.
+ * @return `true` if a run was found; otherwise, `false`.
+ */
+bool volume_free_map_next_run(
+    const VolumeFreeMap* instance,
+    uint32_t* cluster,
+    VolumeFreeRun* result);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `VolumeFreeMap` instance. This method corrupts the
+ *                 `instance` argument.
+ */
+void finalize_volume_free_map(VolumeFreeMap* instance);
+
+#endif
@@ -0,0 +1,869 @@
+// volume_index.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+//  - http://www.isthe.com/chongo/tech/comp/fnv/
+//  - https://www.man7.org/linux/man-pages/man3/pthread_cond_wait.3p.html
+
+#include <openssl/sha.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fat32_attributes.h"
+#include "fat32_boot_sector.h"
+#include "volume_chain.h"
+#include "volume_index.h"
+
+/** Represents a directory waiting to be walked. */
+struct VolumeIndexDirectory
+{
+    /** Specifies the first cluster of the directory. */
+    uint32_t cluster;
+
+    /** `true` if the directory is deleted; otherwise, `false`. */
+    bool deleted;
+};
+
+/** Represents a directory waiting to be walked. */
+typedef struct VolumeIndexDirectory VolumeIndexDirectory;
+
+/**
+ * Represents the state of a walk over the directory tree of a volume, shared by
+ * every worker. The directories form a queue: those before `current` have been
+ * taken by a worker, and those from `current` to `pending` are waiting.
+ */
+struct VolumeIndexWalk
+{
+    /** Specifies the position of the next directory to take. */
+    uint32_t current;
+
+    /** Specifies one more than the position of the last directory queued. */
+    uint32_t pending;
+
+    /** Specifies the number of directories for which there is room. */
+    uint32_t pendingCapacity;
+
+    /** Specifies the number of workers walking a directory. */
+    uint32_t active;
+
+    /** `true` if a worker failed; otherwise, `false`. */
+    bool failed;
+
+    /** The bitmap of the directory clusters already claimed by a worker. */
+    _Atomic uint64_t* visited;
+
+    /** Specifies the directories queued so far. */
+    VolumeIndexDirectory* directories;
+
+    /** An iterator used as a template for the iterators of the entries. */
+    VolumeRootIterator root;
+
+    /** The mutex that guards the queue, `active` and `failed`. */
+    pthread_mutex_t mutex;
+
+    /** Signaled when a directory is queued or the walk is over. */
+    pthread_cond_t changed;
+
+    /** The timeline on which each directory walked is recorded, or `NULL`. */
+    Trace* trace;
+};
+
+/** Represents the state of a walk over the directory tree of a volume. */
+typedef struct VolumeIndexWalk VolumeIndexWalk;
+
+/** Represents a thread that walks directories taken from the shared queue. */
+struct VolumeIndexWorker
+{
+    /** Specifies the number of entries found by the worker. */
+    uint32_t count;
+
+    /** Specifies the number of entries for which there is room. */
+    uint32_t capacity;
+
+    /** Specifies the number of directories found but not yet queued. */
+    uint32_t found;
+
+    /** Specifies the number of found directories for which there is room. */
+    uint32_t foundCapacity;
+
+    /** Specifies the number of directory entries visited by the worker. */
+    uint64_t visited;
+
+    /** `true` if the thread was started; otherwise, `false`. */
+    bool started;
+
+    /** The shared state of the walk. */
+    VolumeIndexWalk* walk;
+
+    /** Specifies the entries found by the worker. */
+    VolumeIndexEntry* entries;
+
+    /** Specifies the directories found but not yet queued. */
+    VolumeIndexDirectory* directories;
+
+    /** The thread. */
+    pthread_t thread;
+};
+
+/** Represents a thread that walks directories taken from the shared queue. */
+typedef struct VolumeIndexWorker VolumeIndexWorker;
+
+static uint32_t volume_index_hash(uint32_t directory, const char* key)
+{
+    uint32_t result = 2166136261u;
+
+    for (int i = 0; i < 4; i++)
+    {
+        result ^= (directory >> (8 * i)) & 0xff;
+        result *= 16777619u;
+    }
+
+    for (; *key; key++)
+    {
+        result ^= (uint8_t)*key;
+        result *= 16777619u;
+    }
+
+    return result;
+}
+
+static bool volume_index_is_directory(Fat32DirectoryEntry* entry)
+{
+    uint8_t longName = FAT32_ATTRIBUTES_LONG_NAME;
+
+    return entry->attributes & FAT32_ATTRIBUTES_DIRECTORY &&
+        (entry->attributes & longName) != longName &&
+        !(entry->attributes & FAT32_ATTRIBUTES_VOLUME_ID) &&
+        *entry->name != '.' &&
+        !fat32_directory_entry_is_end_free(entry);
+}
+
+static bool volume_index_is_deleted_file(Fat32DirectoryEntry* entry)
+{
+    return !(entry->attributes & FAT32_ATTRIBUTES_DIRECTORY) &&
+        !(entry->attributes & FAT32_ATTRIBUTES_VOLUME_ID) &&
+        !(entry->attributes & FAT32_ATTRIBUTES_LONG_NAME) &&
+        (fat32_directory_entry_is_end_free(entry) ||
+            fat32_directory_entry_is_mid_free(entry));
+}
+
+static uint32_t volume_index_first_cluster(Fat32DirectoryEntry* entry)
+{
+    uint32_t hi = entry->firstClusterHi;
+    uint32_t lo = entry->firstClusterLo;
+
+    return fat32_directory_entry_first_cluster(lo, hi);
+}
+
+static bool volume_index_push(
+    VolumeIndexWorker* worker,
+    uint32_t cluster,
+    bool deleted)
+{
+    if (worker->found == worker->foundCapacity)
+    {
+        uint32_t capacity = worker->foundCapacity;
+
+        capacity = capacity ? capacity * 2 : 16;
+
+        VolumeIndexDirectory* directories = realloc(
+            worker->directories,
+            capacity * sizeof * directories);
+
+        if (!directories)
+        {
+            return false;
+        }
+
+        worker->directories = directories;
+        worker->foundCapacity = capacity;
+    }
+
+    worker->directories[worker->found].cluster = cluster;
+    worker->directories[worker->found].deleted = deleted;
+    worker->found++;
+
+    return true;
+}
+
+static bool volume_index_add(
+    VolumeIndexWorker* worker,
+    uint32_t directory,
+    const VolumeRootIterator* iterator,
+    const char* name)
+{
+    if (worker->count == worker->capacity)
+    {
+        uint32_t capacity = worker->capacity ? worker->capacity * 2 : 64;
+        VolumeIndexEntry* entries = realloc(
+            worker->entries,
+            capacity * sizeof * entries);
+
+        if (!entries)
+        {
+            return false;
+        }
+
+        worker->entries = entries;
+        worker->capacity = capacity;
+    }
+
+    VolumeIndexEntry* entry = worker->entries + worker->count;
+
+    entry->directory = directory;
+    entry->next = 0;
+    entry->iterator = *iterator;
+
+    strcpy(entry->name, name);
+
+    worker->count++;
+
+    return true;
+}
+
+static bool volume_index_claim(VolumeIndexWalk* walk, uint32_t cluster)
+{
+    uint64_t bit = (uint64_t)1 << (cluster & 63);
+    uint64_t previous = atomic_fetch_or_explicit(
+        walk->visited + (cluster >> 6),
+        bit,
+        memory_order_relaxed);
+
+    return !(previous & bit);
+}
+
+static bool volume_index_visit_cluster(
+    VolumeIndexWorker* worker,
+    uint32_t directory,
+    uint32_t cluster,
+    uint8_t* data,
+    bool* ended)
+{
+    VolumeRootIterator it = worker->walk->root;
+    Fat32DirectoryEntry* last;
+
+    it.cluster = cluster;
+    it.data = data;
+    it.end = false;
+    last = (Fat32DirectoryEntry*)(data + it.bytesPerCluster);
+    worker->visited += it.bytesPerCluster / sizeof * it.entry;
+
+    for (it.entry = (Fat32DirectoryEntry*)data; it.entry < last; it.entry++)
+    {
+        if (fat32_directory_entry_is_end_free(it.entry))
+        {
+            *ended = true;
+        }
+
+        bool isDirectory = volume_index_is_directory(it.entry);
+
+        if (!isDirectory && !volume_index_is_deleted_file(it.entry))
+        {
+            continue;
+        }
+
+        char buffer[13];
+
+        volume_display_name(buffer, it.entry->name);
+
+        if (*buffer == '\0')
+        {
+            continue;
+        }
+
+        if (!volume_index_add(worker, directory, &it, buffer))
+        {
+            return false;
+        }
+
+        if (isDirectory &&
+            !volume_index_push(
+                worker,
+                volume_index_first_cluster(it.entry),
+                fat32_directory_entry_is_mid_free(it.entry)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool volume_index_visit(
+    VolumeIndexWorker* worker,
+    VolumeIndexDirectory directory)
+{
+    VolumeIndexWalk* walk = worker->walk;
+    Volume* volume = walk->root.instance;
+    uint32_t cluster = directory.cluster;
+    bool ended = false;
+
+    if (!directory.deleted)
+    {
+        VolumeChain chain;
+
+        if (!volume_chain(&chain, volume, cluster))
+        {
+            return false;
+        }
+
+        bool result = true;
+
+        for (uint32_t i = 0; result && i < chain.count; i++)
+        {
+            if (!volume_index_claim(walk, chain.clusters[i]))
+            {
+                break;
+            }
+
+            result = volume_index_visit_cluster(
+                worker,
+                directory.cluster,
+                chain.clusters[i],
+                chain.data[i],
+                &ended);
+        }
+
+        finalize_volume_chain(&chain);
+
+        return result;
+    }
+
+    // The chain of a deleted directory is inferred from the clusters that
+    // follow it.
+
+    while (!ended && volume_is_cluster(volume, cluster) &&
+        volume_index_claim(walk, cluster))
+    {
+        if (!volume_index_visit_cluster(
+            worker,
+            directory.cluster,
+            cluster,
+            volume_cluster_data(volume, cluster),
+            &ended))
+        {
+            return false;
+        }
+
+        cluster++;
+
+        if (!volume_is_cluster(volume, cluster) ||
+            volume_next_cluster(volume, cluster))
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+static bool volume_index_is_deleted_directory(
+    VolumeIndexWalk* walk,
+    uint32_t cluster)
+{
+    Volume* volume = walk->root.instance;
+
+    if (!volume_is_cluster(volume, cluster) ||
+        volume_next_cluster(volume, cluster))
+    {
+        return false;
+    }
+
+    Fat32DirectoryEntry* entry;
+
+    entry = (Fat32DirectoryEntry*)volume_cluster_data(volume, cluster);
+
+    return entry->attributes & FAT32_ATTRIBUTES_DIRECTORY &&
+        memcmp(entry->name, ".          ", sizeof entry->name) == 0;
+}
+
+static bool volume_index_enqueue(VolumeIndexWalk* walk, uint32_t count)
+{
+    uint32_t capacity = walk->pendingCapacity;
+
+    if (walk->pending + count <= capacity)
+    {
+        return true;
+    }
+
+    if (!capacity)
+    {
+        capacity = 16;
+    }
+
+    while (capacity < walk->pending + count)
+    {
+        capacity *= 2;
+    }
+
+    VolumeIndexDirectory* directories = realloc(
+        walk->directories,
+        capacity * sizeof * directories);
+
+    if (!directories)
+    {
+        return false;
+    }
+
+    walk->directories = directories;
+    walk->pendingCapacity = capacity;
+
+    return true;
+}
+
+static void* volume_index_work(void* argument)
+{
+    VolumeIndexWorker* worker = argument;
+    VolumeIndexWalk* walk = worker->walk;
+
+    pthread_mutex_lock(&walk->mutex);
+
+    for (;;)
+    {
+        while (!walk->failed && walk->current == walk->pending && walk->active)
+        {
+            pthread_cond_wait(&walk->changed, &walk->mutex);
+        }
+
+        if (walk->failed || walk->current == walk->pending)
+        {
+            break;
+        }
+
+        VolumeIndexDirectory directory = walk->directories[walk->current];
+        bool result = true;
+
+        walk->current++;
+        walk->active++;
+
+        pthread_mutex_unlock(&walk->mutex);
+
+        // A deleted directory whose first cluster was reused no longer has a
+        // free first cluster that begins with its own `.` entry. Its guessed
+        // chain holds only free clusters, so it never claims a cluster of a
+        // live directory before that directory is walked.
+
+        if (!directory.deleted ||
+            volume_index_is_deleted_directory(walk, directory.cluster))
+        {
+            double start = trace_now(walk->trace);
+
+            result = volume_index_visit(worker, directory);
+
+            trace_span(walk->trace, "directory", start);
+        }
+
+        // The directories found are queued together, so that the mutex is
+        // taken once per directory walked.
+
+        pthread_mutex_lock(&walk->mutex);
+
+        walk->active--;
+
+        if (!result || !volume_index_enqueue(walk, worker->found))
+        {
+            walk->failed = true;
+        }
+        else
+        {
+            memcpy(
+                walk->directories + walk->pending,
+                worker->directories,
+                worker->found * sizeof * worker->directories);
+
+            walk->pending += worker->found;
+        }
+
+        worker->found = 0;
+
+        if (walk->failed || walk->current < walk->pending || !walk->active)
+        {
+            pthread_cond_broadcast(&walk->changed);
+        }
+    }
+
+    pthread_mutex_unlock(&walk->mutex);
+
+    return NULL;
+}
+
+static bool volume_index_merge(
+    VolumeIndex* instance,
+    VolumeIndexWorker workers[],
+    uint32_t threads)
+{
+    uint32_t count = 0;
+
+    for (uint32_t w = 0; w < threads; w++)
+    {
+        count += workers[w].count;
+        instance->visited += workers[w].visited;
+    }
+
+    if (!count)
+    {
+        return true;
+    }
+
+    instance->entries = malloc(count * sizeof * instance->entries);
+
+    if (!instance->entries)
+    {
+        return false;
+    }
+
+    // Every directory is walked by a single worker, so the entries with a
+    // given key stay in the order of their directory.
+
+    for (uint32_t w = 0; w < threads; w++)
+    {
+        memcpy(
+            instance->entries + instance->count,
+            workers[w].entries,
+            workers[w].count * sizeof * instance->entries);
+
+        instance->count += workers[w].count;
+    }
+
+    return true;
+}
+
+static bool volume_index_walk(
+    VolumeIndex* instance,
+    VolumeIndexWalk* walk,
+    uint32_t threads)
+{
+    bool result = false;
+    VolumeIndexWorker* workers = calloc(threads, sizeof * workers);
+
+    if (!workers)
+    {
+        return false;
+    }
+
+    walk->directories[0].cluster = instance->rootCluster;
+    walk->directories[0].deleted = false;
+    walk->pending = 1;
+
+    for (uint32_t w = 0; w < threads; w++)
+    {
+        workers[w].walk = walk;
+    }
+
+    // A worker that fails to start leaves the queue to the others; the calling
+    // thread always participates as the first worker.
+
+    for (uint32_t w = 1; w < threads; w++)
+    {
+        workers[w].started = pthread_create(
+            &workers[w].thread,
+            NULL,
+            volume_index_work,
+            workers + w) == 0;
+    }
+
+    volume_index_work(workers);
+
+    for (uint32_t w = 1; w < threads; w++)
+    {
+        if (workers[w].started)
+        {
+            pthread_join(workers[w].thread, NULL);
+        }
+    }
+
+    result = !walk->failed && volume_index_merge(instance, workers, threads);
+
+    for (uint32_t w = 0; w < threads; w++)
+    {
+        free(workers[w].entries);
+        free(workers[w].directories);
+    }
+
+    free(workers);
+
+    return result;
+}
+
+static VolumeIndexSlot* volume_index_slot(
+    VolumeIndex* instance,
+    uint32_t directory,
+    const char* key)
+{
+    uint32_t mask = instance->slotCount - 1;
+    uint32_t i = volume_index_hash(directory, key) & mask;
+
+    for (;; i = (i + 1) & mask)
+    {
+        VolumeIndexSlot* slot = instance->slots + i;
+
+        if (!slot->head)
+        {
+            return slot;
+        }
+
+        VolumeIndexEntry* head = instance->entries + slot->head - 1;
+
+        if (head->directory == directory && strcmp(head->name + 1, key) == 0)
+        {
+            return slot;
+        }
+    }
+}
+
+static bool volume_index_build(VolumeIndex* instance)
+{
+    uint32_t slotCount = 16;
+
+    while (slotCount < 2 * instance->count)
+    {
+        slotCount *= 2;
+    }
+
+    instance->slotCount = slotCount;
+    instance->slots = calloc(slotCount, sizeof * instance->slots);
+
+    if (!instance->slots)
+    {
+        return false;
+    }
+
+    // Entries are appended to the tail of their slot, so that the entries with
+    // a given key stay in the order in which they were discovered.
+
+    for (uint32_t i = 0; i < instance->count; i++)
+    {
+        VolumeIndexEntry* entry = instance->entries + i;
+        VolumeIndexSlot* slot = volume_index_slot(
+            instance,
+            entry->directory,
+            entry->name + 1);
+
+        if (slot->head)
+        {
+            instance->entries[slot->tail - 1].next = i + 1;
+        }
+        else
+        {
+            slot->head = i + 1;
+        }
+
+        slot->tail = i + 1;
+    }
+
+    return true;
+}
+
+bool volume_index(
+    VolumeIndex* instance,
+    Volume* volume,
+    uint32_t threads,
+    Trace* trace)
+{
+    Fat32BootSector* bootSector = volume->data;
+    VolumeIndexWalk walk;
+    bool result = false;
+    double start = trace_now(trace);
+
+    instance->count = 0;
+    instance->slotCount = 0;
+    instance->visited = 0;
+    instance->rootCluster = bootSector->rootCluster;
+    instance->entries = NULL;
+    instance->slots = NULL;
+    walk.current = 0;
+    walk.pending = 0;
+    walk.pendingCapacity = 0;
+    walk.active = 0;
+    walk.failed = false;
+    walk.directories = NULL;
+    walk.trace = trace;
+
+    volume_root_begin(&walk.root, volume);
+
+    uint32_t end = volume->geometry.clusterCount + 2;
+
+    walk.visited = calloc((end + 63) / 64, sizeof * walk.visited);
+
+    if (!walk.visited)
+    {
+        goto volume_index_exit;
+    }
+
+    if (!volume_index_enqueue(&walk, 1))
+    {
+        goto volume_index_exit_visited;
+    }
+
+    if (pthread_mutex_init(&walk.mutex, NULL) != 0)
+    {
+        goto volume_index_exit_visited;
+    }
+
+    if (pthread_cond_init(&walk.changed, NULL) != 0)
+    {
+        goto volume_index_exit_mutex;
+    }
+
+    result = volume_index_walk(instance, &walk, threads ? threads : 1) &&
+        volume_index_build(instance);
+
+    pthread_cond_destroy(&walk.changed);
+
+volume_index_exit_mutex:
+    pthread_mutex_destroy(&walk.mutex);
+
+volume_index_exit_visited:
+    free(walk.visited);
+
+volume_index_exit:
+    free(walk.directories);
+
+    if (!result)
+    {
+        finalize_volume_index(instance);
+    }
+
+    trace_span(trace, "index", start);
+
+    return result;
+}
+
+static VolumeIndexEntry* volume_index_first(
+    VolumeIndex* instance,
+    uint32_t directory,
+    const char* key)
+{
+    if (!instance->slotCount || *key == '\0')
+    {
+        return NULL;
+    }
+
+    VolumeIndexSlot* slot = volume_index_slot(instance, directory, key + 1);
+
+    if (!slot->head)
+    {
+        return NULL;
+    }
+
+    return instance->entries + slot->head - 1;
+}
+
+static VolumeIndexEntry* volume_index_chain_next(
+    VolumeIndex* instance,
+    VolumeIndexEntry* entry)
+{
+    if (!entry->next)
+    {
+        return NULL;
+    }
+
+    return instance->entries + entry->next - 1;
+}
+
+VolumeIndexEntry* volume_index_find(VolumeIndex* instance, const char* path)
+{
+    uint32_t directory = instance->rootCluster;
+    const char* start = path;
+    const char* slash;
+
+    // Each directory name is resolved in turn: a live directory must match
+    // exactly, while a deleted one matches regardless of its first character.
+
+    while ((slash = strchr(start, '/')))
+    {
+        char component[13];
+        size_t length = slash - start;
+
+        if (!length)
+        {
+            start = slash + 1;
+
+            continue;
+        }
+
+        if (length >= sizeof component)
+        {
+            return NULL;
+        }
+
+        memcpy(component, start, length);
+
+        component[length] = '\0';
+
+        VolumeIndexEntry* entry = volume_index_first(
+            instance,
+            directory,
+            component);
+
+        for (; entry; entry = volume_index_chain_next(instance, entry))
+        {
+            Fat32DirectoryEntry* value = entry->iterator.entry;
+
+            if (volume_index_is_directory(value) &&
+                (fat32_directory_entry_is_mid_free(value) ||
+                    strcmp(entry->name, component) == 0))
+            {
+                break;
+            }
+        }
+
+        if (!entry)
+        {
+            return NULL;
+        }
+
+        directory = volume_index_first_cluster(entry->iterator.entry);
+
+        if (directory < 2)
+        {
+            directory = instance->rootCluster;
+        }
+
+        start = slash + 1;
+    }
+
+    VolumeIndexEntry* entry = volume_index_first(instance, directory, start);
+
+    if (entry && (entry->iterator.entry->attributes &
+        FAT32_ATTRIBUTES_DIRECTORY))
+    {
+        entry = volume_index_next(instance, entry);
+    }
+
+    return entry;
+}
+
+VolumeIndexEntry* volume_index_next(
+    VolumeIndex* instance,
+    VolumeIndexEntry* entry)
+{
+    do
+    {
+        entry = volume_index_chain_next(instance, entry);
+    } while (entry &&
+        entry->iterator.entry->attributes & FAT32_ATTRIBUTES_DIRECTORY);
+
+    return entry;
+}
+
+const char* volume_index_file_name(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+
+    if (!slash)
+    {
+        return path;
+    }
+
+    return slash + 1;
+}
+
+void finalize_volume_index(VolumeIndex* instance)
+{
+    free(instance->entries);
+    free(instance->slots);
+}
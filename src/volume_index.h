@@ -0,0 +1,150 @@
+// volume_index.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VOLUME_INDEX_H
+#define VOLUME_INDEX_H
+#include "trace.h"
+#include "volume_root_iterator.h"
+
+/** Represents a deleted file or a directory in a `VolumeIndex`. */
+struct VolumeIndexEntry
+{
+    /** Specifies the first cluster of the directory containing the entry. */
+    uint32_t directory;
+
+    /**
+     * Specifies one more than the position of the next entry with the same
+     * key, or `0` if there is none.
+     */
+    uint32_t next;
+
+    /**
+     * The short display name of the entry. The first character of a deleted
+     * entry is overwritten, so the key of the entry omits it.
+     */
+    char name[13];
+
+    /** An iterator pointing to the directory entry. */
+    VolumeRootIterator iterator;
+};
+
+/** Represents a deleted file or a directory in a `VolumeIndex`. */
+typedef struct VolumeIndexEntry VolumeIndexEntry;
+
+/** Represents the entries with a given key in a `VolumeIndex`. */
+struct VolumeIndexSlot
+{
+    /** Specifies one more than the position of the first entry, or `0`. */
+    uint32_t head;
+
+    /** Specifies one more than the position of the last entry, or `0`. */
+    uint32_t tail;
+};
+
+/** Represents the entries with a given key in a `VolumeIndex`. */
+typedef struct VolumeIndexSlot VolumeIndexSlot;
+
+/**
+ * Represents an index of the deleted files in every directory of a volume. The
+ * index also holds every directory, live or deleted, so that path-qualified
+ * names can be resolved. Entries are keyed by their containing directory and
+ * by their name without its first character, in an open-addressing hash
+ * table.
+ */
+struct VolumeIndex
+{
+    /** Specifies the number of entries. */
+    uint32_t count;
+
+    /** Specifies the number of slots, a power of two. */
+    uint32_t slotCount;
+
+    /** Specifies the first cluster of the root directory. */
+    uint32_t rootCluster;
+
+    /** Specifies the number of directory entries visited by the walk. */
+    uint64_t visited;
+
+    /** Specifies the entries in the order in which they were discovered. */
+    VolumeIndexEntry* entries;
+
+    /** Specifies the hash table. */
+    VolumeIndexSlot* slots;
+};
+
+/** Represents an index of the deleted files in every directory of a volume. */
+typedef struct VolumeIndex VolumeIndex;
+
+/**
+ * Initializes an instance of the `VolumeIndex` struct by walking the directory
+ * tree of a volume. A deleted file is a free directory entry that is neither a
+ * directory, a volume label nor part of a long name.
+ *
+ * Directories are walked in parallel: each thread takes a directory from a
+ * shared queue, collects its entries into a buffer of its own and queues the
+ * subdirectories it finds. The buffers are merged once the queue is empty.
+ *
+ * Live directories are followed through the file allocation table. The chain
+ * of a deleted directory is no longer recorded, so it is inferred: it begins
+ * at the first cluster of the directory, if that cluster is free, and
+ * continues into each following free cluster for as long as the previous
+ * cluster held no end-of-directory entry.
+ *
+ * @param instance the `VolumeIndex` instance.
+ * @param volume   the FAT32 disk image.
+ * @param threads  the number of threads that walk the directory tree.
+ * @param trace    the timeline on which each directory walked is recorded, or
+ *                 `NULL`.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_index(
+    VolumeIndex* instance,
+    Volume* volume,
+    uint32_t threads,
+    Trace* trace);
+
+/**
+ * Finds the first deleted file whose path matches the given path. A path is a
+ * file name, optionally preceded by directory names separated by `/`; a file
+ * name alone refers to the root directory. The first character of the names
+ * of deleted files and directories is ignored in the comparison.
+ *
+ * @param instance the `VolumeIndex` instance.
+ * @param path     a pointer to a zero-terminated string containing the path.
+ * @return A pointer to the first matching entry in the order of the directory,
+ *         or `NULL` if there is no match.
+ */
+VolumeIndexEntry* volume_index_find(VolumeIndex* instance, const char* path);
+
+/**
+ * Finds the next entry with the same key as a given entry.
+ *
+ * @param instance the `VolumeIndex` instance.
+ * @param entry    the entry.
+ * @return A pointer to the next deleted file with the same key, or `NULL` if
+ *         there is none.
+ */
+VolumeIndexEntry* volume_index_next(
+    VolumeIndex* instance,
+    VolumeIndexEntry* entry);
+
+/**
+ * Gets the file name of a path.
+ *
+ * @param path a pointer to a zero-terminated string containing the path.
+ * @return A pointer to the character following the last `/` in `path`, or
+ *         `path` if there is none.
+ */
+const char* volume_index_file_name(const char* path);
+
+/**
+ * Frees all resources.
+ *
+ * @param instance the `VolumeIndex` instance. This method corrupts the
+ *                 `instance` argument.
+ */
+void finalize_volume_index(VolumeIndex* instance);
+
+#endif
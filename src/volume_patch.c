@@ -0,0 +1,518 @@
+// volume_patch.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man2/fsync.2.html
+//  - https://www.man7.org/linux/man-pages/man2/pwrite.2.html
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hash.h"
+#include "volume_patch.h"
+
+/** Represents the header of a patch file. */
+struct VolumePatchHeader
+{
+    /** Specifies the `VOLUME_PATCH_MAGIC` bytes. */
+    char magic[8];
+
+    /** Specifies the `VOLUME_PATCH_VERSION`. */
+    uint32_t version;
+
+    /** Specifies the number of records. */
+    uint32_t count;
+
+    /** Specifies the size of the disk image in bytes. */
+    uint64_t size;
+};
+
+/** Represents the header of a patch file. */
+typedef struct VolumePatchHeader VolumePatchHeader;
+
+/** Represents the header of a record in a patch file. */
+struct VolumePatchRecord
+{
+    /** Specifies the offset of the first changed byte. */
+    uint64_t offset;
+
+    /** Specifies the number of changed bytes. */
+    uint32_t length;
+};
+
+/** Represents the header of a record in a patch file. */
+typedef struct VolumePatchRecord VolumePatchRecord;
+
+static bool volume_patch_write_bytes(
+    FILE* output,
+    Hash* checksum,
+    const void* data,
+    size_t size)
+{
+    hash_update(checksum, data, size);
+
+    return fwrite(data, 1, size, output) == size;
+}
+
+static bool volume_patch_read_bytes(
+    FILE* input,
+    Hash* checksum,
+    void* data,
+    size_t size)
+{
+    if (fread(data, 1, size, input) != size)
+    {
+        return false;
+    }
+
+    if (checksum)
+    {
+        hash_update(checksum, data, size);
+    }
+
+    return true;
+}
+
+static bool volume_patch_write_integer(
+    FILE* output,
+    Hash* checksum,
+    uint64_t value,
+    size_t size)
+{
+    uint8_t bytes[sizeof value];
+
+    // Integers are written byte by byte, least significant first, so that a
+    // patch exported on one host applies on any other.
+
+    for (size_t i = 0; i < size; i++)
+    {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+
+    return volume_patch_write_bytes(output, checksum, bytes, size);
+}
+
+static bool volume_patch_read_integer(
+    FILE* input,
+    Hash* checksum,
+    uint64_t* value,
+    size_t size)
+{
+    uint8_t bytes[sizeof * value];
+
+    if (!volume_patch_read_bytes(input, checksum, bytes, size))
+    {
+        return false;
+    }
+
+    *value = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        *value |= (uint64_t)bytes[i] << (8 * i);
+    }
+
+    return true;
+}
+
+static bool volume_patch_write_record(
+    FILE* output,
+    Hash* checksum,
+    const VolumePatchRecord* record,
+    const uint8_t* data)
+{
+    return volume_patch_write_integer(output, checksum, record->offset, 8) &&
+        volume_patch_write_integer(output, checksum, record->length, 4) &&
+        volume_patch_write_bytes(output, checksum, data, record->length);
+}
+
+static bool volume_patch_read_record(
+    FILE* input,
+    Hash* checksum,
+    VolumePatchRecord* record)
+{
+    uint64_t length;
+
+    if (!volume_patch_read_integer(input, checksum, &record->offset, 8) ||
+        !volume_patch_read_integer(input, checksum, &length, 4))
+    {
+        return false;
+    }
+
+    record->length = length;
+
+    return true;
+}
+
+static bool volume_patch_save(
+    Volume* instance,
+    const char* path,
+    const uint8_t* source,
+    bool durable)
+{
+    if (instance->overflow)
+    {
+        errno = ENOMEM;
+
+        return false;
+    }
+
+    volume_merge_ranges(instance);
+
+    Hash checksum;
+
+    if (!hash(&checksum, hash_backend()))
+    {
+        return false;
+    }
+
+    FILE* output = fopen(path, "wb");
+    VolumePatchHeader header;
+    bool result = false;
+
+    if (!output)
+    {
+        goto volume_patch_save_exit;
+    }
+
+    result = true;
+
+    memcpy(header.magic, VOLUME_PATCH_MAGIC, sizeof header.magic);
+
+    header.version = VOLUME_PATCH_VERSION;
+    header.count = instance->rangeCount;
+    header.size = instance->size;
+
+    if (!volume_patch_write_bytes(
+        output,
+        &checksum,
+        header.magic,
+        sizeof header.magic) ||
+        !volume_patch_write_integer(output, &checksum, header.version, 4) ||
+        !volume_patch_write_integer(output, &checksum, header.count, 4) ||
+        !volume_patch_write_integer(output, &checksum, header.size, 8))
+    {
+        result = false;
+    }
+
+    for (uint32_t i = 0; result && i < header.count; i++)
+    {
+        VolumePatchRecord record =
+        {
+            .offset = instance->ranges[i].offset,
+            .length = instance->ranges[i].length
+        };
+
+        result = volume_patch_write_record(
+            output,
+            &checksum,
+            &record,
+            source + record.offset);
+    }
+
+    // The trailer is written last, so a file cut short anywhere lacks it or
+    // fails its checksum.
+
+    if (result)
+    {
+        unsigned char digest[HASH_DIGEST_LENGTH];
+
+        result = volume_patch_write_bytes(
+            output,
+            &checksum,
+            VOLUME_PATCH_TRAILER,
+            8);
+
+        hash_final(&checksum, digest);
+
+        result = result && fwrite(digest, sizeof digest, 1, output) == 1;
+    }
+
+    if (result && durable &&
+        (fflush(output) == EOF || fsync(fileno(output)) == -1))
+    {
+        result = false;
+    }
+
+    if (fclose(output) == EOF)
+    {
+        result = false;
+    }
+
+volume_patch_save_exit:
+    finalize_hash(&checksum);
+
+    return result;
+}
+
+bool volume_patch_export(Volume* instance, const char* path)
+{
+    return volume_patch_save(instance, path, instance->data, false);
+}
+
+bool volume_patch_journal(Volume* instance, const char* path)
+{
+    return volume_patch_save(instance, path, instance->shared, true);
+}
+
+static bool volume_patch_read_header(
+    FILE* input,
+    Hash* checksum,
+    Volume* instance,
+    VolumePatchHeader* header)
+{
+    uint64_t version;
+    uint64_t count;
+
+    if (!volume_patch_read_bytes(
+        input,
+        checksum,
+        header->magic,
+        sizeof header->magic) ||
+        !volume_patch_read_integer(input, checksum, &version, 4) ||
+        !volume_patch_read_integer(input, checksum, &count, 4) ||
+        !volume_patch_read_integer(input, checksum, &header->size, 8))
+    {
+        return false;
+    }
+
+    header->version = version;
+    header->count = count;
+
+    return
+        memcmp(header->magic, VOLUME_PATCH_MAGIC, sizeof header->magic) == 0 &&
+        header->version == VOLUME_PATCH_VERSION &&
+        header->size == (uint64_t)instance->size;
+}
+
+static bool volume_patch_validate(
+    FILE* input,
+    Volume* instance,
+    VolumePatchHeader* header)
+{
+    Hash checksum;
+
+    if (!hash(&checksum, hash_backend()))
+    {
+        return false;
+    }
+
+    bool result = false;
+    uint64_t end = 0;
+    uint8_t buffer[4096];
+
+    if (!volume_patch_read_header(input, &checksum, instance, header))
+    {
+        goto volume_patch_validate_exit;
+    }
+
+    // Records must be in ascending order and lie within the disk image, so
+    // that applying them is a single forward pass. Their bytes are read only
+    // to be checksummed.
+
+    for (uint32_t i = 0; i < header->count; i++)
+    {
+        VolumePatchRecord record;
+
+        if (!volume_patch_read_record(input, &checksum, &record) ||
+            record.offset < end ||
+            record.offset > header->size ||
+            record.length > header->size - record.offset)
+        {
+            goto volume_patch_validate_exit;
+        }
+
+        end = record.offset + record.length;
+
+        while (record.length)
+        {
+            size_t length = record.length;
+
+            if (length > sizeof buffer)
+            {
+                length = sizeof buffer;
+            }
+
+            if (!volume_patch_read_bytes(input, &checksum, buffer, length))
+            {
+                goto volume_patch_validate_exit;
+            }
+
+            record.length -= length;
+        }
+    }
+
+    unsigned char expected[HASH_DIGEST_LENGTH];
+    unsigned char digest[HASH_DIGEST_LENGTH];
+    char trailer[8];
+
+    if (!volume_patch_read_bytes(input, &checksum, trailer, sizeof trailer) ||
+        memcmp(trailer, VOLUME_PATCH_TRAILER, sizeof trailer) != 0 ||
+        fread(expected, sizeof expected, 1, input) != 1)
+    {
+        goto volume_patch_validate_exit;
+    }
+
+    hash_final(&checksum, digest);
+
+    result = memcmp(digest, expected, sizeof digest) == 0 &&
+        fgetc(input) == EOF;
+
+volume_patch_validate_exit:
+    finalize_hash(&checksum);
+
+    if (!result)
+    {
+        errno = EINVAL;
+    }
+
+    return result;
+}
+
+static bool volume_patch_write(
+    Volume* instance,
+    const uint8_t* buffer,
+    size_t length,
+    off_t offset)
+{
+    while (length)
+    {
+        ssize_t written = pwrite(instance->descriptor, buffer, length, offset);
+
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        buffer += written;
+        length -= written;
+        offset += written;
+    }
+
+    return true;
+}
+
+static bool volume_patch_replay(
+    Volume* instance,
+    const char* path,
+    uint32_t* count,
+    bool staged)
+{
+    bool result = false;
+    FILE* input = fopen(path, "rb");
+    uint32_t ranges = instance->rangeCount;
+    VolumePatchHeader header;
+
+    *count = 0;
+
+    if (!input)
+    {
+        return false;
+    }
+
+    if (!volume_patch_validate(input, instance, &header))
+    {
+        goto volume_patch_replay_exit;
+    }
+
+    rewind(input);
+
+    if (!volume_patch_read_header(input, NULL, instance, &header))
+    {
+        errno = EINVAL;
+
+        goto volume_patch_replay_exit;
+    }
+
+    uint8_t buffer[4096];
+
+    for (; *count < header.count; (*count)++)
+    {
+        VolumePatchRecord record;
+
+        if (!volume_patch_read_record(input, NULL, &record))
+        {
+            errno = EINVAL;
+
+            goto volume_patch_replay_exit;
+        }
+
+        // A staged record is read into the private pages and marked as
+        // changed, so that the transaction that commits it journals the
+        // bytes it replaces.
+
+        if (staged)
+        {
+            uint8_t* data = (uint8_t*)instance->data + record.offset;
+
+            if (fread(data, 1, record.length, input) != record.length)
+            {
+                errno = EINVAL;
+
+                goto volume_patch_replay_exit;
+            }
+
+            volume_dirty(instance, data, record.length);
+
+            continue;
+        }
+
+        while (record.length)
+        {
+            size_t length = record.length;
+
+            if (length > sizeof buffer)
+            {
+                length = sizeof buffer;
+            }
+
+            if (fread(buffer, 1, length, input) != length)
+            {
+                errno = EINVAL;
+
+                goto volume_patch_replay_exit;
+            }
+
+            if (!volume_patch_write(instance, buffer, length, record.offset))
+            {
+                goto volume_patch_replay_exit;
+            }
+
+            record.offset += length;
+            record.length -= length;
+        }
+    }
+
+    result = true;
+
+volume_patch_replay_exit:
+    fclose(input);
+
+    // A patch that fails part of the way leaves none of its records to be
+    // committed.
+
+    if (!result)
+    {
+        instance->rangeCount = ranges;
+    }
+
+    return result;
+}
+
+bool volume_patch_apply(Volume* instance, const char* path, uint32_t* count)
+{
+    return volume_patch_replay(instance, path, count, true);
+}
+
+bool volume_patch_restore(Volume* instance, const char* path, uint32_t* count)
+{
+    return volume_patch_replay(instance, path, count, false);
+}
@@ -0,0 +1,83 @@
+// volume_patch.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VOLUME_PATCH_H
+#define VOLUME_PATCH_H
+#include "volume.h"
+
+/** Specifies the bytes that begin a patch file. */
+#define VOLUME_PATCH_MAGIC "NYUPATCH"
+
+/** Specifies the version of the patch file format. */
+#define VOLUME_PATCH_VERSION 2
+
+/** Specifies the bytes that begin the trailer of a patch file. */
+#define VOLUME_PATCH_TRAILER "NYUTRAIL"
+
+/**
+ * Writes the changes made to a disk image as a patch file. The file holds a
+ * header followed by records in ascending order of offset, each made of a
+ * 64-bit offset, a 32-bit length and the changed bytes. Overlapping and
+ * adjacent changes are merged into one record. A trailer ends the file: the
+ * `VOLUME_PATCH_TRAILER` bytes, then the SHA-1 digest of every byte before it.
+ * All integers are little-endian.
+ *
+ * @param instance the `Volume` instance.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the patch file to create or truncate.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_patch_export(Volume* instance, const char* path);
+
+/**
+ * Writes the bytes that a disk image holds before its changes are committed
+ * as a patch file, and flushes the file to storage. Applying the patch undoes
+ * the commit.
+ *
+ * @param instance the `Volume` instance, opened for writing.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the patch file to create or truncate.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_patch_journal(Volume* instance, const char* path);
+
+/**
+ * Applies a patch file to a disk image in one sequential pass. The patch,
+ * including its trailer, is validated before the first byte is read into the
+ * private pages of the image. Each record is marked as changed, so that it
+ * reaches the image only through `volume_transaction_commit`, which journals
+ * the bytes it replaces and flushes them.
+ *
+ * @param instance the `Volume` instance, opened for writing.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the patch file.
+ * @param count    when this method returns, contains the number of records
+ *                 applied. This argument is passed uninitialized.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error, which is `EINVAL` if the
+ *         patch is malformed, truncated or fails its checksum.
+ */
+bool volume_patch_apply(Volume* instance, const char* path, uint32_t* count);
+
+/**
+ * Writes a patch file straight to a disk image that is not yet mapped, as
+ * when an undo journal rolls back an interrupted commit. The patch is
+ * validated as by `volume_patch_apply`. Writing it again after a crash
+ * leaves the same bytes, so the caller flushes the image once afterwards.
+ *
+ * @param instance the `Volume` instance, whose `descriptor`, `size` and
+ *                 `rangeCount` are assigned.
+ * @param path     a pointer to a zero-terminated string containing the path of
+ *                 the patch file.
+ * @param count    when this method returns, contains the number of records
+ *                 written. This argument is passed uninitialized.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error, which is `EINVAL` if the
+ *         patch is malformed, truncated or fails its checksum.
+ */
+bool volume_patch_restore(Volume* instance, const char* path, uint32_t* count);
+
+#endif
@@ -2,6 +2,9 @@
 // Copyright (c) 2024 Ishan Pranav
 // Licensed under the MIT license.
 
+#ifndef VOLUME_ROOT_ITERATOR_H
+#define VOLUME_ROOT_ITERATOR_H
+#include <openssl/sha.h>
 #include "fat32_directory_entry.h"
 #include "volume.h"
 #include "volume_find_result.h"
@@ -14,17 +17,11 @@ struct VolumeRootIterator
 
     /** Specifies the current cluster number. */
     uint32_t cluster;
-    
-    /** Specifies the sector number of the first data sector. */
-    uint32_t firstDataSector;
-
-    /** Specifies the current byte offset within the volume. */
-    uint32_t offset;
 
     /** Specifies the number of bytes per cluster. */
     uint32_t bytesPerCluster;
 
-    /** The sector data. */
+    /** The data of the current cluster. */
     uint8_t* data;
 
     /** The current entry. */
@@ -53,6 +50,18 @@ void volume_root_begin(VolumeRootIterator* iterator, Volume* instance);
  */
 void volume_root_next(VolumeRootIterator* iterator);
 
+/**
+ * Determines whether the file at the current directory entry, read as if it
+ * were stored contiguously, has the given SHA-1 digest.
+ *
+ * @param iterator the iterator.
+ * @param sha1     the SHA-1 digest to match.
+ * @return `true` if the digest matches; otherwise, `false`.
+ */
+bool volume_root_matches(
+    VolumeRootIterator* iterator,
+    unsigned char sha1[SHA_DIGEST_LENGTH]);
+
 /**
  * Advances the iterator to the next directory entry that is a free file stored
  * contiguously whose name matches the given file name and whose SHA-1 digest
@@ -99,9 +108,21 @@ VolumeFindResult volume_root_single_free(
     unsigned char sha1[SHA_DIGEST_LENGTH]);
 
 /**
- * 
- * @param iterator
- * @param cluster
- * @return 
+ * Gets the data of a cluster of the volume.
+ *
+ * @param iterator the iterator.
+ * @param cluster  the cluster number, which must be a data cluster.
+ * @return A pointer to the first byte of the cluster.
  */
 uint8_t* volume_root_data(VolumeRootIterator* iterator, uint32_t cluster);
+
+/**
+ * Gets the number of data clusters in the volume. Valid cluster numbers range
+ * from `2` to one more than this value, inclusive.
+ *
+ * @param iterator the iterator.
+ * @return the number of data clusters in the volume.
+ */
+uint32_t volume_root_cluster_count(VolumeRootIterator* iterator);
+
+#endif
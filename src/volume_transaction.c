@@ -0,0 +1,179 @@
+// volume_transaction.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - https://www.man7.org/linux/man-pages/man2/msync.2.html
+//  - https://www.man7.org/linux/man-pages/man2/fdatasync.2.html
+//  - https://www.man7.org/linux/man-pages/man2/unlink.2.html
+//  - https://www.man7.org/linux/man-pages/man2/fsync.2.html
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "volume_patch.h"
+#include "volume_transaction.h"
+
+static bool volume_transaction_flush(
+    Volume* instance,
+    off_t first,
+    off_t last)
+{
+    return msync(instance->shared + first, last - first, MS_SYNC) == 0;
+}
+
+bool volume_transaction_sync_directory(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    size_t length = 0;
+
+    // The directory keeps the slash, so that a journal in the root directory
+    // syncs "/" rather than "".
+
+    if (slash)
+    {
+        length = slash - path + 1;
+    }
+
+    char* directory = malloc(length + sizeof ".");
+
+    if (!directory)
+    {
+        return false;
+    }
+
+    if (length)
+    {
+        memcpy(directory, path, length);
+
+        directory[length] = '\0';
+    }
+    else
+    {
+        memcpy(directory, ".", sizeof ".");
+    }
+
+    int descriptor = open(directory, O_RDONLY | O_DIRECTORY);
+
+    free(directory);
+
+    if (descriptor == -1)
+    {
+        return false;
+    }
+
+    bool result = fsync(descriptor) == 0;
+    int error = errno;
+
+    close(descriptor);
+
+    errno = error;
+
+    return result;
+}
+
+static bool volume_transaction_remove(Volume* instance)
+{
+    // Syncing the directory makes the removal durable, so that a removed
+    // journal never reappears to roll back a finished commit.
+
+    return unlink(instance->journal) == 0 &&
+        volume_transaction_sync_directory(instance->journal);
+}
+
+bool volume_transaction_commit(Volume* instance)
+{
+    if (instance->mode != VOLUME_MODE_READ_WRITE || !instance->rangeCount)
+    {
+        return true;
+    }
+
+    // The journal and its directory entry are both durable before the image
+    // is touched, so that a crash while flushing always finds the journal.
+
+    if (!volume_patch_journal(instance, instance->journal) ||
+        !volume_transaction_sync_directory(instance->journal))
+    {
+        return false;
+    }
+
+    // The ranges are sorted, so the pages they touch are visited in order and
+    // each run of consecutive touched pages is flushed once.
+
+    off_t page = sysconf(_SC_PAGESIZE);
+    off_t first = 0;
+    off_t last = 0;
+
+    for (uint32_t i = 0; i < instance->rangeCount; i++)
+    {
+        VolumeRange* range = instance->ranges + i;
+        off_t start = range->offset & ~(page - 1);
+        off_t end = (range->offset + range->length + page - 1) & ~(page - 1);
+
+        if (end > instance->size)
+        {
+            end = instance->size;
+        }
+
+        if (last && start > last)
+        {
+            if (!volume_transaction_flush(instance, first, last))
+            {
+                return false;
+            }
+
+            last = 0;
+        }
+
+        if (!last)
+        {
+            first = start;
+        }
+
+        memcpy(
+            instance->shared + range->offset,
+            (uint8_t*)instance->data + range->offset,
+            range->length);
+
+        last = end;
+    }
+
+    if (!volume_transaction_flush(instance, first, last))
+    {
+        return false;
+    }
+
+    instance->rangeCount = 0;
+
+    return volume_transaction_remove(instance);
+}
+
+bool volume_transaction_recover(Volume* instance)
+{
+    uint32_t count;
+
+    if (access(instance->journal, F_OK) == -1)
+    {
+        return errno == ENOENT;
+    }
+
+    if (!volume_patch_restore(instance, instance->journal, &count))
+    {
+        if (errno != EINVAL)
+        {
+            return false;
+        }
+
+        // A journal without a trailer that matches its checksum was cut
+        // short before the image was touched, so it is discarded.
+    }
+    else if (fdatasync(instance->descriptor) == -1)
+    {
+        return false;
+    }
+
+    return volume_transaction_remove(instance);
+}
@@ -0,0 +1,56 @@
+// volume_transaction.h
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+#ifndef VOLUME_TRANSACTION_H
+#define VOLUME_TRANSACTION_H
+#include "volume.h"
+
+/** Specifies the suffix appended to the path of a disk image for its journal. */
+#define VOLUME_JOURNAL_SUFFIX ".journal"
+
+/**
+ * Commits the changes made to a disk image opened for writing, so that a crash
+ * at any point leaves either none or all of them in the image:
+ *
+ *  1. The bytes that each changed range holds in the image are written to the
+ *     undo journal, which ends with a checksummed trailer. The journal and
+ *     its directory are flushed to storage.
+ *  2. The changed ranges are copied, in order of offset and so page by page,
+ *     from the private pages to the shared mapping of the image, and only the
+ *     pages touched are flushed with `msync`.
+ *  3. The journal is removed, and its directory is flushed again.
+ *
+ * A journal that is still present when the image is next opened is rolled
+ * back by `volume_transaction_recover`.
+ *
+ * @param instance the `Volume` instance.
+ * @return `true` if the operation succeeded or there was nothing to commit;
+ *         otherwise `false`. When `false`, `errno` is assigned to indicate the
+ *         error.
+ */
+bool volume_transaction_commit(Volume* instance);
+
+/**
+ * Rolls back a commit that was interrupted before its journal was removed. A
+ * journal whose trailer is missing or fails its checksum was never followed by
+ * a write to the image, so it is discarded.
+ *
+ * @param instance the `Volume` instance, whose `descriptor`, `size` and
+ *                 `journal` are assigned.
+ * @return `true` if the operation succeeded or there was no journal; otherwise
+ *         `false`. When `false`, `errno` is assigned to indicate the error.
+ */
+bool volume_transaction_recover(Volume* instance);
+
+/**
+ * Flushes the directory that holds a file to storage, so that a file created,
+ * renamed or removed there survives a crash as it was left.
+ *
+ * @param path the path of the file, whose directory is flushed.
+ * @return `true` if the operation succeeded; otherwise `false`. When `false`,
+ *         `errno` is assigned to indicate the error.
+ */
+bool volume_transaction_sync_directory(const char* path);
+
+#endif
@@ -0,0 +1,60 @@
+#!/bin/sh
+# subdirectory.sh
+# Copyright (c) 2024 Ishan Pranav
+# Licensed under the MIT license.
+
+# Recovers each deleted file of images written by tools/makeimage whose files
+# lie in subdirectories. The first cluster of such a file is not referenced by
+# the root directory, so it must still be kept out of the candidates of the
+# fragmented searches. Each file is recovered from a fresh copy of the image.
+
+set -eu
+
+NYUFILE=${NYUFILE:-../src/nyufile}
+MAKEIMAGE=${MAKEIMAGE:-../tools/makeimage}
+WORK=$(mktemp -d)
+FAILED=0
+
+trap 'rm -rf "$WORK"' EXIT
+
+# Recovers every file listed in the manifest with the given options and
+# reports each file that is not recovered.
+
+recover()
+{
+    while read -r path digest kind
+    do
+        cp --sparse=always "$WORK/image" "$WORK/copy"
+
+        output=$("$NYUFILE" "$WORK/copy" -R "$path" -s "$digest" "$@")
+
+        if [ "$output" != "$path: successfully recovered with SHA-1" ]
+        then
+            echo "$0: $* ($kind): $output" >&2
+
+            FAILED=1
+        fi
+    done < "$WORK/manifest"
+}
+
+# A first fragment longer than one cluster continues into the free run after
+# the first cluster, which the run search finds only if that cluster is not a
+# candidate.
+
+"$MAKEIMAGE" -c 512 -n 16 -k 6 -f 2 -p 100 -d 100 -D 2 -S 5 \
+    "$WORK/image" "$WORK/manifest"
+
+recover --strategy run --max-runs 2
+recover --strategy auto
+
+"$MAKEIMAGE" -c 256 -n 12 -k 3 -f 2 -p 100 -d 100 -D 3 -S 7 \
+    "$WORK/image" "$WORK/manifest"
+
+recover --strategy permutation
+
+if [ "$FAILED" -ne 0 ]
+then
+    exit 1
+fi
+
+echo "$0: ok"
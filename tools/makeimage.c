@@ -0,0 +1,649 @@
+// makeimage.c
+// Copyright (c) 2024 Ishan Pranav
+// Licensed under the MIT license.
+
+// References:
+//  - Microsoft Extensible Firmware Initiative FAT32 File System Specification
+//  - https://www.man7.org/linux/man-pages/man3/getopt.3.html
+//  - https://www.man7.org/linux/man-pages/man2/mmap.2.html
+//  - https://www.jstatsoft.org/article/view/v008i14
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fat32_attributes.h"
+#include "fat32_boot_sector.h"
+#include "fat32_directory_entry.h"
+#include "hash.h"
+
+#define MAKE_IMAGE_BYTES_PER_SECTOR 512
+#define MAKE_IMAGE_RESERVED_SECTORS 32
+#define MAKE_IMAGE_FATS 2
+#define MAKE_IMAGE_EOF 0x0fffffff
+
+/** Represents the parameters of a generated disk image. */
+struct MakeImageSettings
+{
+    /** Specifies the number of data clusters. */
+    uint32_t clusters;
+
+    /** Specifies the number of sectors per cluster, a power of two. */
+    uint32_t sectorsPerCluster;
+
+    /** Specifies the number of files. */
+    uint32_t files;
+
+    /** Specifies the maximum number of clusters in a file. */
+    uint32_t maxClusters;
+
+    /** Specifies the number of fragments of a fragmented file. */
+    uint32_t fragments;
+
+    /** Specifies the percentage of files that are fragmented. */
+    uint32_t fragmented;
+
+    /** Specifies the maximum number of allocated clusters between fragments. */
+    uint32_t maxGap;
+
+    /** Specifies the percentage of files that are deleted. */
+    uint32_t deleted;
+
+    /** Specifies the number of subdirectories, or `0` to use the root. */
+    uint32_t directories;
+
+    /** Specifies the seed of the pseudorandom number generator. */
+    uint64_t seed;
+};
+
+/** Represents the parameters of a generated disk image. */
+typedef struct MakeImageSettings MakeImageSettings;
+
+/** Represents a disk image being generated. */
+struct MakeImage
+{
+    /** Specifies the number of bytes per cluster. */
+    uint32_t bytesPerCluster;
+
+    /** Specifies the next cluster to allocate. */
+    uint32_t cursor;
+
+    /** Specifies the state of the pseudorandom number generator. */
+    uint64_t state;
+
+    /** Specifies the size of the disk image in bytes. */
+    uint64_t size;
+
+    /** The disk image. */
+    uint8_t* data;
+
+    /** The file allocation tables, one after another. */
+    uint32_t* fat;
+
+    /** Specifies the number of entries in each file allocation table. */
+    uint32_t fatEntries;
+
+    /** The data of cluster `2`. */
+    uint8_t* clusters;
+
+    /** The parameters. */
+    const MakeImageSettings* settings;
+};
+
+/** Represents a disk image being generated. */
+typedef struct MakeImage MakeImage;
+
+static uint64_t make_image_random(MakeImage* instance)
+{
+    uint64_t x = instance->state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    instance->state = x;
+
+    return x;
+}
+
+static uint32_t make_image_between(MakeImage* instance, uint32_t a, uint32_t b)
+{
+    return a + make_image_random(instance) % (b - a + 1);
+}
+
+static uint8_t* make_image_cluster(MakeImage* instance, uint32_t cluster)
+{
+    return instance->clusters + (size_t)(cluster - 2) *
+        instance->bytesPerCluster;
+}
+
+static void make_image_fill(MakeImage* instance, uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; i += sizeof(uint64_t))
+    {
+        uint64_t word = make_image_random(instance);
+        size_t length = size - i < sizeof word ? size - i : sizeof word;
+
+        memcpy(data + i, &word, length);
+    }
+}
+
+static void make_image_link(
+    MakeImage* instance,
+    uint32_t cluster,
+    uint32_t next)
+{
+    for (uint32_t fat = 0; fat < MAKE_IMAGE_FATS; fat++)
+    {
+        instance->fat[(size_t)fat * instance->fatEntries + cluster] = next;
+    }
+}
+
+static bool make_image_map(
+    MakeImage* instance,
+    const char* path,
+    const MakeImageSettings* settings)
+{
+    uint32_t fatSectors = ((uint64_t)(settings->clusters + 2) * 4 +
+        MAKE_IMAGE_BYTES_PER_SECTOR - 1) / MAKE_IMAGE_BYTES_PER_SECTOR;
+    uint32_t firstDataSector = MAKE_IMAGE_RESERVED_SECTORS +
+        MAKE_IMAGE_FATS * fatSectors;
+    uint64_t totalSectors = firstDataSector +
+        (uint64_t)settings->clusters * settings->sectorsPerCluster;
+
+    if (totalSectors > UINT32_MAX)
+    {
+        errno = EFBIG;
+
+        return false;
+    }
+
+    int descriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    if (descriptor == -1)
+    {
+        return false;
+    }
+
+    // The image is sparse: free space is never written and reads as zeroes.
+
+    instance->size = totalSectors * MAKE_IMAGE_BYTES_PER_SECTOR;
+
+    if (ftruncate(descriptor, instance->size) == -1)
+    {
+        close(descriptor);
+
+        return false;
+    }
+
+    void* data = mmap(
+        NULL,
+        instance->size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        descriptor,
+        0);
+
+    close(descriptor);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Fat32BootSector* bootSector = data;
+
+    memcpy(bootSector->jumpBoot, "\xeb\x58\x90", 3);
+    memcpy(bootSector->oemName, "MSWIN4.1", 8);
+
+    bootSector->bytesPerSector = MAKE_IMAGE_BYTES_PER_SECTOR;
+    bootSector->sectorsPerCluster = settings->sectorsPerCluster;
+    bootSector->reservedSectors = MAKE_IMAGE_RESERVED_SECTORS;
+    bootSector->fats = MAKE_IMAGE_FATS;
+    bootSector->media = 0xf8;
+    bootSector->totalSectors = totalSectors;
+    bootSector->sectorsPerFat = fatSectors;
+    bootSector->rootCluster = 2;
+    bootSector->fileSystemInfoSector = 1;
+    bootSector->backupBootSector = 6;
+    bootSector->bootSignature = 0x29;
+
+    memcpy(bootSector->volumeLabel, "NO NAME    ", 11);
+    memcpy(bootSector->fileSystemType, "FAT32   ", 8);
+
+    instance->data = data;
+    instance->data[510] = 0x55;
+    instance->data[511] = 0xaa;
+    instance->bytesPerCluster = MAKE_IMAGE_BYTES_PER_SECTOR *
+        settings->sectorsPerCluster;
+    instance->fat = (uint32_t*)(instance->data +
+        MAKE_IMAGE_RESERVED_SECTORS * MAKE_IMAGE_BYTES_PER_SECTOR);
+    instance->fatEntries = fatSectors * MAKE_IMAGE_BYTES_PER_SECTOR / 4;
+    instance->clusters = instance->data +
+        (size_t)firstDataSector * MAKE_IMAGE_BYTES_PER_SECTOR;
+    instance->settings = settings;
+    instance->state = settings->seed ? settings->seed : 1;
+
+    make_image_link(instance, 0, 0x0ffffff8);
+    make_image_link(instance, 1, MAKE_IMAGE_EOF);
+
+    return true;
+}
+
+static bool make_image_file(
+    MakeImage* instance,
+    Fat32DirectoryEntry* entry,
+    uint32_t index,
+    const char* directory,
+    FILE* manifest)
+{
+    const MakeImageSettings* settings = instance->settings;
+    uint32_t bytesPerCluster = instance->bytesPerCluster;
+    uint32_t clusters = make_image_between(instance, 1, settings->maxClusters);
+    uint32_t size = make_image_between(
+        instance,
+        (clusters - 1) * bytesPerCluster + 1,
+        clusters * bytesPerCluster);
+    uint32_t fragments = 1;
+
+    if (clusters >= settings->fragments &&
+        make_image_between(instance, 1, 100) <= settings->fragmented)
+    {
+        fragments = settings->fragments;
+    }
+
+    bool deleted = make_image_between(instance, 1, 100) <= settings->deleted;
+    uint32_t firstCluster = instance->cursor;
+    uint32_t previous = 0;
+    uint32_t remaining = clusters;
+    Hash context;
+
+    if (!hash(&context, hash_backend()))
+    {
+        return false;
+    }
+
+    // Each fragment but the last is followed by a gap of allocated clusters
+    // that hold unrelated data, so that every later fragment begins a free run
+    // once the file is deleted.
+
+    for (uint32_t fragment = 0; fragment < fragments; fragment++)
+    {
+        uint32_t length = remaining - (fragments - fragment - 1);
+
+        if (fragment + 1 < fragments)
+        {
+            length = make_image_between(instance, 1, length);
+        }
+
+        for (uint32_t i = 0; i < length; i++, remaining--)
+        {
+            uint32_t cluster = instance->cursor;
+            uint32_t bytes = bytesPerCluster;
+
+            if (cluster - 2 >= settings->clusters)
+            {
+                finalize_hash(&context);
+
+                errno = ENOSPC;
+
+                return false;
+            }
+
+            if (remaining == 1)
+            {
+                bytes = size - (clusters - 1) * bytesPerCluster;
+            }
+
+            uint8_t* data = make_image_cluster(instance, cluster);
+
+            make_image_fill(instance, data, bytes);
+            hash_update(&context, data, bytes);
+
+            if (previous && !deleted)
+            {
+                make_image_link(instance, previous, cluster);
+            }
+
+            previous = cluster;
+            instance->cursor++;
+        }
+
+        if (fragment + 1 < fragments)
+        {
+            uint32_t gap = make_image_between(instance, 1, settings->maxGap);
+
+            for (uint32_t i = 0; i < gap && instance->cursor - 2 <
+                settings->clusters; i++)
+            {
+                make_image_fill(
+                    instance,
+                    make_image_cluster(instance, instance->cursor),
+                    bytesPerCluster);
+                make_image_link(instance, instance->cursor, MAKE_IMAGE_EOF);
+
+                instance->cursor++;
+            }
+        }
+    }
+
+    if (!deleted)
+    {
+        make_image_link(instance, previous, MAKE_IMAGE_EOF);
+    }
+
+    unsigned char digest[HASH_DIGEST_LENGTH];
+
+    hash_final(&context, digest);
+    finalize_hash(&context);
+
+    char name[13];
+
+    snprintf(name, sizeof name, "F%07u.BIN", index % 10000000);
+    memcpy(entry->name, name, 8);
+    memcpy(entry->name + 8, name + 9, 3);
+
+    entry->attributes = FAT32_ATTRIBUTES_ARCHIVE;
+    entry->firstClusterHi = firstCluster >> 16;
+    entry->firstClusterLo = firstCluster & 0xffff;
+    entry->fileSize = size;
+
+    if (deleted)
+    {
+        *entry->name = 0xe5;
+    }
+    else
+    {
+        fputs("# ", manifest);
+    }
+
+    if (directory)
+    {
+        fprintf(manifest, "%s/", directory);
+    }
+
+    fputs(name, manifest);
+    fputc(' ', manifest);
+
+    for (int i = 0; i < HASH_DIGEST_LENGTH; i++)
+    {
+        fprintf(manifest, "%02x", digest[i]);
+    }
+
+    if (!deleted)
+    {
+        fputs(" live\n", manifest);
+    }
+    else if (fragments > 1)
+    {
+        fputs(" fragmented\n", manifest);
+    }
+    else
+    {
+        fputs(" contiguous\n", manifest);
+    }
+
+    return true;
+}
+
+static bool make_image(
+    const char* path,
+    const char* manifestPath,
+    const MakeImageSettings* settings)
+{
+    MakeImage instance;
+    bool result = false;
+
+    if (!make_image_map(&instance, path, settings))
+    {
+        return false;
+    }
+
+    FILE* manifest = fopen(manifestPath, "w");
+
+    if (!manifest)
+    {
+        goto make_image_exit;
+    }
+
+    // The root directory holds one entry per file, or per subdirectory,
+    // followed by an empty entry that ends it.
+
+    uint32_t entriesPerCluster = instance.bytesPerCluster /
+        sizeof(Fat32DirectoryEntry);
+    uint32_t directories = settings->directories;
+    uint32_t rootEntries = directories ? directories : settings->files;
+    uint32_t rootClusters = rootEntries / entriesPerCluster + 1;
+    uint32_t* firstClusters = NULL;
+
+    if (rootClusters > settings->clusters)
+    {
+        errno = ENOSPC;
+
+        goto make_image_exit_manifest;
+    }
+
+    for (uint32_t i = 0; i < rootClusters; i++)
+    {
+        uint32_t next = i + 1 < rootClusters ? i + 3 : MAKE_IMAGE_EOF;
+
+        make_image_link(&instance, i + 2, next);
+    }
+
+    instance.cursor = rootClusters + 2;
+
+    if (directories)
+    {
+        firstClusters = malloc(directories * sizeof * firstClusters);
+
+        if (!firstClusters)
+        {
+            goto make_image_exit_manifest;
+        }
+    }
+
+    // Each subdirectory holds every `directories`-th file after its dot
+    // entries, followed by an empty entry that ends it. Its clusters are
+    // contiguous, so its entries are too.
+
+    for (uint32_t i = 0; i < directories; i++)
+    {
+        uint32_t files = (settings->files + directories - 1 - i) / directories;
+        uint32_t clusters = (files + 2) / entriesPerCluster + 1;
+        uint32_t first = instance.cursor;
+        Fat32DirectoryEntry* entry;
+
+        if (first - 2 + clusters > settings->clusters)
+        {
+            errno = ENOSPC;
+
+            goto make_image_exit_directories;
+        }
+
+        for (uint32_t j = 0; j < clusters; j++)
+        {
+            uint32_t next = j + 1 < clusters ? first + j + 1 : MAKE_IMAGE_EOF;
+
+            make_image_link(&instance, first + j, next);
+        }
+
+        entry = (Fat32DirectoryEntry*)make_image_cluster(&instance, 2);
+        entry += i;
+
+        char name[9];
+
+        snprintf(name, sizeof name, "D%07u", (i + 1) % 10000000);
+        memcpy(entry->name, name, 8);
+        memcpy(entry->name + 8, "   ", 3);
+
+        entry->attributes = FAT32_ATTRIBUTES_DIRECTORY;
+        entry->firstClusterHi = first >> 16;
+        entry->firstClusterLo = first & 0xffff;
+        entry = (Fat32DirectoryEntry*)make_image_cluster(&instance, first);
+
+        memcpy(entry[0].name, ".          ", 11);
+        memcpy(entry[1].name, "..         ", 11);
+
+        entry[0].attributes = FAT32_ATTRIBUTES_DIRECTORY;
+        entry[0].firstClusterHi = first >> 16;
+        entry[0].firstClusterLo = first & 0xffff;
+        entry[1].attributes = FAT32_ATTRIBUTES_DIRECTORY;
+        firstClusters[i] = first;
+        instance.cursor += clusters;
+    }
+
+    for (uint32_t i = 0; i < settings->files; i++)
+    {
+        uint32_t cluster = 2;
+        uint32_t position = i;
+        char* directory = NULL;
+        char name[9];
+        Fat32DirectoryEntry* entry;
+
+        if (directories)
+        {
+            cluster = firstClusters[i % directories];
+            position = i / directories + 2;
+            directory = name;
+
+            snprintf(name, sizeof name, "D%07u", (i % directories + 1) %
+                10000000);
+        }
+
+        entry = (Fat32DirectoryEntry*)make_image_cluster(&instance, cluster);
+        entry += position;
+
+        if (!make_image_file(&instance, entry, i + 1, directory, manifest))
+        {
+            goto make_image_exit_directories;
+        }
+    }
+
+    result = true;
+
+make_image_exit_directories:
+    free(firstClusters);
+
+make_image_exit_manifest:
+    if (fclose(manifest) == EOF)
+    {
+        result = false;
+    }
+
+make_image_exit:
+    munmap(instance.data, instance.size);
+
+    return result;
+}
+
+static bool make_image_parse(uint32_t* result, const char* value)
+{
+    char* end;
+    unsigned long parsed = strtoul(value, &end, 10);
+
+    if (*value == '\0' || *end != '\0' || parsed > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *result = parsed;
+
+    return true;
+}
+
+static void make_image_print_usage(char* app)
+{
+    printf(
+        "Usage: %s [options] image manifest\n"
+        "  -c clusters   Number of data clusters (default 4096).\n"
+        "  -s sectors    Sectors per cluster, a power of two (default 1).\n"
+        "  -n files      Number of files (default 64).\n"
+        "  -k clusters   Maximum clusters per file (default 8).\n"
+        "  -f fragments  Fragments per fragmented file (default 1).\n"
+        "  -p percent    Percentage of files fragmented (default 50).\n"
+        "  -g clusters   Maximum used clusters between fragments (default 4).\n"
+        "  -d percent    Percentage of files deleted (default 25).\n"
+        "  -D dirs       Number of subdirectories holding the files\n"
+        "                (default 0, the root directory).\n"
+        "  -S seed       Seed of the pseudorandom generator (default 1).\n"
+        "The manifest lists each deleted file with its SHA-1 digest in the\n"
+        "format read by 'nyufile -m', and each live file as a comment. Files\n"
+        "in a subdirectory D are listed by the path D/name.\n",
+        app);
+}
+
+int main(int count, char* args[])
+{
+    MakeImageSettings settings =
+    {
+        .clusters = 4096,
+        .sectorsPerCluster = 1,
+        .files = 64,
+        .maxClusters = 8,
+        .fragments = 1,
+        .fragmented = 50,
+        .maxGap = 4,
+        .deleted = 25,
+        .directories = 0,
+        .seed = 1
+    };
+    uint32_t seed = 1;
+    int option;
+
+    while ((option = getopt(count, args, "c:s:n:k:f:p:g:d:D:S:")) != -1)
+    {
+        uint32_t* target;
+
+        switch (option)
+        {
+        case 'c': target = &settings.clusters; break;
+        case 's': target = &settings.sectorsPerCluster; break;
+        case 'n': target = &settings.files; break;
+        case 'k': target = &settings.maxClusters; break;
+        case 'f': target = &settings.fragments; break;
+        case 'p': target = &settings.fragmented; break;
+        case 'g': target = &settings.maxGap; break;
+        case 'd': target = &settings.deleted; break;
+        case 'D': target = &settings.directories; break;
+        case 'S': target = &seed; break;
+
+        default:
+            make_image_print_usage(*args);
+
+            return EXIT_FAILURE;
+        }
+
+        if (!make_image_parse(target, optarg))
+        {
+            make_image_print_usage(*args);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint32_t sectors = settings.sectorsPerCluster;
+
+    settings.seed = seed;
+
+    if (count - optind != 2 ||
+        !sectors || sectors > 128 || sectors & (sectors - 1) ||
+        !settings.clusters || !settings.maxClusters || !settings.fragments ||
+        !settings.maxGap || settings.fragmented > 100 ||
+        settings.deleted > 100)
+    {
+        make_image_print_usage(*args);
+
+        return EXIT_FAILURE;
+    }
+
+    if (!make_image(args[optind], args[optind + 1], &settings))
+    {
+        perror(*args);
+
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}